@@ -0,0 +1,42 @@
+/*
+ *  (c) Copyright 2015 Hewlett Packard Enterprise Development LP
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License. You may obtain
+ *  a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *  License for the specific language governing permissions and limitations
+ *  under the License.
+ */
+
+/************************************************************************//**
+ * @ingroup ops-fand
+ *
+ * @file
+ * Header file for heap allocation statistics.
+ *
+ * With the FAND_ALLOC_STATS build option, ops-fand counts the heap
+ * allocations made by each thread, so that a test can check that the
+ * steady-state poll path doesn't allocate. Without it, the count is 0.
+ ***************************************************************************/
+
+#ifndef _FANALLOC_H_
+#define _FANALLOC_H_
+
+#ifdef FAND_ALLOC_STATS
+/* malloc(), calloc() and realloc() calls made so far by this thread */
+unsigned long long int fand_alloc_count(void);
+#else
+static inline unsigned long long int
+fand_alloc_count(void)
+{
+    return(0);
+}
+#endif
+
+#endif  /* _FANALLOC_H_ */
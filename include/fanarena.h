@@ -0,0 +1,52 @@
+/*
+ *  (c) Copyright 2015 Hewlett Packard Enterprise Development LP
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License. You may obtain
+ *  a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *  License for the specific language governing permissions and limitations
+ *  under the License.
+ */
+
+/************************************************************************//**
+ * @ingroup ops-fand
+ *
+ * @file
+ * Header file for the per-subsystem memory arena.
+ *
+ * Everything that lives exactly as long as a subsystem is allocated from
+ * the subsystem's arena, so removing the subsystem releases it all at
+ * once, no matter how many fans it had.
+ ***************************************************************************/
+
+#ifndef _FANARENA_H_
+#define _FANARENA_H_
+
+#include <stddef.h>
+
+struct fand_arena_chunk;
+
+struct fand_arena {
+    struct fand_arena_chunk *chunks; /* most recent chunk first */
+    size_t used;                     /* bytes used in the newest chunk */
+    size_t total;                    /* bytes allocated from the arena */
+};
+
+/* allocate an arena, with room for at least "size" bytes */
+struct fand_arena *fand_arena_create(size_t size);
+/* free an arena and everything allocated from it */
+void fand_arena_destroy(struct fand_arena *arena);
+
+/* allocate zeroed memory from the arena */
+void *fand_arena_alloc(struct fand_arena *arena, size_t size);
+char *fand_arena_strdup(struct fand_arena *arena, const char *string);
+char *fand_arena_printf(struct fand_arena *arena, const char *format, ...)
+    __attribute__((format(printf, 2, 3)));
+
+#endif  /* _FANARENA_H_ */
@@ -0,0 +1,86 @@
+/*
+ *  (c) Copyright 2015 Hewlett Packard Enterprise Development LP
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License. You may obtain
+ *  a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *  License for the specific language governing permissions and limitations
+ *  under the License.
+ */
+
+/************************************************************************//**
+ * @ingroup ops-fand
+ *
+ * @file
+ * Header file for fan register access functions.
+ *
+ * All fan register reads and writes go through these functions, so that
+ * they can be directed at the simulated bus instead of real hardware, and
+ * be recorded or replayed.
+ *
+ * The buses are shared with the other platform daemons. Each transaction
+ * takes an advisory lock on the bus of its device, a file named
+ * i2c-bus-BUS.lock in the lock directory, which the other daemons take as
+ * well. The lock is never waited for: a poll checks with fand_bus_acquire()
+ * and is put off while the bus is busy, anything else goes ahead. Between
+ * fand_bus_batch_begin() and fand_bus_batch_end(), the lock of the bus in
+ * use is kept until the batch moves to another bus, so that a burst isn't
+ * interleaved with another daemon's. At most one bus is locked at a time.
+ ***************************************************************************/
+
+#ifndef _FANBUS_H_
+#define _FANBUS_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "config-yaml.h"
+#include "dynamic-string.h"
+
+/* read a register through the yaml handle (or the simulated bus) */
+int fand_reg_read(YamlConfigHandle handle, const char *subsystem_name,
+                  const i2c_bit_op *op, uint32_t *value);
+/* write a register through the yaml handle (or the simulated bus) */
+int fand_reg_write(YamlConfigHandle handle, const char *subsystem_name,
+                   const i2c_bit_op *op, uint32_t value);
+
+/* arbitrate bus access through lock files in 'dir' (NULL: don't) */
+void fand_bus_set_lock_dir(const char *dir);
+
+struct fand_mmio;
+
+/* access the registers of a device of 'handle' through 'mmio' rather than
+   its bus. the mapping is dropped by fand_bus_forget(). */
+void fand_bus_map_device(YamlConfigHandle handle, struct fand_mmio *mmio);
+
+/* drop what is known about the devices of a hardware description that is
+   about to be freed */
+void fand_bus_forget(YamlConfigHandle handle);
+
+/* take the lock of the bus of 'op', without waiting. returns false if
+   another daemon holds it, and has not held it for too long: the caller
+   should try again on a later main loop iteration. */
+bool fand_bus_acquire(YamlConfigHandle handle, const char *subsystem_name,
+                      const i2c_bit_op *op);
+
+/* start a poll: a bus that was busy for too long in an earlier poll is
+   waited for again */
+void fand_bus_poll_begin(void);
+
+/* keep the lock of the bus in use until the batch moves to another bus */
+void fand_bus_batch_begin(void);
+void fand_bus_batch_end(void);
+
+/* number of times a transaction went to another bus (mux channel) than
+   the one before */
+unsigned long long int fand_bus_mux_switches(void);
+
+/* append the bus statistics to 'ds' */
+void fand_bus_stats(struct ds *ds);
+
+#endif  /* _FANBUS_H_ */
@@ -111,34 +111,141 @@
 #define _FAND_LOCL_H_
 
 #include <stdbool.h>
+#include <stdint.h>
 #include "shash.h"
 #include "fanspeed.h"
 #include "fanstatus.h"
+#include "fandirection.h"
+#include "fanfilter.h"
+#include "fangovernor.h"
+#include "fanplan.h"
 #include "config-yaml.h"
+#include "fanarena.h"
+#include "fanhwmon.h"
+
+struct fand_plugin_ops;
+struct fand_power;
+struct fand_wear;
+struct fand_flight_state;
+
+/* per-fan state of a subsystem, kept as parallel arrays indexed by
+   locl_fan.idx, so that the per-cycle scans walk contiguous memory.
+   the values are only converted to strings when they are published. */
+struct locl_fan_state {
+    int *rpm;
+    uint8_t *status;              /* enum fanstatus */
+    uint8_t *direction;           /* enum fandirection */
+    int8_t *speed;                /* enum fanspeed */
+    bool *dirty;                  /* changed since last published */
+    long long int *changed;       /* time_msec() of the last change */
+    struct fan_rpm_filter *rpm_filter;
+};
+
+/* the feed-forward of interface load into a subsystem's speed */
+struct locl_load {
+    int gain;                     /* speed steps for a jump to full load */
+    int decay_msec;               /* time constant of the baseline */
+    double baseline;              /* load the fans have caught up with */
+    long long int last_msec;      /* of the last update, or -1 */
+    int boost;                    /* speed steps added to the sensors' */
+};
+
+/* the register reads of a poll, and their latest results. a result is
+   kept until it is read again. */
+struct locl_fan_samples {
+    struct fan_sample *plan;      /* by tier, in mux path order */
+    size_t n_plan;
+    struct fan_sample *merged;    /* the whole plan, by mux path */
+    size_t n_merged;
+    size_t n_mux_paths;           /* distinct buses the plan reads from */
+    bool *present;                /* per FRU */
+    uint8_t *direction;           /* per FRU, enum fandirection */
+    uint8_t *status;              /* per fan, enum fanstatus */
+    uint32_t *rpm_raw;            /* per fan, tach reading */
+    int *rpm_rc;                  /* per fan, result of the tach read */
+    uint8_t *fresh;               /* per fan, 1 << kind read this poll */
+    size_t tier_start[FAN_SAMPLE_N_TIERS + 1]; /* plan index of each tier */
+    size_t cursor[FAN_SAMPLE_N_TIERS]; /* where each tier resumes */
+    /* a poll put off for a busy bus resumes where it stopped */
+    bool resume;
+    bool tiered;                  /* poll with a budget, read by tier */
+    int tier;                     /* tier being read */
+    size_t left;                  /* reads left in the tier or pass */
+    size_t merged_cursor;         /* next read of the pass by mux path */
+    size_t taken;                 /* reads taken in this poll */
+};
 
 /* define a local structure to hold subsystem-related data,
    including the fan speed override value */
 struct locl_subsystem {
     char *name;
+    struct fand_arena *arena;     /* owns this struct and its fans */
+    YamlConfigHandle yaml_handle; /* h/w description of this subsystem */
+    char *hw_desc_dir;
     bool marked;
     bool valid;
     struct locl_subsystem *parent_subsystem;
     enum fanspeed fan_speed;      /* from tempd results */
     enum fanspeed fan_speed_override; /* as configured by user */
     enum fanspeed speed;          /* result of fan_speed, fan_speed_override */
+    const YamlFanInfo *fan_info;  /* looked up once, from yaml_handle */
+    const YamlFanFru **frus;      /* (the lookups may allocate) */
     int multiplier;               /* from fans.yaml info */
     int numerator;                /* from fans.yaml info */
-    struct shash subsystem_fans;  /* struct locl_fan */
+    bool tach_word_read;          /* read tach LSB+MSB in one transaction */
+    bool rpm_control;             /* speed controls take a target rpm */
+    int rpm_targets[FAND_SPEED_MAX + 1]; /* rpm of each speed level */
+    i2c_bit_op rpm_mode;          /* bits that select target rpm mode */
+    uint32_t rpm_mode_value;      /* (rpm_mode.device NULL: none) */
+    bool rpm_mode_on;             /* rpm_mode_value was written */
+    char *hwmon_dir;              /* fans read through hwmon, or "" */
+    struct fand_hwmon *hwmon;     /* open hwmon_dir, or NULL */
+    char *mmio_device;            /* device with mapped registers, or "" */
+    char *mmio_path;              /* file its registers are mapped from */
+    struct fand_mmio *mmio;       /* the mapping, or NULL */
+    const struct fand_plugin_ops *plugin; /* vendor driver, or NULL */
+    void *plugin_data;            /* the plugin's, for this subsystem */
+    char *plugin_device;          /* "plugin:NAME", in traces */
+    uint8_t *plugin_fru_status;   /* per FRU, passed to its set_leds */
+    struct fand_power *power;     /* fan power models, or NULL */
+    struct fand_wear *wear;       /* wear counters of each FRU */
+    struct fand_flight_state *flight; /* what the flight recorder saw */
+    struct locl_load load;        /* from other_config and Interface */
+    int redundancy_step;          /* speed steps added while degraded */
+    bool degraded;                /* a fan is faulted or absent */
+    struct fan_rpm_filter_config rpm_filter; /* from other_config */
+    struct fan_governor_config governor; /* from other_config */
+    struct fan_governor governor_state;
+    long long int next_poll_msec; /* when the fans are read next */
+    int poll_budget_msec;         /* time a poll may take (0: no limit) */
+    unsigned long long int n_overruns; /* polls cut short by the budget */
+    char *presence_gpio;          /* FRU presence event line, if any */
+    int presence_fd;              /* open presence_gpio, or -1 */
+    bool hotplug_pending;         /* presence change raised by software */
+    char *thermal_alert_gpio;     /* thermal alert line, if any */
+    int thermal_alert_fd;         /* open thermal_alert_gpio, or -1 */
+    bool thermal_alert_pending;   /* the level has to be (re)read */
+    bool thermal_alert;           /* the line is asserted: fans at max */
+    int sim_thermal_alert;        /* level of the simulated line */
+    unsigned long long int n_thermal_alerts;
+    long long int thermal_alert_usec; /* latency of the last alert */
+    long long int max_thermal_alert_usec;
+    size_t n_frus;
+    bool *fru_present;            /* last known presence, per fan FRU */
+    size_t *fru_first_fan;        /* fans of FRU i: [first[i], first[i+1]) */
+    size_t *fru_order;            /* FRUs in mux path order, for writes */
+    size_t n_fans;
+    struct locl_fan *fans;        /* in FRU order */
+    struct locl_fan_state fan_state;
+    struct locl_fan_samples samples;
 };
 
 struct locl_fan {
     char *name;
     struct locl_subsystem *subsystem;
     const YamlFan *yaml_fan;
-    enum fanspeed speed;
-    const char *direction;
-    int rpm;
-    enum fanstatus status;
+    size_t idx;                   /* index in the subsystem's fan_state */
+    size_t fru_idx;
 };
 
 #endif /* _FAND_LOCL_H_ */
@@ -0,0 +1,76 @@
+/*
+ *  (c) Copyright 2015 Hewlett Packard Enterprise Development LP
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License. You may obtain
+ *  a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *  License for the specific language governing permissions and limitations
+ *  under the License.
+ */
+
+/************************************************************************//**
+ * @ingroup ops-fand
+ *
+ * @file
+ * Interface of ops-fand vendor driver plugins.
+ *
+ * A plugin is a shared object that exports fand_plugin_init(), returning
+ * its hooks. A hardware description selects one by holding a file named
+ * "fand-plugin" whose first line is the plugin's name (looked up as
+ * FAND_PLUGIN_DIR/NAME.so) or path. A plugin implements any subset of the
+ * hooks: for the ones it leaves NULL, ops-fand uses the registers of the
+ * hardware description, as it does without a plugin.
+ *
+ * Hooks are called from the ops-fand main loop, one at a time, and must
+ * not block for long: a poll reads every fan of the subsystem.
+ ***************************************************************************/
+
+#ifndef _FAND_PLUGIN_H_
+#define _FAND_PLUGIN_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include "fanstatus.h"
+
+#define FAND_PLUGIN_API_VERSION 1
+
+struct fand_plugin_ops {
+    int api_version;              /* FAND_PLUGIN_API_VERSION */
+    const char *name;
+
+    /* take over the fans of a subsystem. fans are numbered from 0 in FRU
+       order; FRU i has the fans [fru_first_fan[i], fru_first_fan[i+1]).
+       returns the plugin's data for the other hooks, or NULL if it can't
+       handle this subsystem. */
+    void *(*open)(const char *subsystem_name, const char *hw_desc_dir,
+                  size_t n_frus, const size_t *fru_first_fan);
+    void (*close)(void *data);
+
+    /* read every fan at once: its rpm (not a raw tach count), the result
+       of reading it (0 or a negative errno), and its status (enum
+       fanstatus). */
+    void (*sample)(void *data, size_t n_fans, uint32_t *rpm, int *rc,
+                   uint8_t *status);
+
+    /* set every fan's speed control to 'hw_value', one of the speed
+       settings of the hardware description, or in target rpm mode, an
+       rpm. returns 0 or a negative errno. */
+    int (*set_speed)(void *data, uint32_t hw_value);
+
+    /* show the status of each FRU and of the whole subsystem (enum
+       fanstatus). returns 0 or a negative errno. */
+    int (*set_leds)(void *data, size_t n_frus, const uint8_t *fru_status,
+                    uint8_t subsystem_status);
+};
+
+/* the one symbol a plugin exports */
+typedef const struct fand_plugin_ops *fand_plugin_init_func(void);
+const struct fand_plugin_ops *fand_plugin_init(void);
+
+#endif  /* _FAND_PLUGIN_H_ */
@@ -0,0 +1,44 @@
+/*
+ *  (c) Copyright 2015 Hewlett Packard Enterprise Development LP
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License. You may obtain
+ *  a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *  License for the specific language governing permissions and limitations
+ *  under the License.
+ */
+
+/************************************************************************//**
+ * @ingroup ops-fand
+ *
+ * @file
+ * Header file for fan event line functions.
+ *
+ * An event line is a sysfs GPIO "value" file whose "edge" attribute has
+ * been configured by the platform. The kernel signals an edge on the line
+ * with POLLPRI, so the line can be waited for in the OVS poll loop.
+ ***************************************************************************/
+
+#ifndef _FANEVENT_H_
+#define _FANEVENT_H_
+
+#include <stdbool.h>
+
+/* open and arm an event line, returning the fd (or -1) */
+int fand_event_open(const char *path);
+/* close an event line opened with fand_event_open() */
+void fand_event_close(int fd);
+/* check (without blocking) whether the line fired, and rearm it */
+bool fand_event_check(int fd);
+/* read the current level of the line: 1, 0, or -1 on error */
+int fand_event_level(int fd);
+/* wake up the poll loop when the line fires */
+void fand_event_wait(int fd);
+
+#endif  /* _FANEVENT_H_ */
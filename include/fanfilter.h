@@ -0,0 +1,78 @@
+/*
+ *  (c) Copyright 2015 Hewlett Packard Enterprise Development LP
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License. You may obtain
+ *  a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *  License for the specific language governing permissions and limitations
+ *  under the License.
+ */
+
+/************************************************************************//**
+ * @ingroup ops-fand
+ *
+ * @file
+ * Header file for fan rpm filter functions.
+ ***************************************************************************/
+
+#ifndef _FANFILTER_H_
+#define _FANFILTER_H_
+
+#include <stdbool.h>
+
+/* largest median window supported */
+#define FAND_RPM_FILTER_MAX_WINDOW  7
+
+/* enums for rpm filter types */
+enum fan_rpm_filter_type
+{
+    FAND_RPM_FILTER_NONE = 0,
+    FAND_RPM_FILTER_MEDIAN = 1,
+    FAND_RPM_FILTER_EMA = 2
+};
+
+/* per-subsystem filter settings (from subsystem other_config) */
+struct fan_rpm_filter_config {
+    enum fan_rpm_filter_type type;
+    int window;                   /* median window, in samples */
+    int alpha;                    /* EMA weight of new sample, in percent */
+    int outlier_pct;              /* reject samples this far off (0: off) */
+    int outlier_limit;            /* accept after this many rejects */
+};
+
+/* per-fan filter state */
+struct fan_rpm_filter {
+    int samples[FAND_RPM_FILTER_MAX_WINDOW];
+    int n_samples;
+    int next;
+    int value;
+    int n_rejected;
+    int n_read_errors;            /* failed reads in a row */
+};
+
+/* fill in the default (pass-through) filter settings */
+void fan_rpm_filter_config_init(struct fan_rpm_filter_config *cfg);
+
+/* discard all filter history */
+void fan_rpm_filter_reset(struct fan_rpm_filter *filter);
+
+/* feed one computed rpm sample, returning the value to publish */
+int fan_rpm_filter_update(struct fan_rpm_filter *filter,
+                          const struct fan_rpm_filter_config *cfg, int rpm);
+
+/* note a failed tach read, returning the value to publish: the filtered
+   value for up to outlier_limit failures in a row, then 0 */
+int fan_rpm_filter_read_error(struct fan_rpm_filter *filter,
+                              const struct fan_rpm_filter_config *cfg);
+
+/* conversion functions */
+enum fan_rpm_filter_type fan_rpm_filter_string_to_enum(const char *name);
+const char *fan_rpm_filter_enum_to_string(enum fan_rpm_filter_type type);
+
+#endif  /* _FANFILTER_H_ */
@@ -0,0 +1,62 @@
+/*
+ *  (c) Copyright 2015 Hewlett Packard Enterprise Development LP
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License. You may obtain
+ *  a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *  License for the specific language governing permissions and limitations
+ *  under the License.
+ */
+
+
+/************************************************************************//**
+ * @ingroup ops-fand
+ *
+ * @file
+ * Header file for the fan flight recorder.
+ *
+ * The flight recorder keeps the recent history of every subsystem (fan rpm
+ * and status, the speed picked from the sensors, the override, the speed
+ * commanded) in a fixed-size file that is memory-mapped, so that it
+ * survives a daemon crash and a switch reboot. The window around a fan
+ * fault or a move to max speed is frozen, so that later samples don't
+ * overwrite it.
+ ***************************************************************************/
+
+#ifndef _FANFLIGHT_H_
+#define _FANFLIGHT_H_
+
+#include "dynamic-string.h"
+#include "fand-locl.h"
+
+/* the file the recorder maps. nothing is mapped before fand_flight_open(). */
+void fand_flight_set_file(const char *path);
+
+/* map the file, creating or resetting it if its layout doesn't match, and
+   start a new block after the last one written. called when this instance
+   takes control, so that only one instance writes to the file. */
+void fand_flight_open(void);
+void fand_flight_close(void);
+
+/* allocate the subsystem's recording state from its arena */
+void fand_flight_attach(struct locl_subsystem *subsystem);
+
+/* record the state the subsystem was just polled in, if it changed or the
+   last sample is old enough. doesn't allocate. */
+void fand_flight_sample(struct locl_subsystem *subsystem, long long int now);
+
+/* freeze the window around an event, once it has been recorded */
+void fand_flight_run(long long int now);
+
+/* decode the frozen windows and the live ring, oldest first */
+void fand_flight_export(struct ds *ds);
+/* a one line summary */
+void fand_flight_format(struct ds *ds);
+
+#endif  /* _FANFLIGHT_H_ */
@@ -0,0 +1,71 @@
+/*
+ *  (c) Copyright 2015 Hewlett Packard Enterprise Development LP
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License. You may obtain
+ *  a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *  License for the specific language governing permissions and limitations
+ *  under the License.
+ */
+
+/************************************************************************//**
+ * @ingroup ops-fand
+ *
+ * @file
+ * Header file for fan speed governor functions.
+ ***************************************************************************/
+
+#ifndef _FANGOVERNOR_H_
+#define _FANGOVERNOR_H_
+
+#include <stdbool.h>
+#include "fanspeed.h"
+
+/* per-subsystem governor settings (from subsystem other_config) */
+struct fan_governor_config {
+    int down_dwell_msec;          /* hold a lower request this long (0: off) */
+    int slew;                     /* max register change per step (0: off) */
+    int slew_interval_msec;       /* time between two slew steps */
+};
+
+/* per-subsystem governor state */
+struct fan_governor {
+    enum fanspeed level;          /* speed level being applied */
+    long long int down_since;     /* start of a pending lower request, or 0 */
+    int hw_value;                 /* last register value written, or -1 */
+    int hw_target;                /* register value of the applied level */
+    long long int last_step;      /* time of the last slew step */
+};
+
+/* fill in the default (pass-through) governor settings */
+void fan_governor_config_init(struct fan_governor_config *cfg);
+
+/* forget the history; the next request is applied as-is */
+void fan_governor_reset(struct fan_governor *gov);
+
+/* resume at a level whose register value is already programmed */
+void fan_governor_resume(struct fan_governor *gov, enum fanspeed level,
+                         int hw_value);
+
+/* feed the requested speed level, returning the level to apply */
+enum fanspeed fan_governor_level(struct fan_governor *gov,
+                                 const struct fan_governor_config *cfg,
+                                 enum fanspeed requested, long long int now);
+
+/* feed the register value of the applied level, returning the value to
+   write now (an intermediate one while slewing) */
+int fan_governor_hw_value(struct fan_governor *gov,
+                          const struct fan_governor_config *cfg,
+                          int hw_target, long long int now);
+
+/* time at which the governor wants to be run again, or LLONG_MAX */
+long long int fan_governor_next_msec(const struct fan_governor *gov,
+                                     const struct fan_governor_config *cfg);
+
+#endif  /* _FANGOVERNOR_H_ */
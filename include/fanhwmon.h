@@ -0,0 +1,60 @@
+/*
+ *  (c) Copyright 2015 Hewlett Packard Enterprise Development LP
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License. You may obtain
+ *  a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *  License for the specific language governing permissions and limitations
+ *  under the License.
+ */
+
+/************************************************************************//**
+ * @ingroup ops-fand
+ *
+ * @file
+ * Header file for the hwmon fan backend.
+ *
+ * A subsystem whose other_config has fan_hwmon_dir reads its fans from the
+ * attributes of a kernel hwmon device instead of from the registers of its
+ * hardware description: fan N of the subsystem (in FRU order, from 1) is
+ * fanN_input (rpm) and fanN_fault, and its speed is set through pwmN. The
+ * attribute files are opened once, and re-read with pread().
+ ***************************************************************************/
+
+#ifndef _FANHWMON_H_
+#define _FANHWMON_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include "fanarena.h"
+#include "fanstatus.h"
+
+struct fand_hwmon;
+
+/* open the attributes of the first 'n_fans' fans in 'dir'. the backend is
+   allocated from 'arena'; its files are closed by fand_hwmon_close(). */
+struct fand_hwmon *fand_hwmon_open(struct fand_arena *arena,
+                                   const char *subsystem_name,
+                                   const char *dir, size_t n_fans);
+void fand_hwmon_close(struct fand_hwmon *hwmon);
+
+/* read the tach and fault of fan 'idx'. 'rc' is the result of the tach
+   read; a fan without a fault attribute is ok if its tach can be read. */
+void fand_hwmon_read_fan(struct fand_hwmon *hwmon, size_t idx, int *rc,
+                         uint32_t *rpm, enum fanstatus *status);
+
+/* write 'value' (0-255) to every pwm there is. returns 0,
+   or the error of the first failed write. */
+int fand_hwmon_set_pwm(struct fand_hwmon *hwmon, uint32_t value);
+
+/* write 'rpm' to every fanN_target there is, for drivers that regulate the
+   fan speed themselves. returns 0, or the error of the first failed write. */
+int fand_hwmon_set_target(struct fand_hwmon *hwmon, uint32_t rpm);
+
+#endif  /* _FANHWMON_H_ */
@@ -0,0 +1,59 @@
+/*
+ *  (c) Copyright 2015 Hewlett Packard Enterprise Development LP
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License. You may obtain
+ *  a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *  License for the specific language governing permissions and limitations
+ *  under the License.
+ */
+
+
+/************************************************************************//**
+ * @ingroup ops-fand
+ *
+ * @file
+ * Header file for the feed-forward of switch load into the fan speed.
+ *
+ * The ASIC heats up seconds after the traffic through it jumps, and the
+ * temperature sensors see it later still. The total byte counters of the
+ * interfaces show the jump right away: a subsystem with a load gain adds
+ * speed steps for a rise of the utilization, which fade as the fans catch
+ * up with the new load. The sensors' speed stays the floor.
+ ***************************************************************************/
+
+#ifndef _FANLOAD_H_
+#define _FANLOAD_H_
+
+#include <stdbool.h>
+#include "dynamic-string.h"
+#include "fand-locl.h"
+
+/* the refresh interval of the interface statistics, unless set with
+   other_config:stats-update-interval of the System table */
+#define FAND_LOAD_STATS_MSEC 5000
+
+/* take a sample of the rx + tx bytes of all interfaces, and of their
+   capacity (bits/s, both directions), refreshed every 'stats_msec'. the
+   first sample, and one after a counter went back, only start the rate. */
+void fand_load_sample(unsigned long long int bytes,
+                      unsigned long long int capacity_bps, int stats_msec,
+                      long long int now);
+
+/* the latest utilization of the interfaces, from 0 to 1 */
+double fand_load_utilization(void);
+
+/* move the subsystem's baseline toward the utilization and recompute its
+   boost. returns true if the boost changed. */
+bool fand_load_update(struct locl_subsystem *subsystem, long long int now);
+
+/* the subsystem's gain, decay, baseline and boost */
+void fand_load_format(const struct locl_subsystem *subsystem, struct ds *ds);
+
+#endif  /* _FANLOAD_H_ */
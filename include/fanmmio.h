@@ -0,0 +1,59 @@
+/*
+ *  (c) Copyright 2015 Hewlett Packard Enterprise Development LP
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License. You may obtain
+ *  a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *  License for the specific language governing permissions and limitations
+ *  under the License.
+ */
+
+/************************************************************************//**
+ * @ingroup ops-fand
+ *
+ * @file
+ * Header file for memory-mapped fan registers.
+ *
+ * On platforms where the fan controller is a PCIe-attached FPGA or CPLD,
+ * the register window of a device of the hardware description can be
+ * mapped (typically a sysfs PCI resource file; any file works, which is
+ * how it is tested). Its registers are then read and written with plain
+ * loads and stores at the register offsets of the hardware description,
+ * instead of one i2c transaction, and system call, per access.
+ ***************************************************************************/
+
+#ifndef _FANMMIO_H_
+#define _FANMMIO_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include "config-yaml.h"
+#include "dynamic-string.h"
+
+struct fand_mmio;
+
+/* map the register window of hardware description device 'device' from
+   the file 'path'. returns NULL (and logs why) if it can't be mapped. */
+struct fand_mmio *fand_mmio_open(const char *device, const char *path);
+void fand_mmio_close(struct fand_mmio *mmio);
+
+/* the name of the device whose registers are mapped */
+const char *fand_mmio_device(const struct fand_mmio *mmio);
+
+/* access a mapped register. registers are 1, 2 or 4 bytes wide, in host
+   byte order, and aligned to their width. */
+int fand_mmio_read(struct fand_mmio *mmio, const i2c_bit_op *op,
+                   uint32_t *value);
+int fand_mmio_write(struct fand_mmio *mmio, const i2c_bit_op *op,
+                    uint32_t value);
+
+/* append a description of the mapping and its counters to 'ds' */
+void fand_mmio_format(const struct fand_mmio *mmio, struct ds *ds);
+
+#endif  /* _FANMMIO_H_ */
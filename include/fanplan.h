@@ -0,0 +1,66 @@
+/*
+ *  (c) Copyright 2015 Hewlett Packard Enterprise Development LP
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License. You may obtain
+ *  a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *  License for the specific language governing permissions and limitations
+ *  under the License.
+ */
+
+/************************************************************************//**
+ * @ingroup ops-fand
+ *
+ * @file
+ * Header file for the per-poll sampling plan of a subsystem.
+ ***************************************************************************/
+
+#ifndef _FANPLAN_H_
+#define _FANPLAN_H_
+
+#include <stddef.h>
+#include "config-yaml.h"
+
+/* what a sample reads */
+enum fan_sample_kind {
+    FAN_SAMPLE_PRESENT,           /* FRU presence */
+    FAN_SAMPLE_FAULT,             /* fan fault */
+    FAN_SAMPLE_RPM,               /* fan tach */
+    FAN_SAMPLE_DIRECTION,         /* FRU airflow direction */
+    FAN_SAMPLE_CONTROL,           /* FRU speed control and LED (writes) */
+};
+
+/* samples are taken in tiers, most important first: when a poll runs out
+   of time, what is known to be needed first has been read. presence has a
+   tier of its own, since the fans of an absent FRU aren't read. */
+#define FAN_SAMPLE_N_TIERS 4
+
+/* the tier of a kind of sample */
+int fan_sample_tier(enum fan_sample_kind kind);
+
+/* one register access of a poll */
+struct fan_sample {
+    enum fan_sample_kind kind;
+    size_t idx;                   /* FRU or fan index, depending on kind */
+    const i2c_bit_op *op;         /* (first) register accessed */
+    const char *mux_path;         /* bus of op's device, "" if unknown */
+};
+
+/* the mux path (bus) that the device of 'op' sits on */
+const char *fan_plan_mux_path(YamlConfigHandle handle,
+                              const char *subsystem_name,
+                              const i2c_bit_op *op);
+
+/* sort samples by tier, then mux path, device and register */
+void fan_plan_sort(struct fan_sample *samples, size_t n);
+
+/* sort by mux path, device and register alone, whatever the tiers */
+void fan_plan_sort_by_path(struct fan_sample *samples, size_t n);
+
+#endif  /* _FANPLAN_H_ */
@@ -0,0 +1,51 @@
+/*
+ *  (c) Copyright 2015 Hewlett Packard Enterprise Development LP
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License. You may obtain
+ *  a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *  License for the specific language governing permissions and limitations
+ *  under the License.
+ */
+
+/************************************************************************//**
+ * @ingroup ops-fand
+ *
+ * @file
+ * Header file for loading and calling vendor driver plugins.
+ ***************************************************************************/
+
+#ifndef _FANPLUGIN_H_
+#define _FANPLUGIN_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "fand-locl.h"
+#include "fand-plugin.h"
+
+/* load the plugin the subsystem's hardware description selects, if any,
+   and let it take over the subsystem's fans */
+void fand_plugin_attach(struct locl_subsystem *subsystem);
+void fand_plugin_detach(struct locl_subsystem *subsystem);
+
+/* whether the subsystem's plugin implements a hook */
+#define FAND_PLUGIN_HAS(SUBSYSTEM, HOOK) \
+    ((SUBSYSTEM)->plugin != NULL && (SUBSYSTEM)->plugin->HOOK != NULL)
+
+/* call the hooks: the samples go into subsystem->samples. with --record
+   and --replay, the samples and speeds are recorded and replayed like
+   registers of a device named after the plugin. */
+void fand_plugin_sample(struct locl_subsystem *subsystem);
+int fand_plugin_set_speed(struct locl_subsystem *subsystem,
+                          uint32_t hw_value);
+/* the FRU statuses are taken from subsystem->plugin_fru_status */
+int fand_plugin_set_leds(struct locl_subsystem *subsystem,
+                         uint8_t subsystem_status);
+
+#endif  /* _FANPLUGIN_H_ */
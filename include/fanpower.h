@@ -0,0 +1,56 @@
+/*
+ *  (c) Copyright 2015 Hewlett Packard Enterprise Development LP
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License. You may obtain
+ *  a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *  License for the specific language governing permissions and limitations
+ *  under the License.
+ */
+
+
+/************************************************************************//**
+ * @ingroup ops-fand
+ *
+ * @file
+ * Header file for fan power and energy accounting.
+ *
+ * A hardware description may have a fan-power file with the coefficients
+ * of each fan model. The power of a fan is then estimated from its rpm
+ * with the cubic fan law, and integrated over time into an energy counter
+ * per fan, which add up per FRU and per subsystem.
+ ***************************************************************************/
+
+#ifndef _FANPOWER_H_
+#define _FANPOWER_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "dynamic-string.h"
+#include "fand-locl.h"
+
+/* read the fan-power file of the subsystem's hardware description, if
+   there is one, and start its counters. allocates from the arena. */
+void fand_power_attach(struct locl_subsystem *subsystem);
+
+/* integrate the power of every fan since the last update, at the rpm
+   just published, and take the new power. */
+void fand_power_update(struct locl_subsystem *subsystem, long long int now);
+
+/* the estimated power (W) and energy (J) of fan 'idx' */
+double fand_power_fan_watts(const struct locl_subsystem *subsystem,
+                            size_t idx);
+double fand_power_fan_joules(const struct locl_subsystem *subsystem,
+                             size_t idx);
+
+/* the totals of the subsystem, and with 'fans', of each FRU and fan */
+void fand_power_format(const struct locl_subsystem *subsystem, bool fans,
+                       struct ds *ds);
+
+#endif  /* _FANPOWER_H_ */
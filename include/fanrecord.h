@@ -0,0 +1,87 @@
+/*
+ *  (c) Copyright 2015 Hewlett Packard Enterprise Development LP
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License. You may obtain
+ *  a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *  License for the specific language governing permissions and limitations
+ *  under the License.
+ */
+
+/************************************************************************//**
+ * @ingroup ops-fand
+ *
+ * @file
+ * Header file for recording and replaying the daemon's inputs.
+ *
+ * With --record, every main loop tick, register access result, FRU
+ * presence event, interface load sample and subsystem configuration seen
+ * by ops-fand is appended to a binary trace. With --replay, the trace is
+ * fed back to the same control code: the clock comes from the recorded
+ * ticks, register reads are answered from the trace, and register writes
+ * are checked against it.
+ ***************************************************************************/
+
+#ifndef _FANRECORD_H_
+#define _FANRECORD_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "config-yaml.h"
+#include "dynamic-string.h"
+#include "smap.h"
+#include "svec.h"
+
+/* the clock of the current main loop tick (recorded or replayed) */
+long long int fand_now(void);
+
+/* start a new main loop tick, reading (and recording) the clock */
+void fand_clock_tick(void);
+
+/* recording */
+bool fand_record_open(const char *path);
+void fand_record_close(void);
+bool fand_recording(void);
+void fand_record_reg(bool write, const char *subsystem_name,
+                     const i2c_bit_op *op, int rc, uint32_t value);
+void fand_record_event(const char *subsystem_name);
+void fand_record_load(uint64_t bytes, uint64_t capacity_bps,
+                      uint32_t stats_msec);
+void fand_record_subsystem(const char *name, const char *hw_desc_dir,
+                           const struct smap *other_config,
+                           const char **fan_states, size_t n_fan_states);
+void fand_record_inputs_end(void);
+
+/* the configuration of one subsystem, as recorded */
+struct fand_replay_subsystem {
+    const char *name;
+    char *hw_desc_dir;
+    struct smap other_config;
+    struct svec fan_states;       /* of its temperature sensors */
+};
+
+/* replaying */
+bool fand_replay_open(const char *path);
+void fand_replay_close(void);
+bool fand_replaying(void);
+bool fand_replay_next_tick(void);
+bool fand_replay_has_inputs(void);
+size_t fand_replay_n_subsystems(void);
+const struct fand_replay_subsystem *fand_replay_subsystem(size_t idx);
+int fand_replay_reg(bool write, const char *subsystem_name,
+                    const i2c_bit_op *op, uint32_t *value);
+bool fand_replay_event(const char *subsystem_name);
+/* the interface load sample of the tick; false if none was taken */
+bool fand_replay_load(uint64_t *bytes, uint64_t *capacity_bps,
+                      uint32_t *stats_msec);
+bool fand_replay_diverged(void);
+void fand_replay_report(struct ds *ds);
+
+#endif  /* _FANRECORD_H_ */
@@ -0,0 +1,52 @@
+/*
+ *  (c) Copyright 2015 Hewlett Packard Enterprise Development LP
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License. You may obtain
+ *  a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *  License for the specific language governing permissions and limitations
+ *  under the License.
+ */
+
+/************************************************************************//**
+ * @ingroup ops-fand
+ *
+ * @file
+ * Header file for the simulated fan bus.
+ *
+ * When ops-fand is started with --sim-bus, register accesses are served
+ * from an in-memory register file instead of i2c, and the register file
+ * can be inspected and modified with the ops-fand/sim-* unixctl commands.
+ ***************************************************************************/
+
+#ifndef _FANSIM_H_
+#define _FANSIM_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "config-yaml.h"
+
+/* registers per simulated device */
+#define FANSIM_DEVICE_REGS  256
+
+/* switch register accesses to the simulated bus */
+void fansim_init(void);
+bool fansim_enabled(void);
+
+/* register accesses, with the same masking rules as the i2c ones */
+int fansim_reg_read(const char *subsystem_name, const i2c_bit_op *op,
+                    uint32_t *value);
+int fansim_reg_write(const char *subsystem_name, const i2c_bit_op *op,
+                     uint32_t value);
+
+/* make the next 'count' reads of the register of 'op' fail */
+void fansim_fail_reads(const char *subsystem_name, const i2c_bit_op *op,
+                       int count);
+
+#endif  /* _FANSIM_H_ */
@@ -0,0 +1,59 @@
+/*
+ *  (c) Copyright 2015 Hewlett Packard Enterprise Development LP
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License. You may obtain
+ *  a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *  License for the specific language governing permissions and limitations
+ *  under the License.
+ */
+
+/************************************************************************//**
+ * @ingroup ops-fand
+ *
+ * @file
+ * Header file for span tracing of the control loop.
+ *
+ * With the FAND_TRACE build option, the main loop stages, the subsystem
+ * polls and every register access are recorded as spans in a ring buffer,
+ * which ops-fand/trace dumps as Chrome trace-event JSON. Without it, the
+ * trace points compile to nothing.
+ ***************************************************************************/
+
+#ifndef _FANTRACE_H_
+#define _FANTRACE_H_
+
+#include <stdint.h>
+#include "dynamic-string.h"
+
+#ifdef FAND_TRACE
+
+/* start a span: declares VAR, holding its start time */
+#define FAND_SPAN_BEGIN(VAR) long long int VAR = fand_trace_clock()
+/* end the span started with VAR. NAME must be a string literal; ARG (may
+   be NULL) and REG describe what the span was about. */
+#define FAND_SPAN_END(VAR, NAME, ARG, REG) \
+    fand_trace_span(NAME, ARG, REG, VAR)
+
+long long int fand_trace_clock(void);
+void fand_trace_span(const char *name, const char *arg, int64_t reg,
+                     long long int start_usec);
+
+/* append the spans of the last 'seconds' (all if <= 0) to 'ds', as a
+   Chrome trace-event JSON document */
+void fand_trace_dump(struct ds *ds, int seconds);
+
+#else
+
+#define FAND_SPAN_BEGIN(VAR)
+#define FAND_SPAN_END(VAR, NAME, ARG, REG) ((void)0)
+
+#endif  /* FAND_TRACE */
+
+#endif  /* _FANTRACE_H_ */
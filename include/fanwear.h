@@ -0,0 +1,61 @@
+/*
+ *  (c) Copyright 2015 Hewlett Packard Enterprise Development LP
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License. You may obtain
+ *  a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *  License for the specific language governing permissions and limitations
+ *  under the License.
+ */
+
+
+/************************************************************************//**
+ * @ingroup ops-fand
+ *
+ * @file
+ * Header file for fan wear accounting.
+ *
+ * Each fan FRU has counters of its run time, the time spent at each speed
+ * level, and how often it started, stopped and faulted. They are kept by
+ * FRU (see fand_wear_attach()) across subsystem reloads and FRU removals,
+ * and persisted in an append-only log that survives a power loss and is
+ * compacted from time to time.
+ ***************************************************************************/
+
+#ifndef _FANWEAR_H_
+#define _FANWEAR_H_
+
+#include "dynamic-string.h"
+#include "fand-locl.h"
+
+/* the log that the counters are persisted in. nothing is read or written
+   before fand_wear_open(). */
+void fand_wear_set_log(const char *path);
+
+/* restore the counters from the log, and start appending to it. called when
+   this instance takes control, so that a standby gets the latest counters. */
+void fand_wear_open(void);
+/* append what changed, and close the log */
+void fand_wear_close(void);
+
+/* find or create the counters of each FRU of the subsystem. allocates from
+   the subsystem's arena. */
+void fand_wear_attach(struct locl_subsystem *subsystem);
+
+/* account for the time since the last update of the subsystem, with the
+   state just published */
+void fand_wear_update(struct locl_subsystem *subsystem, long long int now);
+
+/* append the counters that changed to the log, if it is time to */
+void fand_wear_run(long long int now);
+
+/* the counters of each FRU of the subsystem */
+void fand_wear_format(const struct locl_subsystem *subsystem, struct ds *ds);
+
+#endif  /* _FANWEAR_H_ */
@@ -24,8 +24,56 @@
 #include "config-yaml.h"
 #include "fand-locl.h"
 
+/* the tach reading of a fan running at 'rpm': the reverse of the rpm
+   calculation */
+uint32_t fand_rpm_to_tach(const struct locl_subsystem *subsystem,
+                          uint32_t rpm);
+
+/* the speed the subsystem's fans should run at, from the sensors, the
+   configured override and the load feed-forward */
+enum fanspeed fand_subsystem_speed(const struct locl_subsystem *subsystem);
+
 void fand_set_fanspeed(struct locl_subsystem *subsystem);
 
+/* take over a subsystem whose fans already run at the given speed */
+void fand_resume_fanspeed(struct locl_subsystem *subsystem,
+                          enum fanspeed speed);
+
 void fand_set_fanleds(struct locl_subsystem *subsystem);
 
+/* true if any fan of the subsystem is faulted (or absent) */
+bool fand_subsystem_degraded(const struct locl_subsystem *subsystem);
+
+/* raise or restore the subsystem's speed when it becomes degraded or
+   recovers. returns true if the speed was changed. */
+bool fand_check_redundancy(struct locl_subsystem *subsystem);
+
+/* read the state of a single fan. the fans of a plugin are to be sampled
+   with fand_plugin_sample() first. */
 void fand_read_fan_status(struct locl_fan *fan);
+
+/* lay out the reads of a poll of the subsystem, and the order in which its
+   FRUs are written, by mux path */
+void fand_plan_samples(struct locl_subsystem *subsystem);
+
+enum fand_poll_result {
+    FAND_POLL_DONE,
+    FAND_POLL_OVERRUN,            /* out of time */
+    FAND_POLL_BUSY,               /* another daemon holds a bus */
+};
+
+/* read the state of all fans of the subsystem, following its plan, until
+   time_usec() reaches 'deadline' (LLONG_MAX: no deadline). the samples
+   left out of a poll that ran out of time are taken first by the next
+   poll. a poll that runs into a busy bus stores nothing yet: it is to be
+   called again, and resumes with the read that found the bus busy. */
+enum fand_poll_result fand_sample_fans(struct locl_subsystem *subsystem,
+                                       long long int deadline);
+
+void fand_fan_set_speed(struct locl_fan *fan, enum fanspeed speed);
+
+bool fand_read_fan_fru_present(struct locl_subsystem *subsystem,
+                               size_t fru_idx);
+
+/* read the fans of a single FRU and program its speed and LEDs */
+void fand_refresh_fan_fru(struct locl_subsystem *subsystem, size_t fru_idx);
@@ -0,0 +1,219 @@
+# -*- coding: utf-8 -*-
+
+# (c) Copyright 2016 Hewlett Packard Enterprise Development LP
+#
+# GNU Zebra is free software; you can redistribute it and/or modify it
+# under the terms of the GNU General Public License as published by the
+# Free Software Foundation; either version 2, or (at your option) any
+# later version.
+#
+# GNU Zebra is distributed in the hope that it will be useful, but
+# WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+# General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with GNU Zebra; see the file COPYING.  If not, write to the Free
+# Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+# 02111-1307, USA.
+"""A private ops-fand on the simulated bus, for the component tests.
+
+SimFand runs its own ovsdb-server and ops-fand --sim-bus in a work
+directory on the switch, next to the switch's own daemons. The subsystems it
+is given use the switch's hardware description, with every register in
+memory, so a test can insert and remove FRUs, fault fans and assert the
+thermal alert. ops-fand's clock can be stopped and warped, which makes the
+poll, dwell and freeze timings exact. A second SimFand given the first as
+its peer runs another ops-fand on the same database, for the standby and
+shard tests.
+"""
+
+SCHEMA = '/usr/share/openvswitch/vswitch.ovsschema'
+# FRU numbers tried when all FRUs are inserted
+MAX_FRUS = 16
+# ops-fand reads each subsystem's fans once per poll interval
+POLL_MSEC = 5000
+# where the build installs the variants of fand_test_plugin.c
+PLUGIN_DIR = '/usr/lib/ops-fand/test'
+
+
+def base_hw_desc_dir(sw1):
+    output = sw1('ovs-vsctl get Subsystem base hw_desc_dir', shell='bash')
+    return output.strip().strip('"')
+
+
+def plugin_hw_desc_dir(sim, name, plugin):
+    """a copy of the switch's hardware description that selects a plugin"""
+    path = '{}/hw-{}'.format(sim.dir, name)
+    sim.bash('cp -r {} {p}; echo {}/{}.so > {p}/fand-plugin'
+             .format(base_hw_desc_dir(sim.sw1), PLUGIN_DIR, plugin, p=path))
+    return path
+
+
+class SimFand(object):
+
+    def __init__(self, sw1, name, peer=None):
+        self.sw1 = sw1
+        self.peer = peer
+        self.dir = peer.dir if peer else '/tmp/fand-sim-' + name
+        self.fand = 'ops-fand-' + name if peer else 'ops-fand'
+        self.db = 'unix:{}/db.sock'.format(self.dir)
+        self.ctl = '{}/{}.ctl'.format(self.dir, self.fand)
+        self.sensors = peer.sensors if peer else {}
+
+    def bash(self, cmd):
+        return self.sw1(cmd, shell='bash')
+
+    def start(self, *args, **kwargs):
+        """Start a new database, and ops-fand on it."""
+        self.bash('rm -rf {d}; mkdir -p {d}; '
+                  'ovsdb-tool create {d}/ovsdb.db {schema}; '
+                  'ovsdb-server {d}/ovsdb.db --remote=punix:{d}/db.sock '
+                  '--unixctl={d}/ovsdb.ctl --pidfile={d}/ovsdb.pid '
+                  '--log-file={d}/ovsdb.log --detach'
+                  .format(d=self.dir, schema=SCHEMA))
+        self.start_fand(*args, **kwargs)
+
+    def start_fand(self, *args, **kwargs):
+        """Start ops-fand on the existing database. The wear log and the
+        flight recorder are off, unless given, or unless files=True keeps
+        their default paths, which are in the work directory."""
+        options = list(args)
+        for option in ['--wear-log=', '--flight-recorder=']:
+            if not kwargs.get('files') and \
+                    not any(arg.startswith(option) for arg in options):
+                options.append(option)
+        self.bash('rm -f {ctl}; OVS_DBDIR={d} '
+                  'ops-fand --sim-bus --unixctl={ctl} '
+                  '--pidfile={d}/{f}.pid --log-file={d}/{f}.log '
+                  '--detach {options} {db}'
+                  .format(ctl=self.ctl, d=self.dir, f=self.fand, db=self.db,
+                          options=' '.join(options)))
+        self.bash('for i in $(seq 1 100); do test -S {} && break; '
+                  'sleep 0.1; done'.format(self.ctl))
+
+    def stop_fand(self):
+        self.bash('ovs-appctl -t {} exit; true'.format(self.ctl))
+        self.bash('for i in $(seq 1 100); do '
+                  'test -e {d}/{f}.pid || break; sleep 0.1; done'
+                  .format(d=self.dir, f=self.fand))
+
+    def kill_fand(self):
+        """kill ops-fand, without giving it a chance to clean up"""
+        self.bash('kill -9 $(cat {d}/{f}.pid); rm -f {d}/{f}.pid {ctl}'
+                  .format(d=self.dir, f=self.fand, ctl=self.ctl))
+
+    def stop(self):
+        """stop ops-fand, and the database unless it is the peer's"""
+        self.stop_fand()
+        if self.peer:
+            return
+        self.bash('ovs-appctl -t {d}/ovsdb.ctl exit; rm -rf {d}'
+                  .format(d=self.dir))
+
+    def vsctl(self, args):
+        return self.bash('ovs-vsctl --db={} --no-wait {}'
+                         .format(self.db, args))
+
+    def appctl(self, args):
+        return self.bash('ovs-appctl -t {} {}'.format(self.ctl, args))
+
+    def create_subsystem(self, name, hw_desc_dir, other_config=None,
+                         fan_state='normal'):
+        """Create a subsystem with one temperature sensor, and wait for its
+        fans."""
+        settings = ''.join(' other_config:{}={}'.format(key, value)
+                           for key, value in (other_config or {}).items())
+        output = self.vsctl('-- --id=@t create Temp_sensor name={}-temp '
+                            'fan_state={} -- create Subsystem name={} '
+                            'hw_desc_dir={} temp_sensors=@t{}'
+                            .format(name, fan_state, name, hw_desc_dir,
+                                    settings))
+        self.sensors[name] = output.split()[0]
+        assert self.wait('Subsystem {} \'fans!=[]\''.format(name), 30)
+
+    def set_fan_state(self, subsystem, fan_state):
+        self.vsctl('set Temp_sensor {} fan_state={}'
+                   .format(self.sensors[subsystem], fan_state))
+
+    def set_other_config(self, subsystem, key, value):
+        self.vsctl('set Subsystem {} other_config:{}={}'
+                   .format(subsystem, key, value))
+
+    def insert_all_frus(self, subsystem):
+        """Mark every FRU with a presence bit present, and return their
+        numbers."""
+        numbers = []
+        for number in range(MAX_FRUS + 1):
+            if self.set_fru_present(subsystem, number, 'present'):
+                numbers.append(number)
+        return numbers
+
+    def set_fru_present(self, subsystem, number, state, *args):
+        """ops-fand/sim-fru-present, true if the FRU has a presence bit"""
+        output = self.bash('ovs-appctl -t {} ops-fand/sim-fru-present {} {} '
+                           '{} {} >/dev/null 2>&1 && echo DONE; true'
+                           .format(self.ctl, subsystem, number, state,
+                                   ' '.join(args)))
+        return 'DONE' in output
+
+    def set_fan(self, subsystem, fan, rpm, status='ok', failed_reads=0):
+        """set a fan's tach and fault, and fail the next reads of its
+        tach"""
+        self.appctl('ops-fand/sim-fan {} {} {} {} {}'
+                    .format(subsystem, fan, rpm, status, failed_reads))
+
+    def fan_uuids(self, subsystem):
+        fans = self.vsctl('get Subsystem {} fans'.format(subsystem))
+        return [fan.strip() for fan in fans.strip('[] \n').split(',')]
+
+    def fans(self):
+        """name, status, rpm and speed of every fan"""
+        output = self.vsctl('--format=csv --data=bare --no-headings '
+                            '--columns=name,status,rpm,speed list Fan')
+        fans = []
+        for line in output.splitlines():
+            if line.strip():
+                name, status, rpm, speed = line.strip().split(',')
+                fans.append({'name': name, 'status': status,
+                             'rpm': int(rpm or 0), 'speed': speed})
+        return fans
+
+    def wait(self, condition, timeout=10):
+        """ovs-vsctl wait-until CONDITION, true if it became true"""
+        output = self.bash('ovs-vsctl --db={} --timeout={} wait-until {} '
+                           '>/dev/null 2>&1 && echo MET || echo TIMEOUT'
+                           .format(self.db, timeout, condition))
+        return 'MET' in output
+
+    def wait_fans(self, subsystem, condition, timeout=10):
+        """wait until CONDITION holds for every fan of the subsystem"""
+        return all(self.wait('Fan {} {}'.format(fan, condition), timeout)
+                   for fan in self.fan_uuids(subsystem))
+
+    def replay(self, trace):
+        """Replay a trace of this instance into a scratch database, and
+        return the summary and whether the replay matched the trace."""
+        output = self.bash(
+            'ovsdb-tool create {d}/replay.db {schema}; '
+            'ovsdb-server {d}/replay.db --remote=punix:{d}/replay.sock '
+            '--unixctl={d}/replay-db.ctl --pidfile={d}/replay-db.pid '
+            '--detach; '
+            'ops-fand --replay={trace} --unixctl={d}/replay.ctl '
+            '--wear-log= --flight-recorder= unix:{d}/replay.sock '
+            '&& echo REPLAY_OK || echo REPLAY_DIVERGED; '
+            'ovs-appctl -t {d}/replay-db.ctl exit'
+            .format(d=self.dir, schema=SCHEMA, trace=trace))
+        return output, 'REPLAY_OK' in output
+
+    def stop_clock(self):
+        self.appctl('time/stop')
+
+    def warp(self, msec):
+        """advance the stopped clock, and let ops-fand run at the new time"""
+        self.appctl('time/warp {}'.format(msec))
+        # a command is served after the main loop ran at the new time
+        self.appctl('ops-fand/dump')
+
+    def dump(self):
+        return self.appctl('ops-fand/dump')
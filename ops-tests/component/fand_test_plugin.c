@@ -0,0 +1,143 @@
+/*
+ *  (c) Copyright 2015 Hewlett Packard Enterprise Development LP
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License. You may obtain
+ *  a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *  License for the specific language governing permissions and limitations
+ *  under the License.
+ */
+
+/************************************************************************//**
+ * @ingroup ops-fand
+ *
+ * @file
+ * Vendor driver plugin of the component tests (test_fand_ct_plugin.py).
+ *
+ * Every fan reads as running at FAND_TEST_RPM plus its index. What the
+ * plugin is told is written to files in the hardware description
+ * directory, for the test to check: the speed setting to fand-test-speed,
+ * and the FRU statuses followed by the subsystem's to fand-test-leds.
+ *
+ * Built in variants: FAND_TEST_NO_LEDS leaves out the LED hook, and
+ * FAND_TEST_API_VERSION gives the API version it claims.
+ ***************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "fand-plugin.h"
+
+#ifndef FAND_TEST_API_VERSION
+#define FAND_TEST_API_VERSION FAND_PLUGIN_API_VERSION
+#endif
+
+#define FAND_TEST_RPM 6000
+
+struct fand_test {
+    char *dir;
+};
+
+static void *
+fand_test_open(const char *subsystem_name, const char *hw_desc_dir,
+               size_t n_frus, const size_t *fru_first_fan)
+{
+    struct fand_test *test = calloc(1, sizeof(*test));
+
+    if (test != NULL) {
+        test->dir = strdup(hw_desc_dir);
+    }
+    return(test);
+}
+
+static void
+fand_test_close(void *data)
+{
+    struct fand_test *test = data;
+
+    free(test->dir);
+    free(test);
+}
+
+static void
+fand_test_sample(void *data, size_t n_fans, uint32_t *rpm, int *rc,
+                 uint8_t *status)
+{
+    size_t idx;
+
+    for (idx = 0; idx < n_fans; idx++) {
+        rpm[idx] = FAND_TEST_RPM + idx;
+        rc[idx] = 0;
+        status[idx] = FAND_STATUS_OK;
+    }
+}
+
+/* replace a file of the hardware description directory with 'text' */
+static int
+fand_test_write(const struct fand_test *test, const char *name,
+                const char *text)
+{
+    char path[512];
+    FILE *file;
+
+    snprintf(path, sizeof(path), "%s/%s", test->dir, name);
+    file = fopen(path, "w");
+    if (file == NULL) {
+        return(-1);
+    }
+    fputs(text, file);
+    fclose(file);
+    return(0);
+}
+
+static int
+fand_test_set_speed(void *data, uint32_t hw_value)
+{
+    char text[16];
+
+    snprintf(text, sizeof(text), "%u\n", hw_value);
+    return(fand_test_write(data, "fand-test-speed", text));
+}
+
+#ifndef FAND_TEST_NO_LEDS
+static int
+fand_test_set_leds(void *data, size_t n_frus, const uint8_t *fru_status,
+                   uint8_t subsystem_status)
+{
+    char text[256];
+    size_t len = 0;
+    size_t idx;
+
+    for (idx = 0; idx < n_frus && len < sizeof(text) - 8; idx++) {
+        len += snprintf(text + len, sizeof(text) - len, "%u ",
+                        fru_status[idx]);
+    }
+    snprintf(text + len, sizeof(text) - len, "%u\n", subsystem_status);
+    return(fand_test_write(data, "fand-test-leds", text));
+}
+#endif
+
+static const struct fand_plugin_ops fand_test_ops = {
+    .api_version = FAND_TEST_API_VERSION,
+    .name = "fand-test",
+    .open = fand_test_open,
+    .close = fand_test_close,
+    .sample = fand_test_sample,
+    .set_speed = fand_test_set_speed,
+#ifndef FAND_TEST_NO_LEDS
+    .set_leds = fand_test_set_leds,
+#endif
+};
+
+const struct fand_plugin_ops *
+fand_plugin_init(void)
+{
+    return(&fand_test_ops);
+}
@@ -0,0 +1,109 @@
+# -*- coding: utf-8 -*-
+
+# (c) Copyright 2016 Hewlett Packard Enterprise Development LP
+#
+# GNU Zebra is free software; you can redistribute it and/or modify it
+# under the terms of the GNU General Public License as published by the
+# Free Software Foundation; either version 2, or (at your option) any
+# later version.
+#
+# GNU Zebra is distributed in the hope that it will be useful, but
+# WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+# General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with GNU Zebra; see the file COPYING.  If not, write to the Free
+# Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+# 02111-1307, USA.
+
+from fand_sim import POLL_MSEC, SimFand, base_hw_desc_dir
+
+TOPOLOGY = """
+# +-------+
+# |  sw1  |
+# +-------+
+
+# Nodes
+[type=openswitch name="Switch 1"] sw1
+"""
+
+RPM = 8000
+# a persistent outlier is accepted after this many polls
+OUTLIER_LIMIT = 2
+
+
+def rpm_of(sim, name):
+    return [fan['rpm'] for fan in sim.fans() if fan['name'] == name][0]
+
+
+def near(rpm, expected):
+    return abs(rpm - expected) <= expected // 10
+
+
+def test_fand_ct_filter(topology, step):
+    sw1 = topology.get('sw1')
+    sim = SimFand(sw1, 'filter')
+
+    step('Start ops-fand with a median filter and outlier rejection')
+    sim.start()
+    try:
+        sim.create_subsystem('sim', base_hw_desc_dir(sw1),
+                             {'fan_rpm_filter': 'median',
+                              'fan_rpm_filter_window': 3,
+                              'fan_rpm_outlier_pct': 50,
+                              'fan_rpm_outlier_limit': OUTLIER_LIMIT,
+                              'fan_tach_word_read': 'true'})
+        sim.insert_all_frus('sim')
+        name = sim.fans()[0]['name']
+        for fan in sim.fans():
+            sim.set_fan('sim', fan['name'], RPM)
+        sim.stop_clock()
+        for _ in range(3):
+            sim.warp(POLL_MSEC)
+        steady = rpm_of(sim, name)
+        assert near(steady, RPM), steady
+
+        step('Verify a single spike is not published')
+        sim.set_fan('sim', name, 3 * RPM)
+        sim.warp(POLL_MSEC)
+        assert rpm_of(sim, name) == steady
+        sim.set_fan('sim', name, RPM)
+        sim.warp(POLL_MSEC)
+        assert rpm_of(sim, name) == steady
+
+        step('Verify a lasting change of speed is published')
+        sim.set_fan('sim', name, RPM // 4)
+        for _ in range(OUTLIER_LIMIT):
+            sim.warp(POLL_MSEC)
+            assert rpm_of(sim, name) == steady
+        sim.warp(POLL_MSEC)
+        assert near(rpm_of(sim, name), RPM // 4), rpm_of(sim, name)
+        sim.set_fan('sim', name, RPM)
+        for _ in range(OUTLIER_LIMIT + 1):
+            sim.warp(POLL_MSEC)
+        steady = rpm_of(sim, name)
+        assert near(steady, RPM), steady
+
+        step('Verify a failed tach read holds the filtered value')
+        sim.set_fan('sim', name, RPM, failed_reads=OUTLIER_LIMIT)
+        for _ in range(OUTLIER_LIMIT):
+            sim.warp(POLL_MSEC)
+            assert rpm_of(sim, name) == steady
+        # a good read ends the run of failures
+        sim.warp(POLL_MSEC)
+        assert rpm_of(sim, name) == steady
+
+        step('Verify a tach that keeps failing reads as stopped')
+        sim.set_fan('sim', name, RPM, failed_reads=100)
+        for _ in range(OUTLIER_LIMIT):
+            sim.warp(POLL_MSEC)
+        sim.warp(POLL_MSEC)
+        assert rpm_of(sim, name) == 0
+
+        step('Verify the fan spinning up again is published at once')
+        sim.set_fan('sim', name, RPM)
+        sim.warp(POLL_MSEC)
+        assert near(rpm_of(sim, name), RPM), rpm_of(sim, name)
+    finally:
+        sim.stop()
@@ -0,0 +1,125 @@
+# -*- coding: utf-8 -*-
+
+# (c) Copyright 2016 Hewlett Packard Enterprise Development LP
+#
+# GNU Zebra is free software; you can redistribute it and/or modify it
+# under the terms of the GNU General Public License as published by the
+# Free Software Foundation; either version 2, or (at your option) any
+# later version.
+#
+# GNU Zebra is distributed in the hope that it will be useful, but
+# WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+# General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with GNU Zebra; see the file COPYING.  If not, write to the Free
+# Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+# 02111-1307, USA.
+from time import sleep
+
+from fand_sim import POLL_MSEC, SimFand, base_hw_desc_dir
+
+TOPOLOGY = """
+# +-------+
+# |  sw1  |
+# +-------+
+
+# Nodes
+[type=openswitch name="Switch 1"] sw1
+"""
+
+# a poll every 5 seconds
+POLL_WAIT = 12
+EXPORT_FILE = '/tmp/fand-flight-export.txt'
+RPM = 8000
+# a freeze takes the window up to a minute after the event
+POST_MSEC = 60000
+
+
+def samples(sw1, subsystem):
+    output = sw1('ovs-appctl -t ops-fand ops-fand/flight-export', shell='bash')
+    assert '# live' in output, output
+    return [line for line in output.split('\n')
+            if line.split(' ')[1:2] == [subsystem]]
+
+
+def test_fand_ct_flight(topology, step):
+    sw1 = topology.get('sw1')
+
+    step('Verify the flight recorder is on and samples the base subsystem')
+    sleep(POLL_WAIT)
+    output = sw1('ovs-appctl -t ops-fand ops-fand/dump', shell='bash')
+    assert 'Flight recorder: ' in output
+    assert 'Flight recorder: off' not in output
+    lines = samples(sw1, 'base')
+    assert lines
+    assert ' speed=' in lines[-1] and ' fans=' in lines[-1], lines[-1]
+
+    step('Verify a speed change is recorded right away')
+    sw1('ovs-vsctl set Subsystem base other_config:fan_speed_override=fast',
+        shell='bash')
+    sleep(POLL_WAIT)
+    assert 'override=fast' in samples(sw1, 'base')[-1]
+    sw1('ovs-vsctl remove Subsystem base other_config fan_speed_override',
+        shell='bash')
+
+    step('Verify the export can go to a file')
+    sw1('ovs-appctl -t ops-fand ops-fand/flight-export {}'
+        .format(EXPORT_FILE), shell='bash')
+    output = sw1('cat {}; rm -f {}'.format(EXPORT_FILE, EXPORT_FILE),
+                 shell='bash')
+    assert '# live' in output
+
+
+def sim_samples(sim, subsystem):
+    # the recorder is opened once the instance has taken control
+    for _ in range(50):
+        output = sim.appctl('ops-fand/flight-export')
+        if '# live' in output:
+            break
+        sleep(0.2)
+    assert '# live' in output, output
+    return output, [line for line in output.split('\n')
+                    if line.split(' ')[1:2] == [subsystem]]
+
+
+def test_fand_ct_flight_freeze(topology, step):
+    sw1 = topology.get('sw1')
+    sim = SimFand(sw1, 'flight')
+    recorder = '--flight-recorder={}/flight'.format(sim.dir)
+
+    step('Run a simulated subsystem with a flight recorder')
+    sim.start(recorder)
+    try:
+        sim.create_subsystem('sim', base_hw_desc_dir(sw1))
+        sim.insert_all_frus('sim')
+        for fan in sim.fans():
+            sim.set_fan('sim', fan['name'], RPM)
+        sim.stop_clock()
+        sim.warp(POLL_MSEC)
+        output, _ = sim_samples(sim, 'sim')
+        assert '# frozen window' not in output
+
+        step('Verify a move to max freezes the window a minute later')
+        sim.set_other_config('sim', 'fan_speed_override', 'max')
+        assert sim.wait_fans('sim', 'speed=max')
+        sim.warp(POLL_MSEC)
+        output, _ = sim_samples(sim, 'sim')
+        assert '# frozen window' not in output
+        for _ in range(POST_MSEC // POLL_MSEC + 1):
+            sim.warp(POLL_MSEC)
+        output, before = sim_samples(sim, 'sim')
+        assert '# frozen window' in output, output
+        assert 'of subsystem sim' in output, output
+        assert any('override=max' in line for line in before), before
+
+        step('Verify the samples are still exported after a restart')
+        sim.stop_fand()
+        sim.start_fand(recorder)
+        output, after = sim_samples(sim, 'sim')
+        assert '# frozen window' in output, output
+        missing = [line for line in before if line not in after]
+        assert not missing, missing
+    finally:
+        sim.stop()
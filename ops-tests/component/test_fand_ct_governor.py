@@ -0,0 +1,105 @@
+# -*- coding: utf-8 -*-
+
+# (c) Copyright 2016 Hewlett Packard Enterprise Development LP
+#
+# GNU Zebra is free software; you can redistribute it and/or modify it
+# under the terms of the GNU General Public License as published by the
+# Free Software Foundation; either version 2, or (at your option) any
+# later version.
+#
+# GNU Zebra is distributed in the hope that it will be useful, but
+# WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+# General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with GNU Zebra; see the file COPYING.  If not, write to the Free
+# Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+# 02111-1307, USA.
+import re
+
+from fand_sim import POLL_MSEC, SimFand, base_hw_desc_dir
+
+TOPOLOGY = """
+# +-------+
+# |  sw1  |
+# +-------+
+
+# Nodes
+[type=openswitch name="Switch 1"] sw1
+"""
+
+DWELL_MSEC = 30000
+SLEW_INTERVAL_MSEC = 1000
+
+
+def governor(sim):
+    match = re.search(r'Speed governor: (\w+), register (-?\d+) '
+                      r'\(target (-?\d+)\)', sim.dump())
+    assert match, 'no speed governor in the dump'
+    return match.group(1), int(match.group(2)), int(match.group(3))
+
+
+def speeds(sim):
+    return set(fan['speed'] for fan in sim.fans())
+
+
+def test_fand_ct_governor(topology, step):
+    sw1 = topology.get('sw1')
+    sim = SimFand(sw1, 'governor')
+
+    step('Start ops-fand on the simulated bus with a down dwell')
+    sim.start()
+    try:
+        sim.create_subsystem('sim', base_hw_desc_dir(sw1),
+                             {'fan_speed_down_dwell': DWELL_MSEC},
+                             fan_state='fast')
+        sim.insert_all_frus('sim')
+        sim.stop_clock()
+        sim.warp(POLL_MSEC)
+        assert sim.wait_fans('sim', 'speed=fast')
+
+        step('Verify a lower speed waits for the dwell time')
+        sim.set_fan_state('sim', 'normal')
+        sim.warp(DWELL_MSEC // 2)
+        assert speeds(sim) == set(['fast'])
+        assert governor(sim)[0] == 'fast'
+        sim.warp(DWELL_MSEC)
+        assert sim.wait_fans('sim', 'speed=normal')
+
+        step('Verify a higher speed is applied right away')
+        sim.set_fan_state('sim', 'fast')
+        assert sim.wait_fans('sim', 'speed=fast')
+
+        step('Verify an interrupted lower request starts the dwell over')
+        sim.set_fan_state('sim', 'normal')
+        sim.warp(DWELL_MSEC // 2)
+        sim.set_fan_state('sim', 'fast')
+        sim.warp(1)
+        sim.set_fan_state('sim', 'normal')
+        sim.warp(DWELL_MSEC // 2 + 1)
+        assert speeds(sim) == set(['fast'])
+        sim.warp(DWELL_MSEC)
+        assert sim.wait_fans('sim', 'speed=normal')
+
+        step('Verify the speed register moves by the slew per interval')
+        sim.set_other_config('sim', 'fan_speed_down_dwell', 0)
+        sim.set_other_config('sim', 'fan_speed_slew', 1)
+        sim.set_other_config('sim', 'fan_speed_slew_interval',
+                             SLEW_INTERVAL_MSEC)
+        sim.warp(SLEW_INTERVAL_MSEC)
+        level, start, target = governor(sim)
+        assert level == 'normal' and start == target
+        sim.set_fan_state('sim', 'max')
+        assert sim.wait_fans('sim', 'speed=max')
+        _, value, target = governor(sim)
+        assert target != start, 'normal and max share a register value'
+        direction = 1 if target > start else -1
+        for steps in range(1, 4):
+            if value == target:
+                break
+            assert value == start + direction * steps, (value, start)
+            sim.warp(SLEW_INTERVAL_MSEC)
+            _, value, _ = governor(sim)
+    finally:
+        sim.stop()
@@ -0,0 +1,111 @@
+# -*- coding: utf-8 -*-
+
+# (c) Copyright 2016 Hewlett Packard Enterprise Development LP
+#
+# GNU Zebra is free software; you can redistribute it and/or modify it
+# under the terms of the GNU General Public License as published by the
+# Free Software Foundation; either version 2, or (at your option) any
+# later version.
+#
+# GNU Zebra is distributed in the hope that it will be useful, but
+# WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+# General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with GNU Zebra; see the file COPYING.  If not, write to the Free
+# Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+# 02111-1307, USA.
+
+from time import sleep
+
+from fand_sim import base_hw_desc_dir
+
+TOPOLOGY = """
+# +-------+
+# |  sw1  |
+# +-------+
+
+# Nodes
+[type=openswitch name="Switch 1"] sw1
+"""
+
+# A fake hwmon device in a temp directory stands in for the kernel driver.
+HWMON_DIR = '/tmp/fand-hwmon-test'
+MAX_FANS = 16
+# a poll every 5 seconds
+POLL_WAIT = 12
+
+
+def create_fake_hwmon(sw1):
+    sw1('rm -rf {dir}; mkdir -p {dir}; '
+        'for i in $(seq 1 {n}); do '
+        'echo $((1000 + i)) > {dir}/fan${{i}}_input; '
+        'echo 0 > {dir}/fan${{i}}_fault; '
+        'echo 0 > {dir}/pwm$i; '
+        'echo 2 > {dir}/pwm${{i}}_enable; '
+        'done'.format(dir=HWMON_DIR, n=MAX_FANS), shell='bash')
+
+
+def read_attr(sw1, name):
+    output = sw1('cat {}/{}'.format(HWMON_DIR, name), shell='bash')
+    return output.strip()
+
+
+def fan_column(sw1, column):
+    # a column of each of the hwmon subsystem's fans
+    values = []
+    fans = sw1('ovs-vsctl get Subsystem hwmon fans', shell='bash')
+    for fan in fans.strip('[] \n').split(','):
+        value = sw1('ovs-vsctl get Fan {} {}'.format(fan.strip(), column),
+                    shell='bash')
+        values.append(value.strip().strip('"'))
+    return values
+
+
+def fan_rpms(sw1):
+    return [int(rpm) for rpm in fan_column(sw1, 'rpm')]
+
+
+def test_fand_ct_hwmon(topology, step):
+    sw1 = topology.get('sw1')
+    hw_desc_dir = base_hw_desc_dir(sw1)
+
+    step('Create a fake hwmon device and a subsystem that uses it')
+    create_fake_hwmon(sw1)
+    sw1('ovs-vsctl create Subsystem name=hwmon hw_desc_dir={} '
+        'other_config:fan_hwmon_dir={}'.format(hw_desc_dir, HWMON_DIR),
+        shell='bash')
+    sw1('ovs-vsctl --timeout=30 wait-until Subsystem hwmon \'fans!=[]\'',
+        shell='bash')
+    sleep(POLL_WAIT)
+
+    step('Verify the rpm comes from fanN_input, unscaled')
+    rpms = fan_rpms(sw1)
+    assert rpms
+    for rpm in rpms:
+        assert 1000 < rpm <= 1000 + MAX_FANS, rpms
+
+    step('Verify pwm control was taken over and a speed written')
+    assert read_attr(sw1, 'pwm1_enable') == '1'
+    sw1('ovs-vsctl set Subsystem hwmon other_config:fan_speed_override=max',
+        shell='bash')
+    sleep(POLL_WAIT)
+    pwm_max = read_attr(sw1, 'pwm1')
+    sw1('ovs-vsctl set Subsystem hwmon other_config:fan_speed_override=slow',
+        shell='bash')
+    sleep(POLL_WAIT)
+    pwm_slow = read_attr(sw1, 'pwm1')
+    assert int(pwm_max) > int(pwm_slow), (pwm_max, pwm_slow)
+
+    step('Verify a new tach reading and a fault are picked up')
+    sw1('echo 4321 > {dir}/fan1_input; echo 1 > {dir}/fan1_fault'
+        .format(dir=HWMON_DIR), shell='bash')
+    sleep(POLL_WAIT)
+    assert 4321 in fan_rpms(sw1)
+    output = sw1('ovs-appctl -t ops-fand ops-fand/dump', shell='bash')
+    assert 'Fan backend: hwmon {}'.format(HWMON_DIR) in output
+    assert 'fault' in fan_column(sw1, 'status')
+
+    sw1('ovs-vsctl destroy Subsystem hwmon; rm -rf {}'.format(HWMON_DIR),
+        shell='bash')
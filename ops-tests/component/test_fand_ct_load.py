@@ -0,0 +1,100 @@
+# -*- coding: utf-8 -*-
+
+# (c) Copyright 2016 Hewlett Packard Enterprise Development LP
+#
+# GNU Zebra is free software; you can redistribute it and/or modify it
+# under the terms of the GNU General Public License as published by the
+# Free Software Foundation; either version 2, or (at your option) any
+# later version.
+#
+# GNU Zebra is distributed in the hope that it will be useful, but
+# WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+# General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with GNU Zebra; see the file COPYING.  If not, write to the Free
+# Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+# 02111-1307, USA.
+from time import sleep
+
+from fand_sim import POLL_MSEC, SimFand, base_hw_desc_dir
+
+TOPOLOGY = """
+# +-------+
+# |  sw1  |
+# +-------+
+
+# Nodes
+[type=openswitch name="Switch 1"] sw1
+"""
+
+RPM = 8000
+LINK_SPEED = 10000000000
+# the interface counters are sampled every second
+LOAD_SAMPLE_MSEC = 1000
+
+
+def settle(sim):
+    """a poll's worth of load samples, given time to reach the db"""
+    for _ in range(POLL_MSEC // LOAD_SAMPLE_MSEC):
+        sleep(0.2)
+        sim.warp(LOAD_SAMPLE_MSEC)
+    sleep(0.5)
+
+
+def fan_speeds(sim):
+    return [fan['speed'] for fan in sim.fans()]
+
+
+def test_fand_ct_load(topology, step):
+    sw1 = topology.get('sw1')
+    sim = SimFand(sw1, 'load')
+
+    step('Enable the load feed-forward of a simulated subsystem')
+    sim.start()
+    try:
+        sim.create_subsystem('sim', base_hw_desc_dir(sw1),
+                             {'fan_load_gain': 2,
+                              'fan_load_decay': 60000})
+        sim.insert_all_frus('sim')
+        for fan in sim.fans():
+            sim.set_fan('sim', fan['name'], RPM)
+        sim.vsctl('-- --id=@i create Interface name=sim1 link_speed={} '
+                  'statistics:rx_bytes=1000 statistics:tx_bytes=0 '
+                  '-- add Subsystem sim interfaces @i'.format(LINK_SPEED))
+        sim.stop_clock()
+        settle(sim)
+        output = sim.dump()
+        assert 'Load feed-forward: gain 2, decay 60000 msec' in output, output
+        assert 'boost 0' in output, output
+        assert 'normal' in fan_speeds(sim)
+
+        step('Verify a jump of the interface load raises the fan speed')
+        # far more than the link could carry: full load
+        sim.vsctl('set Interface sim1 statistics:rx_bytes={}'
+                  .format(1000 + 100 * LINK_SPEED))
+        settle(sim)
+        output = sim.dump()
+        assert 'load 100%' in output, output
+        assert 'boost 2' in output, output
+        for speed in fan_speeds(sim):
+            assert speed == 'fast'
+
+        step('Verify an override is not boosted')
+        sim.set_other_config('sim', 'fan_speed_override', 'slow')
+        settle(sim)
+        for speed in fan_speeds(sim):
+            assert speed == 'slow'
+
+        step('Verify the boost goes away with the gain')
+        sim.vsctl('remove Subsystem sim other_config fan_speed_override '
+                  '-- remove Subsystem sim other_config fan_load_gain '
+                  '-- remove Subsystem sim other_config fan_load_decay')
+        settle(sim)
+        output = sim.dump()
+        assert 'Load feed-forward' not in output
+        for speed in fan_speeds(sim):
+            assert speed == 'normal'
+    finally:
+        sim.stop()
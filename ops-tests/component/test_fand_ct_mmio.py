@@ -0,0 +1,87 @@
+# -*- coding: utf-8 -*-
+
+# (c) Copyright 2016 Hewlett Packard Enterprise Development LP
+#
+# GNU Zebra is free software; you can redistribute it and/or modify it
+# under the terms of the GNU General Public License as published by the
+# Free Software Foundation; either version 2, or (at your option) any
+# later version.
+#
+# GNU Zebra is distributed in the hope that it will be useful, but
+# WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+# General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with GNU Zebra; see the file COPYING.  If not, write to the Free
+# Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+# 02111-1307, USA.
+
+import re
+from time import sleep
+
+from fand_sim import base_hw_desc_dir
+
+TOPOLOGY = """
+# +-------+
+# |  sw1  |
+# +-------+
+
+# Nodes
+[type=openswitch name="Switch 1"] sw1
+"""
+
+# A plain file stands in for the register window of a PCIe CPLD.
+WINDOW = '/tmp/fand-mmio-test'
+WINDOW_SIZE = 65536
+# a poll every 5 seconds
+POLL_WAIT = 12
+
+
+def get_fan_device(sw1, hw_desc_dir):
+    # a device that the fan registers of the description are on
+    output = sw1('grep -m1 "device:" {}/fans.yaml'.format(hw_desc_dir),
+                 shell='bash')
+    match = re.search(r'device:\s*([\w.-]+)', output)
+    assert match, 'no fan device in ' + hw_desc_dir
+    return match.group(1)
+
+
+def mapped_counters(sw1):
+    output = sw1('ovs-appctl -t ops-fand ops-fand/dump', shell='bash')
+    match = re.search(r'Mapped registers: (\S+) at (\S+) '
+                      r'\((\d+) bytes, (\d+) reads, (\d+) writes\)', output)
+    assert match, 'the registers are not mapped'
+    return int(match.group(4)), int(match.group(5))
+
+
+def test_fand_ct_mmio(topology, step):
+    sw1 = topology.get('sw1')
+    hw_desc_dir = base_hw_desc_dir(sw1)
+    device = get_fan_device(sw1, hw_desc_dir)
+
+    step('Map the registers of {} from a file'.format(device))
+    sw1('dd if=/dev/zero of={} bs={} count=1'.format(WINDOW, WINDOW_SIZE),
+        shell='bash')
+    sw1('ovs-vsctl create Subsystem name=mmio hw_desc_dir={} '
+        'other_config:fan_mmio_device={} '
+        'other_config:fan_mmio_path={}'.format(hw_desc_dir, device, WINDOW),
+        shell='bash')
+    sw1('ovs-vsctl --timeout=30 wait-until Subsystem mmio \'fans!=[]\'',
+        shell='bash')
+
+    step('Verify the polls access the mapped registers')
+    reads, writes = mapped_counters(sw1)
+    sleep(POLL_WAIT)
+    more_reads, more_writes = mapped_counters(sw1)
+    assert more_reads + more_writes > reads + writes
+
+    step('Verify the mapping goes with the setting')
+    sw1('ovs-vsctl remove Subsystem mmio other_config fan_mmio_path',
+        shell='bash')
+    sleep(POLL_WAIT)
+    output = sw1('ovs-appctl -t ops-fand ops-fand/dump', shell='bash')
+    assert 'Mapped registers' not in output
+
+    sw1('ovs-vsctl destroy Subsystem mmio; rm -f {}'.format(WINDOW),
+        shell='bash')
@@ -0,0 +1,112 @@
+# -*- coding: utf-8 -*-
+
+# (c) Copyright 2016 Hewlett Packard Enterprise Development LP
+#
+# GNU Zebra is free software; you can redistribute it and/or modify it
+# under the terms of the GNU General Public License as published by the
+# Free Software Foundation; either version 2, or (at your option) any
+# later version.
+#
+# GNU Zebra is distributed in the hope that it will be useful, but
+# WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+# General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with GNU Zebra; see the file COPYING.  If not, write to the Free
+# Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+# 02111-1307, USA.
+import re
+
+from fand_sim import POLL_MSEC, SimFand, plugin_hw_desc_dir
+
+TOPOLOGY = """
+# +-------+
+# |  sw1  |
+# +-------+
+
+# Nodes
+[type=openswitch name="Switch 1"] sw1
+"""
+
+# the rpm every fan of the test plugin reads as, plus its index
+PLUGIN_RPM = 6000
+RPM = 8000
+
+
+def subsystem_fans(sim, subsystem):
+    return [fan for fan in sim.fans()
+            if fan['name'].startswith(subsystem + '-')]
+
+
+def read_file(sim, path):
+    return sim.bash('cat {} 2>/dev/null; true'.format(path)).strip()
+
+
+def test_fand_ct_plugin(topology, step):
+    sw1 = topology.get('sw1')
+    sim = SimFand(sw1, 'plugin')
+    trace = sim.dir + '/fand.trace'
+
+    step('Start ops-fand with a subsystem driven by the test plugin')
+    sim.start('--record=' + trace)
+    try:
+        full = plugin_hw_desc_dir(sim, 'full', 'fand-test')
+        sim.create_subsystem('full', full)
+        sim.insert_all_frus('full')
+        sim.stop_clock()
+        sim.warp(POLL_MSEC)
+        assert 'Fan plugin: fand-test (hooks: sample set_speed set_leds)' in \
+            sim.dump()
+
+        step('Verify the fans are read through the plugin')
+        fans = subsystem_fans(sim, 'full')
+        assert fans
+        for fan in fans:
+            assert PLUGIN_RPM <= fan['rpm'] < PLUGIN_RPM + len(fans), fan
+
+        step('Verify the speed and LEDs are set through the plugin')
+        normal = read_file(sim, full + '/fand-test-speed')
+        assert normal, 'the plugin was not given a speed'
+        sim.set_fan_state('full', 'max')
+        sim.warp(POLL_MSEC)
+        assert sim.wait_fans('full', 'speed=max')
+        assert read_file(sim, full + '/fand-test-speed') != normal
+        leds = read_file(sim, full + '/fand-test-leds').split()
+        # every FRU and the subsystem are ok (1)
+        assert leds and set(leds) == {'1'}, leds
+
+        step('Verify the hooks a plugin leaves out go to the registers')
+        no_leds = plugin_hw_desc_dir(sim, 'noleds', 'fand-test-no-leds')
+        sim.create_subsystem('noleds', no_leds)
+        sim.insert_all_frus('noleds')
+        sim.warp(POLL_MSEC)
+        assert 'Fan plugin: fand-test (hooks: sample set_speed)' in sim.dump()
+        assert read_file(sim, no_leds + '/fand-test-speed')
+        assert not read_file(sim, no_leds + '/fand-test-leds')
+
+        step('Verify a plugin of another API version is refused')
+        bad_api = plugin_hw_desc_dir(sim, 'badapi', 'fand-test-bad-api')
+        sim.create_subsystem('badapi', bad_api)
+        sim.insert_all_frus('badapi')
+        for fan in subsystem_fans(sim, 'badapi'):
+            sim.set_fan('badapi', fan['name'], RPM)
+        sim.warp(POLL_MSEC)
+        log = read_file(sim, sim.dir + '/ops-fand.log')
+        assert re.search(r'fand-test-bad-api\.so: .*wrong API version', log)
+        assert not read_file(sim, bad_api + '/fand-test-speed')
+        # the registers of the hardware description drive its fans
+        assert sim.wait_fans('badapi', 'status=ok')
+        for fan in subsystem_fans(sim, 'badapi'):
+            assert abs(fan['rpm'] - RPM) <= RPM // 10, fan
+        sim.stop_fand()
+
+        step('Verify a replay checks what the plugin was given')
+        output, ok = sim.replay(trace)
+        assert ok, output
+        writes = re.search(r'register writes: (\d+) \((\d+) diverged, '
+                           r'(\d+) recorded but not reproduced\)', output)
+        assert writes and int(writes.group(1)) > 0, output
+        assert writes.group(2) == '0' and writes.group(3) == '0', output
+    finally:
+        sim.stop()
@@ -0,0 +1,173 @@
+# -*- coding: utf-8 -*-
+
+# (c) Copyright 2016 Hewlett Packard Enterprise Development LP
+#
+# GNU Zebra is free software; you can redistribute it and/or modify it
+# under the terms of the GNU General Public License as published by the
+# Free Software Foundation; either version 2, or (at your option) any
+# later version.
+#
+# GNU Zebra is distributed in the hope that it will be useful, but
+# WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+# General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with GNU Zebra; see the file COPYING.  If not, write to the Free
+# Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+# 02111-1307, USA.
+import re
+
+from fand_sim import POLL_MSEC, SimFand, base_hw_desc_dir
+
+TOPOLOGY = """
+# +-------+
+# |  sw1  |
+# +-------+
+
+# Nodes
+[type=openswitch name="Switch 1"] sw1
+"""
+
+RPM = 8000
+
+
+def test_fand_ct_poll_presence(topology, step):
+    sw1 = topology.get('sw1')
+    sim = SimFand(sw1, 'poll')
+
+    step('Start ops-fand on the simulated bus with all fans running')
+    sim.start()
+    try:
+        sim.create_subsystem('sim', base_hw_desc_dir(sw1))
+        frus = sim.insert_all_frus('sim')
+        assert frus, 'no fan FRU with a presence bit'
+        fans = [fan['name'] for fan in sim.fans()]
+        for fan in fans:
+            sim.set_fan('sim', fan, RPM)
+        sim.stop_clock()
+        sim.warp(POLL_MSEC)
+        assert sim.wait_fans('sim', 'status=ok')
+
+        step('Remove a FRU and let a poll see it absent')
+        sim.set_fru_present('sim', frus[0], 'absent')
+        sim.warp(POLL_MSEC)
+        removed = [fan['name'] for fan in sim.fans()
+                   if fan['status'] == 'fault']
+        assert removed
+
+        step('Verify a FRU inserted without an event is read by one poll')
+        # only the poll sees the FRU: its fans are read in that same pass,
+        # and kept since the FRU is present
+        assert sim.set_fru_present('sim', frus[0], 'present', 'no-event')
+        for fan in removed:
+            sim.set_fan('sim', fan, RPM)
+        sim.warp(POLL_MSEC)
+        assert sim.wait_fans('sim', 'status=ok')
+        for fan in sim.fans():
+            assert fan['status'] == 'ok', fan
+            assert fan['rpm'] > 0, fan
+    finally:
+        sim.stop()
+
+
+def mux_switches(sim):
+    """mux paths of the plan, and mux switches of the last poll"""
+    dump = sim.dump()
+    paths = int(re.search(r'Poll plan: \d+ reads on (\d+) mux paths',
+                          dump).group(1))
+    last = int(re.search(r'Mux switches per poll: (\d+) last',
+                         dump).group(1))
+    return paths, last
+
+
+def test_fand_ct_poll_mux_order(topology, step):
+    sw1 = topology.get('sw1')
+    sim = SimFand(sw1, 'mux')
+
+    step('Start ops-fand on the simulated bus with all FRUs inserted')
+    sim.start()
+    try:
+        sim.create_subsystem('sim', base_hw_desc_dir(sw1))
+        sim.insert_all_frus('sim')
+        for fan in sim.fans():
+            sim.set_fan('sim', fan['name'], RPM)
+        sim.stop_clock()
+        sim.warp(POLL_MSEC)
+        assert sim.wait_fans('sim', 'status=ok')
+
+        step('Verify a poll selects each mux path once')
+        # presence and fans in one pass by mux path
+        for _ in range(3):
+            sim.warp(POLL_MSEC)
+            paths, last = mux_switches(sim)
+            assert last <= paths, (last, paths)
+
+        step('Verify a poll with a budget selects it once per tier')
+        sim.set_other_config('sim', 'fan_poll_budget', 1000)
+        for _ in range(3):
+            sim.warp(POLL_MSEC)
+            paths, last = mux_switches(sim)
+            assert last <= 4 * paths, (last, paths)
+    finally:
+        sim.stop()
+
+
+def bus_locks(sim):
+    """lock waits, timeouts and recoveries, and polls put off"""
+    dump = sim.dump()
+    locks = re.search(r'Bus lock waits: (\d+) \((\d+) timed out, '
+                      r'(\d+) recovered\)', dump)
+    put_off = re.search(r'Polls: \d+ \((\d+) put off', dump)
+    assert locks and put_off, dump
+    return [int(count) for count in locks.groups() + put_off.groups()]
+
+
+def test_fand_ct_poll_bus_lock(topology, step):
+    sw1 = topology.get('sw1')
+    sim = SimFand(sw1, 'bus-lock')
+    locks = sim.dir + '/locks'
+
+    step('Start ops-fand on the simulated bus, taking bus locks')
+    sim.start('--bus-lock-dir=' + locks)
+    try:
+        sim.bash('mkdir -p ' + locks)
+        sim.create_subsystem('sim', base_hw_desc_dir(sw1))
+        sim.insert_all_frus('sim')
+        for fan in sim.fans():
+            sim.set_fan('sim', fan['name'], RPM)
+        sim.stop_clock()
+        sim.warp(POLL_MSEC)
+        files = sim.bash('ls {}/i2c-bus-*.lock'.format(locks)).split()
+        assert files, 'no bus lock taken'
+        assert bus_locks(sim)[:3] == [0, 0, 0]
+
+        step('Hold the bus locks, and verify a poll waits for them')
+        for lock in files:
+            # -o: the lock goes with flock, not with the sleep
+            sim.bash('flock -o -n {} sleep 600 </dev/null >/dev/null 2>&1 '
+                     '& echo $! >> {}/holders'.format(lock, sim.dir))
+        sim.bash('sleep 0.5')
+        sim.warp(POLL_MSEC)
+        waits, timeouts, _, put_off = bus_locks(sim)
+        assert waits >= 1 and timeouts == 0 and put_off >= 1
+
+        step('Verify the poll goes ahead once the wait timed out')
+        for _ in range(10 * len(files)):
+            sim.warp(10)
+        waits, timeouts, recoveries, put_off = bus_locks(sim)
+        assert timeouts >= 1 and recoveries == 0
+        # the poll resumed where it stopped and finished
+        assert sim.wait_fans('sim', 'status=ok')
+
+        step('Release the locks, and verify they are taken again')
+        sim.bash('kill $(cat {}/holders); sleep 0.5'.format(sim.dir))
+        sim.warp(POLL_MSEC)
+        waits, timeouts, recoveries, _ = bus_locks(sim)
+        assert recoveries >= 1
+        sim.warp(POLL_MSEC)
+        # no more waiting, nor going ahead
+        assert bus_locks(sim)[:3] == [waits, timeouts, recoveries]
+    finally:
+        sim.bash('kill $(cat {}/holders) 2>/dev/null; true'.format(sim.dir))
+        sim.stop()
@@ -0,0 +1,100 @@
+# -*- coding: utf-8 -*-
+
+# (c) Copyright 2016 Hewlett Packard Enterprise Development LP
+#
+# GNU Zebra is free software; you can redistribute it and/or modify it
+# under the terms of the GNU General Public License as published by the
+# Free Software Foundation; either version 2, or (at your option) any
+# later version.
+#
+# GNU Zebra is distributed in the hope that it will be useful, but
+# WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+# General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with GNU Zebra; see the file COPYING.  If not, write to the Free
+# Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+# 02111-1307, USA.
+from time import sleep
+
+from fand_sim import base_hw_desc_dir
+
+TOPOLOGY = """
+# +-------+
+# |  sw1  |
+# +-------+
+
+# Nodes
+[type=openswitch name="Switch 1"] sw1
+"""
+
+# A copy of the base hardware description with a fan-power file, and a fake
+# hwmon device so that every fan runs at a known rpm.
+HW_DESC_DIR = '/tmp/fand-power-test'
+HWMON_DIR = '/tmp/fand-power-hwmon'
+MAX_FANS = 16
+RPM = 10000
+# a poll every 5 seconds
+POLL_WAIT = 12
+# the power is published once a minute
+PUBLISH_WAIT = 70
+
+
+def create_test_dirs(sw1, hw_desc_dir):
+    # every fan draws 12 W at 10000 rpm, 2 W of it at any speed
+    sw1('rm -rf {desc} {hwmon}; cp -r {base} {desc}; '
+        'echo "* 12 10000 2" > {desc}/fan-power; mkdir -p {hwmon}; '
+        'for i in $(seq 1 {n}); do '
+        'echo {rpm} > {hwmon}/fan${{i}}_input; '
+        'done'.format(desc=HW_DESC_DIR, hwmon=HWMON_DIR, base=hw_desc_dir,
+                      n=MAX_FANS, rpm=RPM), shell='bash')
+
+
+def fan_other_config(sw1, key):
+    values = []
+    fans = sw1('ovs-vsctl get Subsystem power fans', shell='bash')
+    for fan in fans.strip('[] \n').split(','):
+        value = sw1('ovs-vsctl get Fan {} other_config:{}'
+                    .format(fan.strip(), key), shell='bash')
+        values.append(float(value.strip().strip('"')))
+    return values
+
+
+def test_fand_ct_power(topology, step):
+    sw1 = topology.get('sw1')
+    hw_desc_dir = base_hw_desc_dir(sw1)
+
+    step('Create a subsystem whose hardware description has power models')
+    create_test_dirs(sw1, hw_desc_dir)
+    sw1('ovs-vsctl create Subsystem name=power hw_desc_dir={} '
+        'other_config:fan_hwmon_dir={}'.format(HW_DESC_DIR, HWMON_DIR),
+        shell='bash')
+    sw1('ovs-vsctl --timeout=30 wait-until Subsystem power \'fans!=[]\'',
+        shell='bash')
+    sleep(POLL_WAIT)
+
+    step('Verify the power of each fan and the energy counters')
+    output = sw1('ovs-appctl -t ops-fand ops-fand/power power', shell='bash')
+    assert 'Subsystem power: ' in output
+    assert 'FRU ' in output
+    assert '12.0 W' in output, output
+    first = sw1('ovs-appctl -t ops-fand ops-fand/dump', shell='bash')
+    assert 'Fan power: ' in first
+
+    step('Verify the power and energy are published to other_config')
+    sleep(PUBLISH_WAIT)
+    for watts in fan_other_config(sw1, 'power_watts'):
+        assert watts == 12.0
+    for joules in fan_other_config(sw1, 'energy_joules'):
+        assert joules > 0
+
+    step('Verify a slower fan draws less, by the cube of its speed')
+    sw1('echo {} > {}/fan1_input'.format(RPM // 2, HWMON_DIR), shell='bash')
+    sleep(POLL_WAIT)
+    output = sw1('ovs-appctl -t ops-fand ops-fand/power power', shell='bash')
+    # 2 + 10 / 8 W
+    assert '3.2 W' in output or '3.3 W' in output, output
+
+    sw1('ovs-vsctl destroy Subsystem power; rm -rf {} {}'
+        .format(HW_DESC_DIR, HWMON_DIR), shell='bash')
@@ -0,0 +1,73 @@
+# -*- coding: utf-8 -*-
+
+# (c) Copyright 2016 Hewlett Packard Enterprise Development LP
+#
+# GNU Zebra is free software; you can redistribute it and/or modify it
+# under the terms of the GNU General Public License as published by the
+# Free Software Foundation; either version 2, or (at your option) any
+# later version.
+#
+# GNU Zebra is distributed in the hope that it will be useful, but
+# WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+# General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with GNU Zebra; see the file COPYING.  If not, write to the Free
+# Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+# 02111-1307, USA.
+from fand_sim import POLL_MSEC, SimFand, base_hw_desc_dir
+
+TOPOLOGY = """
+# +-------+
+# |  sw1  |
+# +-------+
+
+# Nodes
+[type=openswitch name="Switch 1"] sw1
+"""
+
+RPM = 8000
+
+
+def test_fand_ct_redundancy(topology, step):
+    sw1 = topology.get('sw1')
+    sim = SimFand(sw1, 'redundancy')
+
+    step('Start ops-fand on the simulated bus with a redundancy step')
+    sim.start()
+    try:
+        sim.create_subsystem('sim', base_hw_desc_dir(sw1),
+                             {'fan_redundancy_step': 1})
+        frus = sim.insert_all_frus('sim')
+        fans = [fan['name'] for fan in sim.fans()]
+        for fan in fans:
+            sim.set_fan('sim', fan, RPM)
+        sim.stop_clock()
+        sim.warp(POLL_MSEC)
+        assert sim.wait_fans('sim', 'status=ok')
+        assert sim.wait_fans('sim', 'speed=normal')
+        assert 'Redundancy step: 1 (not degraded)' in sim.dump()
+
+        step('Verify a faulted fan raises the speed of the others')
+        sim.set_fan('sim', fans[0], 0, 'fault')
+        sim.warp(POLL_MSEC)
+        assert sim.wait_fans('sim', 'speed=medium')
+        assert 'Redundancy step: 1 (degraded)' in sim.dump()
+
+        step('Verify the speed is restored when the fan recovers')
+        sim.set_fan('sim', fans[0], RPM)
+        sim.warp(POLL_MSEC)
+        assert sim.wait_fans('sim', 'speed=normal')
+
+        step('Verify a removed FRU raises the speed without a poll')
+        assert frus, 'no fan FRU with a presence bit'
+        sim.set_fru_present('sim', frus[0], 'absent')
+        assert sim.wait_fans('sim', 'speed=medium')
+        assert any(fan['status'] == 'fault' for fan in sim.fans())
+
+        step('Verify the speed is restored when the FRU is back')
+        sim.set_fru_present('sim', frus[0], 'present')
+        assert sim.wait_fans('sim', 'speed=normal')
+    finally:
+        sim.stop()
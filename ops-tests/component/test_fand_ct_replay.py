@@ -0,0 +1,118 @@
+# -*- coding: utf-8 -*-
+
+# (c) Copyright 2016 Hewlett Packard Enterprise Development LP
+#
+# GNU Zebra is free software; you can redistribute it and/or modify it
+# under the terms of the GNU General Public License as published by the
+# Free Software Foundation; either version 2, or (at your option) any
+# later version.
+#
+# GNU Zebra is distributed in the hope that it will be useful, but
+# WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+# General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with GNU Zebra; see the file COPYING.  If not, write to the Free
+# Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+# 02111-1307, USA.
+import re
+from time import sleep
+
+from fand_sim import POLL_MSEC, SimFand, base_hw_desc_dir
+
+TOPOLOGY = """
+# +-------+
+# |  sw1  |
+# +-------+
+
+# Nodes
+[type=openswitch name="Switch 1"] sw1
+"""
+
+RPM = 8000
+LINK_SPEED = 10000000000
+# the interface counters are sampled every second
+LOAD_SAMPLE_MSEC = 1000
+
+
+def test_fand_ct_replay(topology, step):
+    sw1 = topology.get('sw1')
+    sim = SimFand(sw1, 'replay')
+    trace = sim.dir + '/fand.trace'
+
+    step('Record a run of ops-fand on the simulated bus')
+    sim.start('--record=' + trace)
+    try:
+        sim.create_subsystem('sim', base_hw_desc_dir(sw1),
+                             {'fan_redundancy_step': 1,
+                              'fan_speed_down_dwell': 10000})
+        frus = sim.insert_all_frus('sim')
+        for fan in sim.fans():
+            sim.set_fan('sim', fan['name'], RPM)
+        sim.stop_clock()
+        for fan_state in ['fast', 'normal', 'max', 'slow']:
+            sim.set_fan_state('sim', fan_state)
+            sim.warp(POLL_MSEC)
+        if frus:
+            sim.set_fru_present('sim', frus[0], 'absent')
+            sim.warp(POLL_MSEC)
+            sim.set_fru_present('sim', frus[0], 'present')
+        sim.set_fan('sim', sim.fans()[0]['name'], 0, 'fault')
+        for _ in range(4):
+            sim.warp(POLL_MSEC)
+        sim.stop_fand()
+
+        step('Verify the replay makes the same register writes')
+        output, ok = sim.replay(trace)
+        assert ok, output
+        writes = re.search(r'register writes: (\d+) \((\d+) diverged, '
+                           r'(\d+) recorded but not reproduced\)', output)
+        assert writes, output
+        assert int(writes.group(1)) > 0
+        assert writes.group(2) == '0' and writes.group(3) == '0', output
+        assert 'register reads: ' in output and '(0 not in trace)' in output
+        if frus:
+            assert 'presence events: 0' not in output, output
+    finally:
+        sim.stop()
+
+
+def test_fand_ct_replay_load(topology, step):
+    sw1 = topology.get('sw1')
+    sim = SimFand(sw1, 'replay-load')
+    trace = sim.dir + '/fand.trace'
+
+    step('Record a run of ops-fand with the load feed-forward')
+    sim.start('--record=' + trace)
+    try:
+        sim.create_subsystem('sim', base_hw_desc_dir(sw1),
+                             {'fan_load_gain': 2,
+                              'fan_load_decay': 60000})
+        sim.insert_all_frus('sim')
+        for fan in sim.fans():
+            sim.set_fan('sim', fan['name'], RPM)
+        sim.vsctl('-- --id=@i create Interface name=sim1 link_speed={} '
+                  'statistics:rx_bytes=1000 statistics:tx_bytes=0 '
+                  '-- add Subsystem sim interfaces @i'.format(LINK_SPEED))
+        sim.stop_clock()
+        # the interfaces arrive over a few samples
+        for _ in range(10):
+            sleep(0.2)
+            sim.warp(LOAD_SAMPLE_MSEC)
+        sim.vsctl('set Interface sim1 statistics:rx_bytes={}'
+                  .format(1000 + 100 * LINK_SPEED))
+        for _ in range(5):
+            sleep(0.2)
+            sim.warp(LOAD_SAMPLE_MSEC)
+        output = sim.dump()
+        assert 'boost 2' in output, output
+        sim.stop_fand()
+
+        step('Verify the replay takes the recorded load samples')
+        output, ok = sim.replay(trace)
+        assert ok, output
+        loads = re.search(r'load samples: (\d+)', output)
+        assert loads and int(loads.group(1)) > 0, output
+    finally:
+        sim.stop()
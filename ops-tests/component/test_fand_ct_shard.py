@@ -0,0 +1,92 @@
+# -*- coding: utf-8 -*-
+
+# (c) Copyright 2016 Hewlett Packard Enterprise Development LP
+#
+# GNU Zebra is free software; you can redistribute it and/or modify it
+# under the terms of the GNU General Public License as published by the
+# Free Software Foundation; either version 2, or (at your option) any
+# later version.
+#
+# GNU Zebra is distributed in the hope that it will be useful, but
+# WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+# General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with GNU Zebra; see the file COPYING.  If not, write to the Free
+# Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+# 02111-1307, USA.
+import re
+from time import sleep
+
+from fand_sim import SimFand, base_hw_desc_dir
+
+TOPOLOGY = """
+# +-------+
+# |  sw1  |
+# +-------+
+
+# Nodes
+[type=openswitch name="Switch 1"] sw1
+"""
+
+
+def dump_subsystems(sim):
+    return set(re.findall(r'^Subsystem: (\S+)$', sim.dump(), re.M))
+
+
+def exists(sim, name):
+    return 'YES' in sim.bash('test -e {}/{} && echo YES; true'
+                             .format(sim.dir, name))
+
+
+def test_fand_ct_shard(topology, step):
+    sw1 = topology.get('sw1')
+    shard_a = SimFand(sw1, 'shard')
+    shard_b = SimFand(sw1, 'b', peer=shard_a)
+    # a second instance of shard a, which must wait for the first one
+    spare_a = SimFand(sw1, 'spare', peer=shard_a)
+
+    step('Start two shards on one database')
+    shard_a.start('--shard=a', files=True)
+    try:
+        shard_b.start_fand('--shard=b', '--subsystems=b*', files=True)
+        hw = base_hw_desc_dir(sw1)
+        shard_a.create_subsystem('a1', hw, {'fan_shard': 'a'})
+        # tagged for shard a, whatever the patterns of shard b say
+        shard_a.create_subsystem('b1', hw, {'fan_shard': 'a'})
+        shard_a.create_subsystem('b2', hw)
+        # untagged, and no shard has a pattern for it
+        shard_a.vsctl('create Subsystem name=c1 hw_desc_dir={}'.format(hw))
+
+        step('Verify each shard handles only its own subsystems')
+        assert 'Shard: a' in shard_a.dump()
+        assert 'Shard: b' in shard_b.dump()
+        assert dump_subsystems(shard_a) == {'a1', 'b1'}
+        assert dump_subsystems(shard_b) == {'b2'}
+        for subsystem in ['a1', 'b1', 'b2']:
+            fans = [fan['name'] for fan in shard_a.fans()
+                    if fan['name'].startswith(subsystem + '-')]
+            assert fans and \
+                len(fans) == len(shard_a.fan_uuids(subsystem)), subsystem
+        sleep(1)
+        assert shard_a.vsctl('get Subsystem c1 fans').strip() == '[]'
+
+        step('Verify each shard takes its own lock')
+        spare_a.start_fand('--shard=a')
+        sleep(1)
+        log = shard_a.bash('cat {}/{}.log'.format(shard_a.dir, spare_a.fand))
+        assert 'another ops-fand process is running' in log, log
+        assert dump_subsystems(shard_b) == {'b2'}
+        spare_a.stop_fand()
+
+        step('Verify each shard has its own wear log and flight recorder')
+        for name in ['ops-fand-a-wear.log', 'ops-fand-a-flight',
+                     'ops-fand-b-wear.log', 'ops-fand-b-flight']:
+            assert exists(shard_a, name), name
+        assert not exists(shard_a, 'ops-fand-wear.log')
+        assert not exists(shard_a, 'ops-fand-flight')
+    finally:
+        spare_a.stop()
+        shard_b.stop()
+        shard_a.stop()
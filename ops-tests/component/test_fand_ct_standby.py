@@ -0,0 +1,97 @@
+# -*- coding: utf-8 -*-
+
+# (c) Copyright 2016 Hewlett Packard Enterprise Development LP
+#
+# GNU Zebra is free software; you can redistribute it and/or modify it
+# under the terms of the GNU General Public License as published by the
+# Free Software Foundation; either version 2, or (at your option) any
+# later version.
+#
+# GNU Zebra is distributed in the hope that it will be useful, but
+# WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+# General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with GNU Zebra; see the file COPYING.  If not, write to the Free
+# Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+# 02111-1307, USA.
+from time import sleep, time
+
+from fand_sim import SimFand, plugin_hw_desc_dir
+
+TOPOLOGY = """
+# +-------+
+# |  sw1  |
+# +-------+
+
+# Nodes
+[type=openswitch name="Switch 1"] sw1
+"""
+
+
+def wait_dump(sim, text, timeout=10):
+    """wait until the instance's dump shows TEXT"""
+    deadline = time() + timeout
+    while time() < deadline:
+        if text in sim.dump():
+            return True
+        sleep(0.2)
+    return False
+
+
+def read_file(sim, path):
+    return sim.bash('cat {} 2>/dev/null; true'.format(path)).strip()
+
+
+def rows(sim):
+    """the Fan rows of the subsystem, by uuid"""
+    fans = {fan['name']: fan for fan in sim.fans()}
+    return {uuid: fans[sim.vsctl('get Fan {} name'.format(uuid))
+                       .strip().strip('"')]
+            for uuid in sim.fan_uuids('sim')}
+
+
+def test_fand_ct_standby(topology, step):
+    sw1 = topology.get('sw1')
+    sim = SimFand(sw1, 'standby')
+    # the test plugin writes the speed and LEDs it is given to files of
+    # the hardware description, which both instances share
+    standby = SimFand(sw1, 'peer', peer=sim)
+
+    step('Start an active and a standby ops-fand on one database')
+    sim.start()
+    try:
+        hw = plugin_hw_desc_dir(sim, 'sim', 'fand-test')
+        sim.create_subsystem('sim', hw, fan_state='fast')
+        sim.insert_all_frus('sim')
+        assert sim.wait_fans('sim', 'status=ok speed=fast')
+        standby.start_fand('--standby')
+        assert wait_dump(standby, 'Subsystem: sim')
+        assert 'Role: standby' in standby.dump()
+        standby.insert_all_frus('sim')
+        # let the standby follow a poll of the active instance
+        sleep(1)
+        before = rows(sim)
+        speed = read_file(sim, hw + '/fand-test-speed')
+        leds = read_file(sim, hw + '/fand-test-leds')
+        assert speed and leds
+
+        step('Kill the active instance and verify the standby takes over')
+        sim.kill_fand()
+        assert wait_dump(standby, 'Role: active')
+        # the new active instance polls right away
+        sleep(1)
+
+        step('Verify the rows and the hardware are left as they were')
+        assert rows(sim) == before
+        assert read_file(sim, hw + '/fand-test-speed') == speed
+        assert read_file(sim, hw + '/fand-test-leds') == leds
+
+        step('Verify the new active instance drives the fans')
+        sim.set_fan_state('sim', 'max')
+        assert sim.wait_fans('sim', 'speed=max')
+        assert read_file(sim, hw + '/fand-test-speed') != speed
+    finally:
+        standby.stop()
+        sim.stop()
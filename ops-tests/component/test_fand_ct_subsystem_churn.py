@@ -0,0 +1,77 @@
+# -*- coding: utf-8 -*-
+
+# (c) Copyright 2016 Hewlett Packard Enterprise Development LP
+#
+# GNU Zebra is free software; you can redistribute it and/or modify it
+# under the terms of the GNU General Public License as published by the
+# Free Software Foundation; either version 2, or (at your option) any
+# later version.
+#
+# GNU Zebra is distributed in the hope that it will be useful, but
+# WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+# General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with GNU Zebra; see the file COPYING.  If not, write to the Free
+# Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+# 02111-1307, USA.
+from fand_sim import base_hw_desc_dir
+
+TOPOLOGY = """
+# +-------+
+# |  sw1  |
+# +-------+
+
+# Nodes
+[type=openswitch name="Switch 1"] sw1
+"""
+
+# Line-card style insert/remove cycles. The first WARMUP cycles let the
+# allocator settle; the remaining ones must not grow ops-fand's RSS by
+# more than MAX_RSS_GROWTH_KB.
+WARMUP = 100
+CYCLES = 2000
+MAX_RSS_GROWTH_KB = 512
+
+
+def get_fand_rss_kb(sw1):
+    output = sw1('grep VmRSS /proc/$(pidof ops-fand)/status', shell='bash')
+    for line in output.split('\n'):
+        if 'VmRSS' in line:
+            return int(line.split()[1])
+    assert False, 'unable to read ops-fand RSS'
+
+
+def churn_subsystems(sw1, hw_desc_dir, cycles):
+    # Add a subsystem, wait for ops-fand to create its fans, then remove
+    # it again. This runs on the switch to keep the loop fast.
+    output = sw1('for i in $(seq 1 {cycles}); do '
+                 'u=$(ovs-vsctl create Subsystem name=churn '
+                 'hw_desc_dir={dir}); '
+                 'ovs-vsctl --timeout=10 wait-until Subsystem $u '
+                 '\'fans!=[]\' || echo CHURN_TIMEOUT; '
+                 'ovs-vsctl destroy Subsystem $u; '
+                 'done'.format(cycles=cycles, dir=hw_desc_dir),
+                 shell='bash')
+    assert 'CHURN_TIMEOUT' not in output
+
+
+def test_fand_ct_subsystem_churn(topology, step):
+    sw1 = topology.get('sw1')
+    hw_desc_dir = base_hw_desc_dir(sw1)
+
+    step('Warm up subsystem insert/remove')
+    churn_subsystems(sw1, hw_desc_dir, WARMUP)
+    rss_before = get_fand_rss_kb(sw1)
+
+    step('Insert and remove a subsystem {} times'.format(CYCLES))
+    churn_subsystems(sw1, hw_desc_dir, CYCLES)
+    rss_after = get_fand_rss_kb(sw1)
+
+    step('Verify ops-fand memory use stayed flat')
+    assert rss_after - rss_before <= MAX_RSS_GROWTH_KB, \
+        'ops-fand RSS grew from {} kB to {} kB'.format(rss_before, rss_after)
+
+    output = sw1('ovs-appctl -t ops-fand ops-fand/dump', shell='bash')
+    assert 'Subsystem: churn' not in output
@@ -0,0 +1,66 @@
+# -*- coding: utf-8 -*-
+
+# (c) Copyright 2016 Hewlett Packard Enterprise Development LP
+#
+# GNU Zebra is free software; you can redistribute it and/or modify it
+# under the terms of the GNU General Public License as published by the
+# Free Software Foundation; either version 2, or (at your option) any
+# later version.
+#
+# GNU Zebra is distributed in the hope that it will be useful, but
+# WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+# General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with GNU Zebra; see the file COPYING.  If not, write to the Free
+# Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+# 02111-1307, USA.
+from fand_sim import POLL_MSEC, SimFand, base_hw_desc_dir
+
+TOPOLOGY = """
+# +-------+
+# |  sw1  |
+# +-------+
+
+# Nodes
+[type=openswitch name="Switch 1"] sw1
+"""
+
+RPM = 8000
+
+
+def test_fand_ct_thermal_alert(topology, step):
+    sw1 = topology.get('sw1')
+    sim = SimFand(sw1, 'alert')
+
+    step('Start ops-fand on the simulated bus at normal speed')
+    sim.start()
+    try:
+        sim.create_subsystem('sim', base_hw_desc_dir(sw1))
+        sim.insert_all_frus('sim')
+        for fan in sim.fans():
+            sim.set_fan('sim', fan['name'], RPM)
+        sim.stop_clock()
+        sim.warp(POLL_MSEC)
+        assert sim.wait_fans('sim', 'speed=normal')
+
+        step('Verify an asserted alert drives the fans to max at once')
+        # no poll: the alert is handled as soon as it fires
+        sim.appctl('ops-fand/sim-thermal-alert sim asserted')
+        assert sim.wait_fans('sim', 'speed=max')
+        assert 'Thermal alert: asserted (1 alerts' in sim.dump()
+
+        step('Verify the alert wins over a lower override')
+        sim.set_other_config('sim', 'fan_speed_override', 'slow')
+        sim.warp(POLL_MSEC)
+        assert sim.wait_fans('sim', 'speed=max')
+
+        step('Verify the speed goes back when the alert clears')
+        sim.appctl('ops-fand/sim-thermal-alert sim clear')
+        assert sim.wait_fans('sim', 'speed=slow')
+        assert 'Thermal alert: clear' in sim.dump()
+        sim.vsctl('remove Subsystem sim other_config fan_speed_override')
+        assert sim.wait_fans('sim', 'speed=normal')
+    finally:
+        sim.stop()
@@ -0,0 +1,164 @@
+# -*- coding: utf-8 -*-
+
+# (c) Copyright 2016 Hewlett Packard Enterprise Development LP
+#
+# GNU Zebra is free software; you can redistribute it and/or modify it
+# under the terms of the GNU General Public License as published by the
+# Free Software Foundation; either version 2, or (at your option) any
+# later version.
+#
+# GNU Zebra is distributed in the hope that it will be useful, but
+# WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+# General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with GNU Zebra; see the file COPYING.  If not, write to the Free
+# Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+# 02111-1307, USA.
+import re
+from time import sleep
+
+from fand_sim import POLL_MSEC, SimFand, base_hw_desc_dir
+
+TOPOLOGY = """
+# +-------+
+# |  sw1  |
+# +-------+
+
+# Nodes
+[type=openswitch name="Switch 1"] sw1
+"""
+
+# a poll every 5 seconds
+POLL_WAIT = 12
+RPM = 8000
+# the wear log is synced every 5 minutes
+SYNC_MSEC = 5 * 60 * 1000
+
+
+def wear_lines(sw1):
+    output = sw1('ovs-appctl -t ops-fand ops-fand/dump', shell='bash')
+    lines = output.split('\n')
+    assert '    Fan wear:' in lines, output
+    return [line.strip() for line in lines if ' h run (' in line]
+
+
+def test_fand_ct_wear(topology, step):
+    sw1 = topology.get('sw1')
+
+    step('Verify every fan FRU of the base subsystem has wear counters')
+    sleep(POLL_WAIT)
+    lines = wear_lines(sw1)
+    assert lines
+    for line in lines:
+        assert line.startswith('FRU ')
+        for level in ['slow', 'normal', 'medium', 'fast', 'max']:
+            assert ' {} '.format(level) in line, line
+        assert line.endswith(' faults'), line
+
+
+
+def wear_counters(sim):
+    """run hours, starts, stops and faults of each FRU, by FRU number"""
+    counters = {}
+    for match in re.finditer(r'FRU (\d+): ([\d.]+) h run \(.*\), '
+                             r'(\d+) starts, (\d+) stops, (\d+) faults',
+                             sim.dump()):
+        counters[int(match.group(1))] = (float(match.group(2)),
+                                         int(match.group(3)),
+                                         int(match.group(4)),
+                                         int(match.group(5)))
+    return counters
+
+
+def assert_restored(before, after):
+    assert sorted(before) == sorted(after), (before, after)
+    for fru in before:
+        # at most the time since the last sync is lost
+        assert after[fru][0] >= before[fru][0] - 0.1, (fru, before, after)
+        assert after[fru][1:] == before[fru][1:], (fru, before, after)
+
+
+def restart(sim, log):
+    """restart ops-fand on the wear log, and wait for its counters"""
+    sim.stop_fand()
+    sim.start_fand('--wear-log=' + log)
+    for _ in range(50):
+        counters = wear_counters(sim)
+        if counters:
+            return counters
+        sleep(0.2)
+    return {}
+
+
+def log_lines(sim, log):
+    return [line for line in sim.bash('cat ' + log).split('\n')
+            if line.strip()]
+
+
+def test_fand_ct_wear_log(topology, step):
+    sw1 = topology.get('sw1')
+    sim = SimFand(sw1, 'wear')
+    log = sim.dir + '/wear.log'
+
+    step('Run the fans of a simulated subsystem with a wear log')
+    sim.start('--wear-log=' + log)
+    try:
+        sim.create_subsystem('sim', base_hw_desc_dir(sw1))
+        sim.insert_all_frus('sim')
+        fans = [fan['name'] for fan in sim.fans()]
+        for fan in fans:
+            sim.set_fan('sim', fan, RPM)
+        sim.stop_clock()
+        sim.warp(POLL_MSEC)
+        sim.set_fan('sim', fans[0], 0, 'fault')
+        sim.warp(POLL_MSEC)
+        sim.set_fan('sim', fans[0], RPM)
+        for _ in range(3):
+            sim.warp(SYNC_MSEC)
+        before = wear_counters(sim)
+        assert before
+        assert any(counter[1] > 0 for counter in before.values())
+        assert any(counter[3] > 0 for counter in before.values())
+
+        step('Verify the counters are restored by a restart')
+        # the first poll after a start only learns the state of the fans
+        assert_restored(before, restart(sim, log))
+
+        step('Verify a torn line and a line with a bad hash are skipped')
+        sim.stop_fand()
+        valid = log_lines(sim, log)
+        assert valid
+        key = valid[-1].split()[0]
+        # the right fields with the wrong hash, then half a line
+        bad = '{} 1 1 1 1 1 1 999 999 999 00000000'.format(key)
+        torn = valid[-1][:len(valid[-1]) // 2]
+        sim.bash("printf '%s\\n%s' '{}' '{}' >> {}".format(bad, torn, log))
+        assert_restored(before, restart(sim, log))
+
+        step('Verify the log was compacted to a line per FRU')
+        lines = log_lines(sim, log)
+        keys = set(line.split()[0] for line in lines)
+        assert len(lines) == len(keys), lines
+        assert not any(' 999 ' in line for line in lines), lines
+        assert torn not in lines
+
+        step('Verify a log that grew too long is compacted')
+        sim.stop_fand()
+        sim.bash('cp {l} {l}.copy; for i in $(seq 1 100); do '
+                 'cat {l}.copy >> {l}; done; rm {l}.copy'.format(l=log))
+        grown = len(log_lines(sim, log))
+        assert grown > 100 * len(keys)
+        assert_restored(before, restart(sim, log))
+        # a start is synced at once, and the sync compacts the log
+        sim.stop_clock()
+        sim.insert_all_frus('sim')
+        for fan in fans:
+            sim.set_fan('sim', fan, RPM)
+        sim.warp(POLL_MSEC)
+        sim.warp(POLL_MSEC)
+        compacted = len(log_lines(sim, log))
+        assert compacted <= 2 * len(keys), (compacted, grown)
+    finally:
+        sim.stop()
@@ -0,0 +1,106 @@
+#!/usr/bin/env python
+# -*- coding: utf-8 -*-
+
+# (c) Copyright 2016 Hewlett Packard Enterprise Development LP
+#
+# Licensed under the Apache License, Version 2.0 (the "License"); you may
+# not use this file except in compliance with the License. You may obtain
+# a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+# WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+# License for the specific language governing permissions and limitations
+# under the License.
+
+"""Steady-state allocation check for ops-fand.
+
+Starts a private ovsdb-server and ops-fand on the simulated bus (the same
+setup as fand_scale_soak.py), creates SUBSYSTEMS subsystems, lets WARMUP
+poll cycles go by, and then fails if the poll and control path allocates
+any heap memory during the next CYCLES poll cycles. Nothing is changed in
+the database meanwhile, so every poll is a steady-state one.
+
+ops-fand must be built with -DFAND_ALLOC_STATS=ON, which adds the
+"Poll path allocations" line to ops-fand/dump.
+
+Example:
+  fand_alloc_check.py --hw-desc-dir /etc/openswitch/hwdesc --cycles 20
+"""
+
+from __future__ import print_function
+
+import argparse
+import re
+import sys
+import time
+
+from fand_scale_soak import Harness
+
+POLL_INTERVAL = 5
+
+
+def parse_args():
+    parser = argparse.ArgumentParser(description=__doc__.split('\n')[0])
+    parser.add_argument('--hw-desc-dir', required=True,
+                        help='hardware description used by every subsystem')
+    parser.add_argument('--schema',
+                        default='/usr/share/openvswitch/vswitch.ovsschema')
+    parser.add_argument('--fand', default='ops-fand',
+                        help='ops-fand binary to test')
+    parser.add_argument('--subsystems', type=int, default=4)
+    parser.add_argument('--warmup', type=int, default=2,
+                        help='poll cycles before counting')
+    parser.add_argument('--cycles', type=int, default=20,
+                        help='poll cycles that must not allocate')
+    parser.add_argument('--keep', action='store_true',
+                        help='keep the work directory (logs, database)')
+    return parser.parse_args()
+
+
+def counters(harness):
+    dump = harness.appctl('ops-fand/dump')
+    allocs = re.search(r'^Poll path allocations: (\d+)', dump, re.M)
+    assert allocs, 'ops-fand was not built with FAND_ALLOC_STATS'
+    polls = int(re.search(r'^Polls: (\d+)', dump, re.M).group(1))
+    return polls, int(allocs.group(1))
+
+
+def wait_cycles(harness, args, cycles):
+    # a cycle is one poll of every subsystem
+    polls_start, _ = counters(harness)
+    target = polls_start + cycles * args.subsystems
+    deadline = time.time() + (cycles + 2) * POLL_INTERVAL
+    while True:
+        polls, allocs = counters(harness)
+        if polls >= target:
+            return polls, allocs
+        assert time.time() < deadline, 'ops-fand stopped polling'
+        time.sleep(1)
+
+
+def main():
+    args = parse_args()
+    harness = Harness(args)
+
+    try:
+        harness.start()
+        harness.create_subsystems()
+        polls_start, allocs_start = wait_cycles(harness, args, args.warmup)
+        polls, allocs = wait_cycles(harness, args, args.cycles)
+    finally:
+        harness.stop()
+
+    print('polls: {}'.format(polls - polls_start))
+    print('allocations: {}'.format(allocs - allocs_start))
+    if allocs != allocs_start:
+        print('FAILED: the steady-state poll path allocated memory')
+        return 1
+    print('PASSED')
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,128 @@
+#!/usr/bin/env python
+# -*- coding: utf-8 -*-
+
+# (c) Copyright 2016 Hewlett Packard Enterprise Development LP
+#
+# Licensed under the Apache License, Version 2.0 (the "License"); you may
+# not use this file except in compliance with the License. You may obtain
+# a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+# WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+# License for the specific language governing permissions and limitations
+# under the License.
+
+"""Target RPM control check for ops-fand.
+
+Starts a private ovsdb-server and ops-fand on the simulated bus (the same
+setup as fand_scale_soak.py) with one subsystem, sets its fan_rpm_targets,
+and makes each LOOP (DEVICE:TARGET:TACH:SIZE, all registers of the
+hardware description) an emulated closed-loop controller whose tach
+register follows its speed control register. MODE is the fan_rpm_mode
+that puts the controller in target rpm mode. It then overrides the speed
+to each level in turn, and fails if the rpm ops-fand publishes for the
+first fan doesn't settle within TOLERANCE percent of the level's target
+in SETTLE seconds.
+
+Example:
+  fand_rpm_loop_check.py --hw-desc-dir /etc/openswitch/hwdesc \\
+      --loop fan_ctrl:0x30:0x20:2 --mode fan_ctrl:0x02:0x80:0x80 \\
+      --targets 3000,5000,8000,11000,15000
+"""
+
+from __future__ import print_function
+
+import argparse
+import sys
+import time
+
+from fand_scale_soak import Harness
+
+LEVELS = ['slow', 'normal', 'medium', 'fast', 'max']
+
+
+def parse_args():
+    parser = argparse.ArgumentParser(description=__doc__.split('\n')[0])
+    parser.add_argument('--hw-desc-dir', required=True,
+                        help='hardware description of the subsystem')
+    parser.add_argument('--schema',
+                        default='/usr/share/openvswitch/vswitch.ovsschema')
+    parser.add_argument('--fand', default='ops-fand',
+                        help='ops-fand binary to test')
+    parser.add_argument('--loop', action='append', required=True,
+                        help='DEVICE:TARGET:TACH:SIZE of an emulated '
+                             'controller (repeatable)')
+    parser.add_argument('--mode', required=True,
+                        help='DEVICE:REGISTER:MASK:VALUE that selects target '
+                             'rpm mode (fan_rpm_mode)')
+    parser.add_argument('--targets', default='3000,5000,8000,11000,15000',
+                        help='rpm of the slow, normal, ..., max speeds')
+    parser.add_argument('--tolerance', type=float, default=5,
+                        help='percent the rpm may be off its target')
+    parser.add_argument('--settle', type=float, default=30,
+                        help='seconds a level may take to settle')
+    parser.add_argument('--keep', action='store_true',
+                        help='keep the work directory (logs, database)')
+    args = parser.parse_args()
+    args.subsystems = 1
+    return args
+
+
+def fan_rpm(harness, fan):
+    return int(harness.vsctl('get', 'Fan', fan, 'rpm').strip())
+
+
+def settle(harness, args, fan, target):
+    # the rpm is published once per poll, after the tach follows the
+    # target for a while
+    deadline = time.time() + args.settle
+    rpm = None
+    while time.time() < deadline:
+        rpm = fan_rpm(harness, fan)
+        if abs(rpm - target) * 100.0 <= target * args.tolerance:
+            return True, rpm
+        time.sleep(1)
+    return False, rpm
+
+
+def main():
+    args = parse_args()
+    targets = [int(rpm) for rpm in args.targets.split(',')]
+    assert len(targets) == len(LEVELS), 'expected five targets'
+    harness = Harness(args)
+    failures = []
+
+    try:
+        harness.start()
+        harness.create_subsystems()
+        subsystem = harness.sensors[0][0]
+        for loop in args.loop:
+            harness.appctl('ops-fand/sim-rpm-loop', subsystem,
+                           *loop.split(':'))
+        harness.vsctl('set', 'Subsystem', subsystem,
+                      'other_config:fan_rpm_mode=' + args.mode,
+                      'other_config:fan_rpm_targets=' + args.targets)
+
+        fan = harness.first_fan(subsystem)
+        for level, target in zip(LEVELS, targets):
+            harness.vsctl('set', 'Subsystem', subsystem,
+                          'other_config:fan_speed_override=' + level)
+            ok, rpm = settle(harness, args, fan, target)
+            print('{}: target {} rpm {}'.format(level, target, rpm))
+            if not ok:
+                failures.append(level)
+    finally:
+        harness.stop()
+
+    if failures:
+        print('FAILED:', ', '.join(failures))
+        return 1
+    print('PASSED')
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
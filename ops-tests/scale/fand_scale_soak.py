@@ -0,0 +1,270 @@
+#!/usr/bin/env python
+# -*- coding: utf-8 -*-
+
+# (c) Copyright 2016 Hewlett Packard Enterprise Development LP
+#
+# Licensed under the Apache License, Version 2.0 (the "License"); you may
+# not use this file except in compliance with the License. You may obtain
+# a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+# WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+# License for the specific language governing permissions and limitations
+# under the License.
+
+"""Scale and soak harness for ops-fand.
+
+Starts a private ovsdb-server and ops-fand on the simulated bus, creates
+SUBSYSTEMS synthetic subsystems that all use the same hardware description
+(so that the fan count is SUBSYSTEMS times the fans of one subsystem), and
+then, for DURATION seconds, flips the fan_state of a temperature sensor every
+CHANGE_INTERVAL seconds. It reports, and fails on the given thresholds:
+
+  - ops-fand CPU time per poll cycle (one poll of every subsystem)
+  - OVSDB transactions per minute committed by ops-fand
+  - latency from a fan_state change to the new speed being published (the
+    speed register is written in the same main loop iteration, just before
+    the publish; the time includes starting ovs-vsctl)
+  - RSS growth of ops-fand after the warm-up period
+
+Example:
+  fand_scale_soak.py --hw-desc-dir /etc/openswitch/hwdesc \\
+      --subsystems 64 --duration 10800
+"""
+
+from __future__ import print_function
+
+import argparse
+import os
+import random
+import re
+import shutil
+import subprocess
+import sys
+import tempfile
+import time
+
+CLK_TCK = os.sysconf('SC_CLK_TCK')
+
+
+def parse_args():
+    parser = argparse.ArgumentParser(description=__doc__.split('\n')[0])
+    parser.add_argument('--hw-desc-dir', required=True,
+                        help='hardware description used by every subsystem')
+    parser.add_argument('--schema',
+                        default='/usr/share/openvswitch/vswitch.ovsschema')
+    parser.add_argument('--fand', default='ops-fand',
+                        help='ops-fand binary to test')
+    parser.add_argument('--subsystems', type=int, default=64)
+    parser.add_argument('--duration', type=int, default=3 * 3600,
+                        help='soak time, in seconds')
+    parser.add_argument('--warmup', type=int, default=300,
+                        help='seconds before the RSS baseline is taken')
+    parser.add_argument('--change-interval', type=float, default=10,
+                        help='seconds between two fan_state changes')
+    parser.add_argument('--max-cpu-ms-per-cycle', type=float, default=50)
+    parser.add_argument('--max-txn-per-min', type=float, default=60)
+    parser.add_argument('--max-latency-ms', type=float, default=1000)
+    parser.add_argument('--max-rss-growth-kb', type=int, default=512)
+    parser.add_argument('--keep', action='store_true',
+                        help='keep the work directory (logs, database)')
+    return parser.parse_args()
+
+
+class Harness(object):
+
+    def __init__(self, args):
+        self.args = args
+        self.workdir = tempfile.mkdtemp(prefix='fand-soak-')
+        self.db_sock = os.path.join(self.workdir, 'db.sock')
+        self.db = 'unix:' + self.db_sock
+        self.fand_ctl = os.path.join(self.workdir, 'ops-fand.ctl')
+        self.procs = []
+        self.sensors = []
+
+    def start(self):
+        db_file = os.path.join(self.workdir, 'ovsdb.db')
+        subprocess.check_call(['ovsdb-tool', 'create', db_file,
+                               self.args.schema])
+        self.spawn(['ovsdb-server', db_file,
+                    '--remote=punix:' + self.db_sock,
+                    '--unixctl=' + os.path.join(self.workdir, 'ovsdb.ctl'),
+                    '--log-file=' + os.path.join(self.workdir, 'ovsdb.log')])
+        self.wait_for(self.db_sock)
+
+        self.fand = self.spawn([self.args.fand, '--sim-bus',
+                                '--unixctl=' + self.fand_ctl,
+                                '--log-file=' +
+                                os.path.join(self.workdir, 'ops-fand.log'),
+                                self.db])
+        self.wait_for(self.fand_ctl)
+
+    def spawn(self, cmd):
+        proc = subprocess.Popen(cmd, cwd=self.workdir)
+        self.procs.append(proc)
+        return proc
+
+    def wait_for(self, path, timeout=30):
+        deadline = time.time() + timeout
+        while not os.path.exists(path):
+            assert time.time() < deadline, 'timeout waiting for ' + path
+            time.sleep(0.1)
+
+    def stop(self):
+        for proc in reversed(self.procs):
+            proc.terminate()
+            proc.wait()
+        if self.args.keep:
+            print('work directory:', self.workdir)
+        else:
+            shutil.rmtree(self.workdir)
+
+    def vsctl(self, *args):
+        cmd = ['ovs-vsctl', '--db=' + self.db, '--no-wait'] + list(args)
+        return subprocess.check_output(cmd).decode()
+
+    def appctl(self, *args):
+        cmd = ['ovs-appctl', '-t', self.fand_ctl] + list(args)
+        return subprocess.check_output(cmd).decode()
+
+    def create_subsystems(self):
+        # one transaction per subsystem: a temp sensor and the subsystem
+        # that refers to it
+        for idx in range(self.args.subsystems):
+            name = 'soak{}'.format(idx)
+            output = self.vsctl(
+                '--', '--id=@t', 'create', 'Temp_sensor',
+                'name={}-temp'.format(name), 'fan_state=normal',
+                '--', 'create', 'Subsystem', 'name=' + name,
+                'hw_desc_dir=' + self.args.hw_desc_dir, 'temp_sensors=@t')
+            uuids = output.split()
+            self.sensors.append([name, uuids[0], 'normal'])
+
+        # wait until ops-fand has created the fans of every subsystem
+        for name, _, _ in self.sensors:
+            self.vsctl('--timeout=60', 'wait-until', 'Subsystem', name,
+                       'fans!=[]')
+
+    def first_fan(self, subsystem):
+        fans = self.vsctl('get', 'Subsystem', subsystem, 'fans')
+        return fans.strip('[] \n').split(',')[0].strip()
+
+    def set_fan_state(self, sensor_uuid, fan_state):
+        self.vsctl('set', 'Temp_sensor', sensor_uuid,
+                   'fan_state=' + fan_state)
+
+    def measure_latency(self):
+        # flip the fan_state of a random subsystem between normal and fast;
+        # with no override set, its fans' speed follows
+        entry = random.choice(self.sensors)
+        subsystem, sensor, old_state = entry
+        fan_state = 'fast' if old_state == 'normal' else 'normal'
+        entry[2] = fan_state
+        fan = self.first_fan(subsystem)
+        waiter = subprocess.Popen(
+            ['ovs-vsctl', '--db=' + self.db, '--timeout=30', 'wait-until',
+             'Fan', fan, 'speed=' + fan_state])
+        start = time.time()
+        self.set_fan_state(sensor, fan_state)
+        rc = waiter.wait()
+        assert rc == 0, 'speed of {} never became {}'.format(fan, fan_state)
+        return (time.time() - start) * 1000
+
+    def cpu_ticks(self):
+        with open('/proc/{}/stat'.format(self.fand.pid)) as stat:
+            fields = stat.read().rsplit(')', 1)[1].split()
+        # utime and stime are fields 14 and 15 of the whole line
+        return int(fields[11]) + int(fields[12])
+
+    def rss_kb(self):
+        with open('/proc/{}/status'.format(self.fand.pid)) as status:
+            for line in status:
+                if line.startswith('VmRSS'):
+                    return int(line.split()[1])
+        assert False, 'unable to read ops-fand RSS'
+
+    def counters(self):
+        dump = self.appctl('ops-fand/dump')
+        polls = int(re.search(r'^Polls: (\d+)', dump, re.M).group(1))
+        txns = int(re.search(r'^Transactions: (\d+)', dump, re.M).group(1))
+        return polls, txns
+
+
+def soak(harness, args):
+    latencies = []
+    rss_base = None
+
+    start = time.time()
+    cpu_start = harness.cpu_ticks()
+    polls_start, txns_start = harness.counters()
+    rss_max = harness.rss_kb()
+
+    while time.time() - start < args.duration:
+        latencies.append(harness.measure_latency())
+
+        rss = harness.rss_kb()
+        if rss_base is None and time.time() - start >= args.warmup:
+            rss_base = rss
+        rss_max = max(rss_max, rss)
+
+        time.sleep(args.change_interval)
+
+    elapsed = time.time() - start
+    cpu_ms = (harness.cpu_ticks() - cpu_start) * 1000.0 / CLK_TCK
+    polls, txns = harness.counters()
+    polls -= polls_start
+    txns -= txns_start
+    if rss_base is None:
+        rss_base = rss_max
+
+    # subsystems are polled in their own slots; a cycle polls all of them
+    cycles = polls / float(args.subsystems)
+
+    latencies.sort()
+    return {
+        'cpu_ms_per_cycle': cpu_ms / max(cycles, 1),
+        'txn_per_min': txns * 60.0 / elapsed,
+        'latency_ms_p50': latencies[len(latencies) // 2],
+        'latency_ms_max': latencies[-1],
+        'rss_growth_kb': rss_max - rss_base,
+        'polls': polls,
+        'changes': len(latencies),
+    }
+
+
+def main():
+    args = parse_args()
+    harness = Harness(args)
+    failures = []
+
+    try:
+        harness.start()
+        harness.create_subsystems()
+        result = soak(harness, args)
+    finally:
+        harness.stop()
+
+    for key in sorted(result):
+        print('{}: {:.1f}'.format(key, result[key]))
+
+    if result['cpu_ms_per_cycle'] > args.max_cpu_ms_per_cycle:
+        failures.append('cpu per cycle')
+    if result['txn_per_min'] > args.max_txn_per_min:
+        failures.append('transactions per minute')
+    if result['latency_ms_max'] > args.max_latency_ms:
+        failures.append('fan_state to speed latency')
+    if result['rss_growth_kb'] > args.max_rss_growth_kb:
+        failures.append('rss growth')
+
+    if failures:
+        print('FAILED:', ', '.join(failures))
+        return 1
+    print('PASSED')
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
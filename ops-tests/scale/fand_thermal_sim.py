@@ -0,0 +1,332 @@
+#!/usr/bin/env python
+# -*- coding: utf-8 -*-
+
+# (c) Copyright 2016 Hewlett Packard Enterprise Development LP
+#
+# Licensed under the Apache License, Version 2.0 (the "License"); you may
+# not use this file except in compliance with the License. You may obtain
+# a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+# WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+# License for the specific language governing permissions and limitations
+# under the License.
+
+"""Thermal plant simulation of ops-fand's speed control.
+
+Starts a private ovsdb-server and ops-fand on the simulated bus (the same
+setup as fand_scale_soak.py) with one subsystem, and closes the loop around
+it with a lumped RC model of the subsystem:
+
+  C dT/dt = IDLE + LOAD * load(t) - (T - AMBIENT) * (G_STILL + G_FANS * a)
+
+where a is the airflow, the mean fan rpm over MAX_RPM. The temperature is
+turned into the fan_state of the subsystem's temperature sensor the way
+tempd does (thresholds, with hysteresis on the way down), ops-fand picks
+the speed and programs the simulated bus, and the rpm it publishes cools
+the model. With --loop, each fan is an emulated controller whose tach
+follows the speed control register (see fand_rpm_loop_check.py); without,
+a fan runs at the rpm target of its published speed.
+
+ops-fand runs on a virtual clock (time/stop, time/warp), advanced STEP
+seconds at a time, so a profile runs much faster than real time. A change
+of fan_state reaches ops-fand within one step.
+
+The load profile is a file of "SECONDS PERCENT" lines: the load holds from
+each time to the next, and the last line is the end of the run. For each
+segment, and for the whole run, it reports the max temperature, the
+overshoot over the temperature the segment ends at, the settle time (after
+which the temperature stays within --band of it) and the fan energy, and
+fails on the given thresholds. --json writes the results, to compare two
+control settings (--other-config) or two builds.
+
+Example:
+  fand_thermal_sim.py --hw-desc-dir /etc/openswitch/hwdesc \\
+      --profile burst.profile --other-config fan_speed_down_dwell=60000
+"""
+
+from __future__ import print_function
+
+import argparse
+import json
+import math
+import sys
+import time
+
+from fand_scale_soak import Harness
+
+LEVELS = ['slow', 'normal', 'medium', 'fast', 'max']
+
+# idle, then a burst, then part load
+DEFAULT_PROFILE = [(0, 10), (300, 90), (1200, 30), (2100, 30)]
+
+
+def parse_args():
+    parser = argparse.ArgumentParser(description=__doc__.split('\n')[0])
+    parser.add_argument('--hw-desc-dir', required=True,
+                        help='hardware description of the subsystem')
+    parser.add_argument('--schema',
+                        default='/usr/share/openvswitch/vswitch.ovsschema')
+    parser.add_argument('--fand', default='ops-fand',
+                        help='ops-fand binary to test')
+    parser.add_argument('--profile',
+                        help='load profile file (default: a built-in burst)')
+    parser.add_argument('--step', type=float, default=1,
+                        help='simulated seconds per step')
+    parser.add_argument('--other-config', action='append', default=[],
+                        help='KEY=VALUE of the subsystem (repeatable)')
+    parser.add_argument('--loop', action='append', default=[],
+                        help='DEVICE:TARGET:TACH:SIZE of an emulated '
+                             'controller (repeatable)')
+    parser.add_argument('--targets', default='3000,5000,8000,11000,15000',
+                        help='rpm of the slow, normal, ..., max speeds')
+    parser.add_argument('--fan-states', default='45:normal,60:medium,'
+                        '70:fast,80:max',
+                        help='temperature (C) at which each fan_state '
+                             'starts; below the first it is slow')
+    parser.add_argument('--hysteresis', type=float, default=3,
+                        help='C below a threshold to leave its fan_state')
+    # the plant
+    parser.add_argument('--ambient', type=float, default=25, help='C')
+    parser.add_argument('--capacity', type=float, default=1500,
+                        help='heat capacity, J/K')
+    parser.add_argument('--idle-watts', type=float, default=60)
+    parser.add_argument('--load-watts', type=float, default=240,
+                        help='heat at full load, on top of the idle heat')
+    parser.add_argument('--g-still', type=float, default=1,
+                        help='W/K with the fans stopped')
+    parser.add_argument('--g-fans', type=float, default=8,
+                        help='W/K added at full airflow')
+    parser.add_argument('--max-rpm', type=float, default=15000,
+                        help='rpm of full airflow')
+    parser.add_argument('--fan-watts', type=float, default=12,
+                        help='power of a fan at --max-rpm (cube law)')
+    # the report
+    parser.add_argument('--band', type=float, default=1,
+                        help='C around its final temperature a segment '
+                             'has settled in')
+    parser.add_argument('--json', help='write the results to this file')
+    parser.add_argument('--max-temp', type=float)
+    parser.add_argument('--max-overshoot', type=float)
+    parser.add_argument('--max-settle', type=float)
+    parser.add_argument('--max-energy-kj', type=float)
+    parser.add_argument('--keep', action='store_true',
+                        help='keep the work directory (logs, database)')
+    args = parser.parse_args()
+    args.subsystems = 1
+    return args
+
+
+def read_profile(path):
+    if path is None:
+        return DEFAULT_PROFILE
+    profile = []
+    with open(path) as lines:
+        for line in lines:
+            line = line.split('#')[0].strip()
+            if line:
+                seconds, percent = line.split()
+                profile.append((float(seconds), float(percent)))
+    assert len(profile) >= 2, 'a profile needs a start and an end'
+    assert profile == sorted(profile), 'profile times must increase'
+    return profile
+
+
+class Plant(object):
+    """Lumped RC model of the subsystem, and tempd's view of it."""
+
+    def __init__(self, args):
+        self.args = args
+        self.temp = args.ambient
+        self.fan_state = 'slow'
+        self.thresholds = []
+        for entry in args.fan_states.split(','):
+            threshold, level = entry.split(':')
+            self.thresholds.append((float(threshold), level))
+        self.thresholds.sort()
+
+    def advance(self, load, airflow, seconds):
+        # exact for a constant load and airflow over the step
+        args = self.args
+        heat = args.idle_watts + args.load_watts * load / 100.0
+        conductance = args.g_still + args.g_fans * airflow
+        steady = args.ambient + heat / conductance
+        decay = math.exp(-conductance * seconds / args.capacity)
+        self.temp = steady + (self.temp - steady) * decay
+
+    def update_fan_state(self):
+        rank = LEVELS.index(self.fan_state)
+        state = 'slow'
+        for threshold, level in self.thresholds:
+            # a level already reached is only left below its hysteresis
+            if LEVELS.index(level) <= rank:
+                threshold -= self.args.hysteresis
+            if self.temp >= threshold:
+                state = level
+        changed = state != self.fan_state
+        self.fan_state = state
+        return changed
+
+
+def fan_rpms(harness, targets, loops):
+    rpms = []
+    output = harness.vsctl('--format=csv', '--data=bare', '--no-headings',
+                           '--columns=rpm,speed', 'list', 'Fan')
+    for line in output.splitlines():
+        if not line.strip():
+            continue
+        rpm, speed = line.split(',')
+        if loops:
+            rpms.append(int(rpm or 0))
+        else:
+            rpms.append(targets[LEVELS.index(speed)] if speed in LEVELS
+                        else 0)
+    return rpms
+
+
+def simulate(harness, args, profile):
+    targets = [int(rpm) for rpm in args.targets.split(',')]
+    plant = Plant(args)
+    sensor = harness.sensors[0][1]
+    samples = []
+    energy = 0.0
+
+    harness.appctl('time/stop')
+    end = profile[-1][0]
+    now = 0.0
+    segment = 0
+    while now < end:
+        while now >= profile[segment + 1][0]:
+            segment += 1
+        load = profile[segment][1]
+
+        if plant.update_fan_state():
+            harness.set_fan_state(sensor, plant.fan_state)
+
+        rpms = fan_rpms(harness, targets, args.loop)
+        airflow = min(1.0, sum(rpms) / float(max(len(rpms), 1)) /
+                      args.max_rpm)
+        watts = sum(args.fan_watts * (rpm / args.max_rpm) ** 3
+                    for rpm in rpms)
+
+        step = min(args.step, end - now)
+        plant.advance(load, airflow, step)
+        energy += watts * step
+        harness.appctl('time/warp', str(int(step * 1000)))
+        now += step
+        samples.append({'time': now, 'segment': segment, 'load': load,
+                        'temp': plant.temp, 'fan_state': plant.fan_state,
+                        'rpm': max(rpms) if rpms else 0,
+                        'energy': energy})
+    return samples
+
+
+def segment_result(samples, start, initial, band):
+    temps = [sample['temp'] for sample in samples]
+    final = temps[-1]
+    settle = 0.0
+    for sample in samples:
+        if abs(sample['temp'] - final) > band:
+            settle = sample['time'] - start
+    # how far the temperature went past where it ends, in the direction
+    # it went
+    if final >= initial:
+        overshoot = max(temps) - final
+    else:
+        overshoot = final - min(temps)
+    return {
+        'start': start,
+        'load': samples[0]['load'],
+        'max_temp': max(temps),
+        'overshoot': overshoot,
+        'settle': settle,
+        'final_temp': final,
+    }
+
+
+def report(samples, profile, args):
+    segments = []
+    initial = args.ambient
+    for idx, (start, _) in enumerate(profile[:-1]):
+        in_segment = [sample for sample in samples
+                      if sample['segment'] == idx]
+        if in_segment:
+            segments.append(segment_result(in_segment, start, initial,
+                                           args.band))
+            initial = in_segment[-1]['temp']
+    return {
+        'max_temp': max(sample['temp'] for sample in samples),
+        'overshoot': max(seg['overshoot'] for seg in segments),
+        'settle': max(seg['settle'] for seg in segments),
+        'energy_kj': samples[-1]['energy'] / 1000.0,
+        'segments': segments,
+    }
+
+
+def main():
+    args = parse_args()
+    assert len(args.targets.split(',')) == len(LEVELS), \
+        'expected five targets'
+    profile = read_profile(args.profile)
+    harness = Harness(args)
+    failures = []
+
+    try:
+        harness.start()
+        harness.create_subsystems()
+        subsystem = harness.sensors[0][0]
+        settings = list(args.other_config)
+        if args.loop:
+            for loop in args.loop:
+                harness.appctl('ops-fand/sim-rpm-loop', subsystem,
+                               *loop.split(':'))
+            settings.append('fan_rpm_targets=' + args.targets)
+        for setting in settings:
+            harness.vsctl('set', 'Subsystem', subsystem,
+                          'other_config:' + setting)
+        start = time.time()
+        samples = simulate(harness, args, profile)
+        wall = time.time() - start
+    finally:
+        harness.stop()
+
+    result = report(samples, profile, args)
+    result['speedup'] = samples[-1]['time'] / max(wall, 0.001)
+    for seg in result['segments']:
+        print('{start:7.0f}s load {load:3.0f}%: max {max_temp:5.1f} C, '
+              'overshoot {overshoot:4.1f} C, settle {settle:5.0f}s, '
+              'final {final_temp:5.1f} C'.format(**seg))
+    print('max_temp: {:.1f} C'.format(result['max_temp']))
+    print('overshoot: {:.1f} C'.format(result['overshoot']))
+    print('settle: {:.0f} s'.format(result['settle']))
+    print('fan_energy: {:.1f} kJ'.format(result['energy_kj']))
+    print('speedup: {:.0f}x real time'.format(result['speedup']))
+
+    if args.json:
+        result['samples'] = samples
+        with open(args.json, 'w') as output:
+            json.dump(result, output, indent=1)
+
+    if args.max_temp is not None and result['max_temp'] > args.max_temp:
+        failures.append('max temperature')
+    if (args.max_overshoot is not None and
+            result['overshoot'] > args.max_overshoot):
+        failures.append('overshoot')
+    if args.max_settle is not None and result['settle'] > args.max_settle:
+        failures.append('settle time')
+    if (args.max_energy_kj is not None and
+            result['energy_kj'] > args.max_energy_kj):
+        failures.append('fan energy')
+
+    if failures:
+        print('FAILED:', ', '.join(failures))
+        return 1
+    print('PASSED')
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,124 @@
+#!/usr/bin/env python
+# -*- coding: utf-8 -*-
+
+# (c) Copyright 2016 Hewlett Packard Enterprise Development LP
+#
+# Licensed under the Apache License, Version 2.0 (the "License"); you may
+# not use this file except in compliance with the License. You may obtain
+# a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+# WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+# License for the specific language governing permissions and limitations
+# under the License.
+
+"""Span trace check for ops-fand.
+
+Starts a private ovsdb-server and ops-fand on the simulated bus (the same
+setup as fand_scale_soak.py), creates SUBSYSTEMS subsystems, lets CYCLES
+poll cycles go by, and dumps the spans with ops-fand/trace. It fails if the
+dump is not valid JSON, if an event is not a complete ("X") event with a
+start and a duration, or if a main loop stage or register access is
+missing from it.
+
+ops-fand must be built with -DFAND_TRACE=ON, which adds ops-fand/trace.
+
+Example:
+  fand_trace_check.py --hw-desc-dir /etc/openswitch/hwdesc --cycles 2
+"""
+
+from __future__ import print_function
+
+import argparse
+import json
+import subprocess
+import sys
+import time
+
+from fand_scale_soak import Harness
+
+POLL_INTERVAL = 5
+
+# spans every steady-state run has, whatever the hardware description
+SPANS = ['thermal_alerts', 'idl_run', 'reconfigure', 'governors', 'poll',
+         'hotplug', 'poll_block', 'i2c_read', 'i2c_write']
+
+
+def parse_args():
+    parser = argparse.ArgumentParser(description=__doc__.split('\n')[0])
+    parser.add_argument('--hw-desc-dir', required=True,
+                        help='hardware description used by every subsystem')
+    parser.add_argument('--schema',
+                        default='/usr/share/openvswitch/vswitch.ovsschema')
+    parser.add_argument('--fand', default='ops-fand',
+                        help='ops-fand binary to test')
+    parser.add_argument('--subsystems', type=int, default=2)
+    parser.add_argument('--cycles', type=int, default=2,
+                        help='poll cycles to trace')
+    parser.add_argument('--keep', action='store_true',
+                        help='keep the work directory (logs, database)')
+    return parser.parse_args()
+
+
+def dump_trace(harness):
+    try:
+        return harness.appctl('ops-fand/trace')
+    except subprocess.CalledProcessError:
+        raise AssertionError('ops-fand was not built with FAND_TRACE')
+
+
+def check_trace(text, subsystems):
+    """the problems found in a trace dump"""
+    try:
+        trace = json.loads(text)
+    except ValueError as e:
+        return ['not valid JSON: {}'.format(e)]
+
+    problems = []
+    names = set()
+    polled = set()
+    for event in trace.get('traceEvents', []):
+        names.add(event.get('name'))
+        if event.get('ph') != 'X' or \
+                not isinstance(event.get('ts'), int) or \
+                not isinstance(event.get('dur'), int) or event['dur'] < 0:
+            problems.append('bad event: {}'.format(event))
+        if event.get('name') == 'poll':
+            polled.add(event.get('args', {}).get('on'))
+    for name in SPANS:
+        if name not in names:
+            problems.append('no {} span'.format(name))
+    for name in subsystems:
+        if name not in polled:
+            problems.append('no poll span of {}'.format(name))
+    return problems
+
+
+def main():
+    args = parse_args()
+    harness = Harness(args)
+
+    try:
+        harness.start()
+        harness.create_subsystems()
+        time.sleep((args.cycles + 1) * POLL_INTERVAL)
+        text = dump_trace(harness)
+    finally:
+        harness.stop()
+
+    problems = check_trace(text, [name for name, _, _ in harness.sensors])
+    print('trace: {} bytes'.format(len(text)))
+    for problem in problems[:20]:
+        print(problem)
+    if problems:
+        print('FAILED: the trace is not what chrome://tracing expects')
+        return 1
+    print('PASSED')
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
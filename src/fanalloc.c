@@ -0,0 +1,65 @@
+/*
+ *  (c) Copyright 2015 Hewlett Packard Enterprise Development LP
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License. You may obtain
+ *  a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *  License for the specific language governing permissions and limitations
+ *  under the License.
+ */
+
+/************************************************************************//**
+ * @ingroup fand
+ *
+ * @file
+ * Source file for heap allocation statistics (FAND_ALLOC_STATS builds).
+ *
+ * malloc(), calloc() and realloc() are replaced by versions that count the
+ * call and hand it to the C library's allocator. Symbols in the executable
+ * take precedence over the library's, so the allocations made by the OVS
+ * and config-yaml libraries are counted as well. The count is per thread,
+ * so that the vlog thread doesn't show up in the main loop's count.
+ ***************************************************************************/
+
+#include <stddef.h>
+
+#include "fanalloc.h"
+
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t n, size_t size);
+void *__libc_realloc(void *ptr, size_t size);
+
+static __thread unsigned long long int n_allocs;
+
+void *
+malloc(size_t size)
+{
+    n_allocs++;
+    return(__libc_malloc(size));
+}
+
+void *
+calloc(size_t n, size_t size)
+{
+    n_allocs++;
+    return(__libc_calloc(n, size));
+}
+
+void *
+realloc(void *ptr, size_t size)
+{
+    n_allocs++;
+    return(__libc_realloc(ptr, size));
+}
+
+unsigned long long int
+fand_alloc_count(void)
+{
+    return(n_allocs);
+}
@@ -0,0 +1,145 @@
+/*
+ *  (c) Copyright 2015 Hewlett Packard Enterprise Development LP
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License. You may obtain
+ *  a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *  License for the specific language governing permissions and limitations
+ *  under the License.
+ */
+
+/************************************************************************//**
+ * @ingroup fand
+ *
+ * @file
+ * Source file for the per-subsystem memory arena.
+ *
+ * The arena is a list of chunks that is only ever bumped. Each new chunk
+ * is at least twice as big as the previous one, so a subsystem ends up
+ * with a handful of chunks however big it is.
+ ***************************************************************************/
+
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "util.h"
+#include "fanarena.h"
+
+#define FAND_ARENA_MIN_CHUNK    1024
+#define FAND_ARENA_ALIGN        (sizeof(void *) > sizeof(long long) ? \
+                                 sizeof(void *) : sizeof(long long))
+
+struct fand_arena_chunk {
+    struct fand_arena_chunk *next;
+    size_t size;                     /* usable bytes in data[] */
+    long long data[];                /* (long long for alignment) */
+};
+
+static size_t
+fand_arena_round(size_t size)
+{
+    return((size + FAND_ARENA_ALIGN - 1) & ~(FAND_ARENA_ALIGN - 1));
+}
+
+static void
+fand_arena_add_chunk(struct fand_arena *arena, size_t size)
+{
+    struct fand_arena_chunk *chunk;
+
+    if (arena->chunks && size < 2 * arena->chunks->size) {
+        size = 2 * arena->chunks->size;
+    }
+    if (size < FAND_ARENA_MIN_CHUNK) {
+        size = FAND_ARENA_MIN_CHUNK;
+    }
+
+    chunk = xmalloc(sizeof(*chunk) + size);
+    chunk->next = arena->chunks;
+    chunk->size = size;
+    arena->chunks = chunk;
+    arena->used = 0;
+}
+
+struct fand_arena *
+fand_arena_create(size_t size)
+{
+    struct fand_arena *arena = xzalloc(sizeof(*arena));
+
+    fand_arena_add_chunk(arena, fand_arena_round(size));
+
+    return(arena);
+}
+
+void
+fand_arena_destroy(struct fand_arena *arena)
+{
+    struct fand_arena_chunk *chunk, *next;
+
+    if (arena == NULL) {
+        return;
+    }
+
+    for (chunk = arena->chunks; chunk != NULL; chunk = next) {
+        next = chunk->next;
+        free(chunk);
+    }
+    free(arena);
+}
+
+void *
+fand_arena_alloc(struct fand_arena *arena, size_t size)
+{
+    void *result;
+
+    size = fand_arena_round(size);
+    if (arena->used + size > arena->chunks->size) {
+        fand_arena_add_chunk(arena, size);
+    }
+
+    result = (char *)arena->chunks->data + arena->used;
+    arena->used += size;
+    arena->total += size;
+    memset(result, 0, size);
+
+    return(result);
+}
+
+char *
+fand_arena_strdup(struct fand_arena *arena, const char *string)
+{
+    size_t len = strlen(string) + 1;
+    char *result = fand_arena_alloc(arena, len);
+
+    memcpy(result, string, len);
+
+    return(result);
+}
+
+char *
+fand_arena_printf(struct fand_arena *arena, const char *format, ...)
+{
+    va_list args;
+    char *result;
+    int len;
+
+    va_start(args, format);
+    len = vsnprintf(NULL, 0, format, args);
+    va_end(args);
+
+    result = fand_arena_alloc(arena, len + 1);
+
+    va_start(args, format);
+    vsnprintf(result, len + 1, format, args);
+    va_end(args);
+
+    return(result);
+}
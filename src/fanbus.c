@@ -0,0 +1,455 @@
+/*
+ *  (c) Copyright 2015 Hewlett Packard Enterprise Development LP
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License. You may obtain
+ *  a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *  License for the specific language governing permissions and limitations
+ *  under the License.
+ */
+
+/************************************************************************//**
+ * @ingroup fand
+ *
+ * @file
+ * Source file for fan register access functions.
+ ***************************************************************************/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <string.h>
+#include <sys/file.h>
+#include <unistd.h>
+
+#include "hash.h"
+#include "hmap.h"
+#include "shash.h"
+#include "timeval.h"
+#include "util.h"
+#include "openvswitch/vlog.h"
+#include "fanbus.h"
+#include "fanmmio.h"
+#include "fanrecord.h"
+#include "fansim.h"
+#include "fantrace.h"
+
+VLOG_DEFINE_THIS_MODULE(fanbus);
+
+/* how long a poll is put off for a bus another daemon holds before going
+   ahead anyway: the fans must not be left uncontrolled because of a stuck
+   peer */
+#define FAND_BUS_LOCK_WAIT_MSEC  50
+
+struct fand_bus {
+    char *name;                   /* usable in a file name */
+    int fd;                       /* lock file, or -1 */
+    long long int busy_since;     /* when found busy, or LLONG_MIN */
+    bool timed_out;               /* busy too long in this poll */
+    bool unarbitrated;            /* went ahead since the lock was taken */
+};
+
+/* the bus of a device of a hardware description, so that the description
+   is searched once per device rather than on every transaction */
+struct fand_bus_device {
+    struct hmap_node node;        /* in bus_devices, by device name pointer */
+    YamlConfigHandle handle;
+    const char *device;           /* owned by the handle */
+    struct fand_bus *bus;         /* NULL if the device has no bus */
+    struct fand_mmio *mmio;       /* mapped registers, or NULL */
+};
+
+/* a device of a hardware description whose registers are mapped */
+struct fand_bus_mapping {
+    struct hmap_node node;        /* in bus_mappings, by handle */
+    YamlConfigHandle handle;
+    struct fand_mmio *mmio;
+};
+
+/* the buses seen so far, by bus name */
+static struct shash buses = SHASH_INITIALIZER(&buses);
+static struct hmap bus_devices = HMAP_INITIALIZER(&bus_devices);
+static struct hmap bus_mappings = HMAP_INITIALIZER(&bus_mappings);
+static char *bus_lock_dir = NULL;
+static bool bus_batch = false;
+
+/* the one bus whose lock is taken, if any */
+static struct fand_bus *held_bus = NULL;
+
+/* the bus of the last transaction */
+static const struct fand_bus *current_bus = NULL;
+
+static unsigned long long int bus_lock_waits = 0;
+static unsigned long long int bus_lock_timeouts = 0;
+static unsigned long long int bus_lock_recoveries = 0;
+static unsigned long long int bus_lock_skips = 0;
+static unsigned long long int bus_mux_switches = 0;
+
+void
+fand_bus_set_lock_dir(const char *dir)
+{
+    free(bus_lock_dir);
+    bus_lock_dir = dir ? xstrdup(dir) : NULL;
+}
+
+static struct fand_bus *
+fand_bus_lookup(YamlConfigHandle handle, const char *subsystem_name,
+                const i2c_bit_op *op)
+{
+    const YamlDevice *device;
+    struct fand_bus *bus;
+    char *path;
+    char *p;
+
+    device = yaml_find_device(handle, subsystem_name, op->device);
+    if (device == NULL || device->bus == NULL) {
+        return(NULL);
+    }
+
+    bus = shash_find_data(&buses, device->bus);
+    if (bus != NULL) {
+        return(bus);
+    }
+
+    bus = xzalloc(sizeof(*bus));
+    bus->name = xstrdup(device->bus);
+    bus->fd = -1;
+    bus->busy_since = LLONG_MIN;
+    /* the bus name may be a device path */
+    for (p = bus->name; *p; p++) {
+        if (*p == '/') {
+            *p = '_';
+        }
+    }
+    shash_add(&buses, device->bus, bus);
+
+    if (bus_lock_dir == NULL) {
+        return(bus);
+    }
+
+    path = xasprintf("%s/i2c-bus-%s.lock", bus_lock_dir, bus->name);
+    bus->fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (bus->fd < 0) {
+        VLOG_WARN("%s: cannot open bus lock (%s)", path,
+                  ovs_strerror(errno));
+    }
+    free(path);
+
+    return(bus);
+}
+
+static struct fand_mmio *
+fand_bus_lookup_mmio(YamlConfigHandle handle, const char *device)
+{
+    struct fand_bus_mapping *mapping;
+
+    HMAP_FOR_EACH_WITH_HASH (mapping, node, hash_pointer(handle, 0),
+                             &bus_mappings) {
+        if (mapping->handle == handle &&
+                strcmp(fand_mmio_device(mapping->mmio), device) == 0) {
+            return(mapping->mmio);
+        }
+    }
+
+    return(NULL);
+}
+
+static struct fand_bus_device *
+fand_bus_find(YamlConfigHandle handle, const char *subsystem_name,
+              const i2c_bit_op *op)
+{
+    struct fand_bus_device *bus_device;
+    uint32_t hash;
+
+    if (handle == NULL) {
+        return(NULL);
+    }
+
+    hash = hash_pointer(op->device, 0);
+    HMAP_FOR_EACH_WITH_HASH (bus_device, node, hash, &bus_devices) {
+        if (bus_device->device == op->device &&
+                bus_device->handle == handle) {
+            return(bus_device);
+        }
+    }
+
+    bus_device = xmalloc(sizeof(*bus_device));
+    bus_device->handle = handle;
+    bus_device->device = op->device;
+    bus_device->mmio = fand_bus_lookup_mmio(handle, op->device);
+    /* a mapped device isn't behind a bus */
+    bus_device->bus = NULL;
+    if (bus_device->mmio == NULL) {
+        bus_device->bus = fand_bus_lookup(handle, subsystem_name, op);
+    }
+    hmap_insert(&bus_devices, &bus_device->node, hash);
+
+    return(bus_device);
+}
+
+/* drop the cached buses of the devices of 'handle' */
+static void
+fand_bus_forget_devices(YamlConfigHandle handle)
+{
+    struct fand_bus_device *bus_device, *next;
+
+    HMAP_FOR_EACH_SAFE (bus_device, next, node, &bus_devices) {
+        if (bus_device->handle == handle) {
+            hmap_remove(&bus_devices, &bus_device->node);
+            free(bus_device);
+        }
+    }
+}
+
+void
+fand_bus_forget(YamlConfigHandle handle)
+{
+    struct fand_bus_mapping *mapping, *next;
+
+    fand_bus_forget_devices(handle);
+    HMAP_FOR_EACH_SAFE (mapping, next, node, &bus_mappings) {
+        if (mapping->handle == handle) {
+            hmap_remove(&bus_mappings, &mapping->node);
+            free(mapping);
+        }
+    }
+}
+
+void
+fand_bus_map_device(YamlConfigHandle handle, struct fand_mmio *mmio)
+{
+    struct fand_bus_mapping *mapping;
+
+    mapping = xmalloc(sizeof(*mapping));
+    mapping->handle = handle;
+    mapping->mmio = mmio;
+    hmap_insert(&bus_mappings, &mapping->node, hash_pointer(handle, 0));
+
+    /* the device may already be known as one behind a bus */
+    fand_bus_forget_devices(handle);
+}
+
+static void
+fand_bus_unlock(void)
+{
+    if (held_bus != NULL) {
+        flock(held_bus->fd, LOCK_UN);
+        held_bus = NULL;
+    }
+}
+
+/* take the lock of 'bus' with a single try, dropping the lock of any other
+   bus first, so that at most one bus is locked at a time. returns false if
+   another daemon holds it. */
+static bool
+fand_bus_lock(struct fand_bus *bus)
+{
+    static struct vlog_rate_limit rl = VLOG_RATE_LIMIT_INIT(1, 5);
+    int rc;
+
+    if (bus == held_bus || bus->fd < 0) {
+        return(true);
+    }
+    fand_bus_unlock();
+
+    FAND_SPAN_BEGIN(span);
+    rc = flock(bus->fd, LOCK_EX | LOCK_NB);
+    FAND_SPAN_END(span, "bus_lock", bus->name, -1);
+    if (rc != 0) {
+        if (errno == EWOULDBLOCK) {
+            return(false);
+        }
+        VLOG_WARN_RL(&rl, "bus %s: cannot lock (%s)", bus->name,
+                     ovs_strerror(errno));
+        return(true);
+    }
+
+    held_bus = bus;
+    bus->busy_since = LLONG_MIN;
+    bus->timed_out = false;
+    if (bus->unarbitrated) {
+        bus->unarbitrated = false;
+        bus_lock_recoveries++;
+        VLOG_INFO("bus %s: lock taken again", bus->name);
+    }
+    return(true);
+}
+
+void
+fand_bus_poll_begin(void)
+{
+    struct shash_node *node;
+
+    /* a bus that timed out is waited for again */
+    SHASH_FOR_EACH (node, &buses) {
+        struct fand_bus *bus = node->data;
+
+        if (bus->timed_out) {
+            bus->timed_out = false;
+            bus->busy_since = LLONG_MIN;
+        }
+    }
+}
+
+bool
+fand_bus_acquire(YamlConfigHandle handle, const char *subsystem_name,
+                 const i2c_bit_op *op)
+{
+    static struct vlog_rate_limit rl = VLOG_RATE_LIMIT_INIT(1, 5);
+    struct fand_bus_device *bus_device;
+    struct fand_bus *bus;
+    long long int now;
+
+    bus_device = fand_bus_find(handle, subsystem_name, op);
+    bus = bus_device ? bus_device->bus : NULL;
+    if (bus == NULL || fand_bus_lock(bus) || bus->timed_out) {
+        return(true);
+    }
+
+    now = time_msec();
+    if (bus->busy_since == LLONG_MIN) {
+        bus->busy_since = now;
+        bus_lock_waits++;
+    }
+    if (now - bus->busy_since < FAND_BUS_LOCK_WAIT_MSEC) {
+        return(false);
+    }
+
+    /* until the next poll, or the lock is taken again */
+    bus->timed_out = true;
+    bus->unarbitrated = true;
+    bus_lock_timeouts++;
+    VLOG_WARN_RL(&rl, "bus %s is busy, going ahead without the lock",
+                 bus->name);
+    return(true);
+}
+
+/* switch to 'bus' for a transaction, taking its lock if it's free */
+static void
+fand_bus_select(struct fand_bus *bus)
+{
+    if (bus == NULL) {
+        return;
+    }
+
+    if (bus != current_bus) {
+        bus_mux_switches++;
+        current_bus = bus;
+    }
+
+    /* a single write isn't worth putting off: go ahead on a busy bus */
+    if (!fand_bus_lock(bus)) {
+        bus_lock_skips++;
+    }
+}
+
+static void
+fand_bus_release(void)
+{
+    if (!bus_batch) {
+        fand_bus_unlock();
+    }
+}
+
+void
+fand_bus_batch_begin(void)
+{
+    bus_batch = true;
+}
+
+void
+fand_bus_batch_end(void)
+{
+    bus_batch = false;
+    fand_bus_unlock();
+}
+
+unsigned long long int
+fand_bus_mux_switches(void)
+{
+    return(bus_mux_switches);
+}
+
+void
+fand_bus_stats(struct ds *ds)
+{
+    ds_put_format(ds, "Bus lock waits: %llu (%llu timed out, "
+                  "%llu recovered)\n", bus_lock_waits, bus_lock_timeouts,
+                  bus_lock_recoveries);
+    ds_put_format(ds, "Transactions on a busy bus: %llu\n", bus_lock_skips);
+    ds_put_format(ds, "Mux switches: %llu\n", bus_mux_switches);
+}
+
+int
+fand_reg_read(YamlConfigHandle handle, const char *subsystem_name,
+              const i2c_bit_op *op, uint32_t *value)
+{
+    struct fand_bus_device *bus_device;
+    struct fand_bus *bus;
+    int rc;
+
+    if (fand_replaying()) {
+        return(fand_replay_reg(false, subsystem_name, op, value));
+    }
+    bus_device = fand_bus_find(handle, subsystem_name, op);
+    if (bus_device != NULL && bus_device->mmio != NULL) {
+        /* no bus, no lock, no system call */
+        FAND_SPAN_BEGIN(span);
+        rc = fand_mmio_read(bus_device->mmio, op, value);
+        FAND_SPAN_END(span, "mmio_read", op->device, op->register_address);
+    } else {
+        bus = bus_device ? bus_device->bus : NULL;
+        fand_bus_select(bus);
+        FAND_SPAN_BEGIN(span);
+        if (fansim_enabled()) {
+            rc = fansim_reg_read(subsystem_name, op, value);
+        } else {
+            rc = i2c_reg_read(handle, subsystem_name, op, value);
+        }
+        FAND_SPAN_END(span, "i2c_read", op->device, op->register_address);
+        fand_bus_release();
+    }
+    fand_record_reg(false, subsystem_name, op, rc, rc ? 0 : *value);
+
+    return(rc);
+}
+
+int
+fand_reg_write(YamlConfigHandle handle, const char *subsystem_name,
+               const i2c_bit_op *op, uint32_t value)
+{
+    struct fand_bus_device *bus_device;
+    struct fand_bus *bus;
+    int rc;
+
+    if (fand_replaying()) {
+        return(fand_replay_reg(true, subsystem_name, op, &value));
+    }
+    bus_device = fand_bus_find(handle, subsystem_name, op);
+    if (bus_device != NULL && bus_device->mmio != NULL) {
+        /* no bus, no lock, no system call */
+        FAND_SPAN_BEGIN(span);
+        rc = fand_mmio_write(bus_device->mmio, op, value);
+        FAND_SPAN_END(span, "mmio_write", op->device, op->register_address);
+    } else {
+        bus = bus_device ? bus_device->bus : NULL;
+        fand_bus_select(bus);
+        FAND_SPAN_BEGIN(span);
+        if (fansim_enabled()) {
+            rc = fansim_reg_write(subsystem_name, op, value);
+        } else {
+            rc = i2c_reg_write(handle, subsystem_name, op, value);
+        }
+        FAND_SPAN_END(span, "i2c_write", op->device, op->register_address);
+        fand_bus_release();
+    }
+    fand_record_reg(true, subsystem_name, op, rc, value);
+
+    return(rc);
+}
@@ -24,6 +24,7 @@
 
 #define _GNU_SOURCE
 #include <errno.h>
+#include <fnmatch.h>
 #include <getopt.h>
 #include <limits.h>
 #include <signal.h>
@@ -37,6 +38,7 @@
 #include "dirs.h"
 #include "dummy.h"
 #include "fatal-signal.h"
+#include "hash.h"
 #include "ovsdb-idl.h"
 #include "poll-loop.h"
 #include "simap.h"
@@ -56,8 +58,23 @@
 
 #include "fanspeed.h"
 #include "fanstatus.h"
+#include "fandirection.h"
+#include "fanfilter.h"
 #include "physfan.h"
 #include "fand-locl.h"
+#include "fanalloc.h"
+#include "fanarena.h"
+#include "fanbus.h"
+#include "fanevent.h"
+#include "fanflight.h"
+#include "fanload.h"
+#include "fanmmio.h"
+#include "fanplugin.h"
+#include "fanpower.h"
+#include "fanrecord.h"
+#include "fansim.h"
+#include "fantrace.h"
+#include "fanwear.h"
 #include "eventlog.h"
 
 #define FAN_POLL_INTERVAL   5    /* OPS_TODO: should this be configurable? */
@@ -68,6 +85,9 @@
 
 #define NAME_IN_DAEMON_TABLE "ops-fand"
 
+/* initial arena size per subsystem, enough for a typical fan tray set */
+#define SUBSYSTEM_ARENA_SIZE 4096
+
 VLOG_DEFINE_THIS_MODULE(ops_fand);
 
 COVERAGE_DEFINE(fand_reconfigure);
@@ -77,17 +97,76 @@ static struct ovsdb_idl *idl;
 static unsigned int idl_seqno;
 
 static unixctl_cb_func fand_unixctl_dump;
+static unixctl_cb_func fand_unixctl_power;
+static unixctl_cb_func fand_unixctl_flight_export;
+static unixctl_cb_func fand_unixctl_sim_fru_present;
+static unixctl_cb_func fand_unixctl_sim_thermal_alert;
+static unixctl_cb_func fand_unixctl_sim_fan;
+#ifdef FAND_TRACE
+static unixctl_cb_func fand_unixctl_trace;
+#endif
 
 static bool cur_hw_set = false;
 
+/* polls done and transactions committed, for ops-fand/dump */
+static unsigned long long int n_polls = 0;
+/* mux switches of the last subsystem poll, and the most in one poll */
+static unsigned int poll_mux_switches = 0;
+static unsigned int max_poll_mux_switches = 0;
+/* subsystem polls cut short by their time budget */
+static unsigned long long int n_overruns = 0;
+/* subsystem polls put off because another daemon held a bus, and how soon
+   such a poll is taken again */
+static unsigned long long int n_poll_retries = 0;
+#define FAND_BUS_RETRY_MSEC 10
+/* heap allocations made by the poll and control path (fand_run__) */
+static unsigned long long int n_run_allocs = 0;
+static unsigned long long int n_txns = 0;
+
+/* fan power and energy are published at a low rate, on their own */
+#define FAND_POWER_PUBLISH_MSEC 60000
+static long long int next_power_publish = 0;
+
+/* the interface statistics are sampled while a subsystem has a load gain,
+   through a connection of their own that exists only while one does */
+#define FAND_LOAD_SAMPLE_MSEC 1000
+static long long int next_load_sample = 0;
+static struct ovsdb_idl *load_idl = NULL;
+static char *db_remote = NULL;
+
+/* serve register accesses from the simulated bus (--sim-bus) */
+static bool sim_bus = false;
+
+/* When several instances split the subsystems between them, each one has a
+   shard name (--shard) and takes its own OVSDB lock. A subsystem tagged with
+   "fan_shard" in other_config belongs to the shard of that name; untagged
+   subsystems belong to the instances whose --subsystems patterns match
+   (every subsystem, if no --shard or --subsystems is given). */
+static char *shard_name = NULL;
+static struct svec shard_patterns = SVEC_EMPTY_INITIALIZER;
+
+/* A standby instance (--standby) loads the subsystems and follows the
+   published Fan state while another instance holds the lock, so that it
+   can take over without starting from scratch. Only the instance that
+   holds the lock ("active") writes rows or touches the hardware. */
+static bool standby = false;
+static bool active = false;
+
+/* trace files for --record and --replay */
+static char *record_path = NULL;
+static char *replay_path = NULL;
+
+/* where the fan wear counters are persisted (--wear-log), or NULL for the
+   default */
+static char *wear_log_path = NULL;
+/* the flight recorder file (--flight-recorder), or NULL for the default */
+static char *flight_path = NULL;
+
 /* define a shash (string hash) to hold the subsystems (by name) */
 struct shash subsystem_data;
 /* define a shash (string hash) to hold the fans (by name) */
 struct shash fan_data;
 
-/* global yaml config handle */
-YamlConfigHandle yaml_handle;
-
 /* initialize the subsystem data (and the fan data) dictionaries */
 static void
 init_subsystems(void)
@@ -110,17 +189,439 @@ lookup_fan(const char *name)
     return(NULL);
 }
 
+/* compare two strings, either of which may be NULL */
+static bool
+fand_string_is_equal(const char *a, const char *b)
+{
+    return(a ? b && strcmp(a, b) == 0 : b == NULL);
+}
+
+/* (re)open the event line of other_config KEY when its path changes,
+   closing the old one. returns true if it changed. */
+static bool
+fand_config_event_line(const struct locl_subsystem *subsystem,
+                       const struct smap *other_config, const char *key,
+                       char **gpio, int *fd)
+{
+    const char *path = smap_get(other_config, key);
+
+    if (path != NULL && path[0] != '/') {
+        VLOG_WARN("subsystem %s: invalid %s \"%s\", not an absolute path",
+                  subsystem->name, key, path);
+        path = NULL;
+    }
+    if (fand_string_is_equal(path, *gpio)) {
+        return(false);
+    }
+
+    fand_event_close(*fd);
+    free(*gpio);
+    *gpio = NULL;
+    *fd = -1;
+    if (path != NULL) {
+        *gpio = xstrdup(path);
+        /* a replay gets its events from the trace */
+        if (!fand_replaying()) {
+            *fd = fand_event_open(path);
+        }
+    }
+
+    return(true);
+}
+
+/* parse fan_rpm_targets: the rpm of each speed level, slowest first. on
+   success, fill in targets and return true. */
+static bool
+fand_config_rpm_targets(const char *name, const char *value,
+                        int targets[FAND_SPEED_MAX + 1])
+{
+    char *copy, *save_ptr = NULL, *token;
+    int speed = FAND_SPEED_SLOW;
+    bool ok = true;
+
+    copy = xstrdup(value);
+    for (token = strtok_r(copy, ",", &save_ptr); token != NULL;
+            token = strtok_r(NULL, ",", &save_ptr)) {
+        if (speed > FAND_SPEED_MAX || !str_to_int(token, 10, &targets[speed])
+                || targets[speed] <= 0) {
+            ok = false;
+            break;
+        }
+        speed++;
+    }
+    free(copy);
+
+    if (!ok || speed != FAND_SPEED_MAX + 1) {
+        VLOG_WARN("subsystem %s: invalid fan_rpm_targets \"%s\"",
+                  name, value);
+        return(false);
+    }
+    return(true);
+}
+
+/* parse fan_rpm_mode, "DEVICE:REGISTER:MASK:VALUE": the bits of a
+   register of the hardware description that put the speed controller in
+   target rpm mode. on success, fill in op and value and return true. */
+static bool
+fand_config_rpm_mode(const struct locl_subsystem *subsystem,
+                     const char *value, i2c_bit_op *op, uint32_t *bits)
+{
+    char *copy, *save_ptr = NULL, *token;
+    const YamlDevice *device = NULL;
+    int fields[3];
+    size_t idx;
+    bool ok;
+
+    copy = xstrdup(value);
+    token = strtok_r(copy, ":", &save_ptr);
+    if (token != NULL) {
+        device = yaml_find_device(subsystem->yaml_handle, subsystem->name,
+                                  token);
+    }
+    ok = device != NULL;
+    for (idx = 0; ok && idx < ARRAY_SIZE(fields); idx++) {
+        token = strtok_r(NULL, ":", &save_ptr);
+        ok = token != NULL && str_to_int(token, 0, &fields[idx]) &&
+             fields[idx] >= 0;
+    }
+    ok = ok && strtok_r(NULL, ":", &save_ptr) == NULL && fields[1] != 0;
+    free(copy);
+
+    if (!ok) {
+        VLOG_WARN("subsystem %s: invalid fan_rpm_mode \"%s\"",
+                  subsystem->name, value);
+        return(false);
+    }
+
+    memset(op, 0, sizeof(*op));
+    /* the device name of the description, for the bus lookup cache */
+    op->device = device->name;
+    op->register_address = fields[0];
+    op->register_size = 1;
+    op->bit_mask = fields[1];
+    *bits = fields[2] & fields[1];
+    return(true);
+}
+
+/* read the target rpm settings from other_config, which depend on the
+   register backend of the subsystem */
+static void
+fand_read_rpm_config(struct locl_subsystem *subsystem,
+                     const struct smap *other_config)
+{
+    int rpm_targets[FAND_SPEED_MAX + 1];
+    i2c_bit_op rpm_mode;
+    uint32_t rpm_mode_value = 0;
+    const char *value;
+    bool rpm_control;
+
+    /* in target rpm mode the governor works in rpm, not register values:
+       restart it when the mode or the targets change */
+    value = smap_get(other_config, "fan_rpm_targets");
+    memset(rpm_targets, 0, sizeof(rpm_targets));
+    rpm_control = value != NULL &&
+        fand_config_rpm_targets(subsystem->name, value, rpm_targets);
+
+    /* with its registers, the controller has to be told to regulate to
+       the speed control value, or it would take a tach count for a duty
+       cycle. an hwmon driver or a plugin is given the rpm, and knows. */
+    memset(&rpm_mode, 0, sizeof(rpm_mode));
+    value = smap_get(other_config, "fan_rpm_mode");
+    if (value != NULL) {
+        fand_config_rpm_mode(subsystem, value, &rpm_mode, &rpm_mode_value);
+    }
+    if (rpm_control && rpm_mode.device == NULL && subsystem->hwmon == NULL
+            && !FAND_PLUGIN_HAS(subsystem, set_speed)) {
+        VLOG_WARN("subsystem %s: fan_rpm_targets without fan_rpm_mode, "
+                  "ignored", subsystem->name);
+        rpm_control = false;
+        memset(rpm_targets, 0, sizeof(rpm_targets));
+    }
+    if (memcmp(&rpm_mode, &subsystem->rpm_mode, sizeof(rpm_mode)) != 0 ||
+            rpm_mode_value != subsystem->rpm_mode_value) {
+        subsystem->rpm_mode = rpm_mode;
+        subsystem->rpm_mode_value = rpm_mode_value;
+        subsystem->rpm_mode_on = false;
+    }
+    if (rpm_control != subsystem->rpm_control ||
+            memcmp(rpm_targets, subsystem->rpm_targets,
+                   sizeof(rpm_targets)) != 0) {
+        subsystem->rpm_control = rpm_control;
+        memcpy(subsystem->rpm_targets, rpm_targets, sizeof(rpm_targets));
+        fan_governor_reset(&subsystem->governor_state);
+    }
+}
+
+/* (re)open the presence and thermal alert lines if their paths changed */
+static void
+fand_read_event_config(struct locl_subsystem *subsystem,
+                       const struct smap *other_config)
+{
+    fand_config_event_line(subsystem, other_config, "fan_presence_gpio",
+                           &subsystem->presence_gpio,
+                           &subsystem->presence_fd);
+    if (fand_config_event_line(subsystem, other_config,
+                               "fan_thermal_alert_gpio",
+                               &subsystem->thermal_alert_gpio,
+                               &subsystem->thermal_alert_fd)) {
+        /* the line may already be asserted */
+        subsystem->thermal_alert_pending = true;
+    }
+}
+
+/* read the per-subsystem settings from other_config. if the rpm filter
+   settings change, restart all of the subsystem's fan filters. */
+static void
+fand_read_subsystem_config(struct locl_subsystem *subsystem,
+                           const struct smap *other_config)
+{
+    struct fan_rpm_filter_config filter;
+    size_t idx;
+    int gain;
+
+    subsystem->tach_word_read = smap_get_bool(other_config,
+                                              "fan_tach_word_read", false);
+
+    fan_governor_config_init(&subsystem->governor);
+    subsystem->governor.down_dwell_msec =
+        smap_get_int(other_config, "fan_speed_down_dwell",
+                     subsystem->governor.down_dwell_msec);
+    subsystem->governor.slew =
+        smap_get_int(other_config, "fan_speed_slew",
+                     subsystem->governor.slew);
+    subsystem->governor.slew_interval_msec =
+        smap_get_int(other_config, "fan_speed_slew_interval",
+                     subsystem->governor.slew_interval_msec);
+    if (subsystem->governor.slew_interval_msec <= 0) {
+        VLOG_WARN("subsystem %s: invalid fan_speed_slew_interval %d",
+                  subsystem->name, subsystem->governor.slew_interval_msec);
+        fan_governor_config_init(&subsystem->governor);
+    }
+
+    subsystem->redundancy_step = smap_get_int(other_config,
+                                              "fan_redundancy_step", 0);
+    if (subsystem->redundancy_step < 0 ||
+            subsystem->redundancy_step > FAND_SPEED_MAX) {
+        VLOG_WARN("subsystem %s: invalid fan_redundancy_step %d",
+                  subsystem->name, subsystem->redundancy_step);
+        subsystem->redundancy_step = 0;
+    }
+
+    /* a new gain starts from the current load */
+    gain = smap_get_int(other_config, "fan_load_gain", 0);
+    if (gain < 0 || gain > FAND_SPEED_MAX) {
+        VLOG_WARN("subsystem %s: invalid fan_load_gain %d",
+                  subsystem->name, gain);
+        gain = 0;
+    }
+    if (gain != subsystem->load.gain) {
+        subsystem->load.gain = gain;
+        subsystem->load.last_msec = -1;
+        subsystem->load.boost = 0;
+    }
+    subsystem->load.decay_msec = smap_get_int(other_config, "fan_load_decay",
+                                              30000);
+    if (subsystem->load.decay_msec <= 0) {
+        VLOG_WARN("subsystem %s: invalid fan_load_decay %d",
+                  subsystem->name, subsystem->load.decay_msec);
+        subsystem->load.decay_msec = 30000;
+    }
+
+    subsystem->poll_budget_msec = smap_get_int(other_config,
+                                               "fan_poll_budget", 0);
+    if (subsystem->poll_budget_msec < 0) {
+        VLOG_WARN("subsystem %s: invalid fan_poll_budget %d",
+                  subsystem->name, subsystem->poll_budget_msec);
+        subsystem->poll_budget_msec = 0;
+    }
+
+    /* the rpm mode needs the hardware description and the backends, and
+       the event lines are only opened for a subsystem that can be
+       managed, so a new subsystem reads them once it is set up */
+    if (subsystem->yaml_handle != NULL) {
+        fand_read_rpm_config(subsystem, other_config);
+        fand_read_event_config(subsystem, other_config);
+    }
+
+    fan_rpm_filter_config_init(&filter);
+    filter.type = fan_rpm_filter_string_to_enum(
+                        smap_get(other_config, "fan_rpm_filter"));
+    filter.window = smap_get_int(other_config, "fan_rpm_filter_window",
+                                 filter.window);
+    filter.alpha = smap_get_int(other_config, "fan_rpm_filter_alpha",
+                                filter.alpha);
+    filter.outlier_pct = smap_get_int(other_config, "fan_rpm_outlier_pct",
+                                      filter.outlier_pct);
+    filter.outlier_limit = smap_get_int(other_config,
+                                        "fan_rpm_outlier_limit",
+                                        filter.outlier_limit);
+
+    if (filter.alpha < 1 || filter.alpha > 100) {
+        VLOG_WARN("subsystem %s: invalid fan_rpm_filter_alpha %d",
+                  subsystem->name, filter.alpha);
+        filter.alpha = 100;
+    }
+
+    if (memcmp(&filter, &subsystem->rpm_filter, sizeof(filter)) == 0) {
+        return;
+    }
+
+    subsystem->rpm_filter = filter;
+
+    for (idx = 0; idx < subsystem->n_fans; idx++) {
+        fan_rpm_filter_reset(&subsystem->fan_state.rpm_filter[idx]);
+    }
+}
+
+/* check whether a subsystem is handled by this instance */
+static bool
+fand_owns_subsystem(const struct ovsrec_subsystem *ovsrec_subsys)
+{
+    const char *tag = smap_get(&ovsrec_subsys->other_config, "fan_shard");
+    const char *pattern;
+    size_t i;
+
+    if (tag != NULL) {
+        return(shard_name != NULL && strcmp(tag, shard_name) == 0);
+    }
+
+    if (shard_patterns.n == 0) {
+        return(shard_name == NULL);
+    }
+
+    SVEC_FOR_EACH(i, pattern, &shard_patterns) {
+        if (fnmatch(pattern, ovsrec_subsys->name, 0) == 0) {
+            return(true);
+        }
+    }
+
+    return(false);
+}
+
+/* drop the hardware description data of a subsystem */
+static void
+fand_release_yaml(struct locl_subsystem *subsystem)
+{
+    if (subsystem->yaml_handle != NULL) {
+        fand_bus_forget(subsystem->yaml_handle);
+        yaml_free_config_handle(subsystem->yaml_handle);
+        subsystem->yaml_handle = NULL;
+    }
+    subsystem->fan_info = NULL;
+    subsystem->frus = NULL;
+}
+
+/* an other_config string of a subsystem, "" if not set */
+static const char *
+fand_config_string(const struct ovsrec_subsystem *ovsrec_subsys,
+                   const char *key)
+{
+    const char *value = smap_get(&ovsrec_subsys->other_config, key);
+
+    return(value ? value : "");
+}
+
+/* check whether the register backend settings of a subsystem changed */
+static bool
+fand_backend_changed(const struct locl_subsystem *subsystem,
+                     const struct ovsrec_subsystem *ovsrec_subsys)
+{
+    return(strcmp(subsystem->hwmon_dir,
+                  fand_config_string(ovsrec_subsys, "fan_hwmon_dir")) ||
+           strcmp(subsystem->mmio_device,
+                  fand_config_string(ovsrec_subsys, "fan_mmio_device")) ||
+           strcmp(subsystem->mmio_path,
+                  fand_config_string(ovsrec_subsys, "fan_mmio_path")));
+}
+
+/* take control of a loaded subsystem: create its Fan rows, read the FRU
+   presence and program the fan speed. when resuming after a standby
+   period, existing rows keep their (followed) values, and the speed is only
+   written if it differs from the published one. */
+static void
+fand_claim_subsystem(const struct ovsrec_subsystem *ovsrec_subsys,
+                     struct locl_subsystem *subsystem, bool resume)
+{
+    struct ovsdb_idl_txn *txn;
+    struct ovsrec_fan **fan_array;
+    enum fanspeed speed;
+    bool speed_published = resume;
+    size_t idx;
+
+    fan_array = xcalloc(subsystem->n_fans, sizeof(struct ovsrec_fan *));
+
+    txn = ovsdb_idl_txn_create(idl);
+
+    for (idx = 0; idx < subsystem->n_fans; idx++) {
+        struct locl_fan *fan = &subsystem->fans[idx];
+        struct ovsrec_fan *ovs_fan;
+
+        /* look for existing Fan rows */
+        ovs_fan = lookup_fan(fan->name);
+
+        if (ovs_fan != NULL && resume) {
+            fan_array[idx] = ovs_fan;
+            continue;
+        }
+
+        if (ovs_fan == NULL) {
+            ovs_fan = ovsrec_fan_insert(txn);
+            speed_published = false;
+        }
+
+        ovsrec_fan_set_name(ovs_fan, fan->name);
+        ovsrec_fan_set_status(ovs_fan,
+            fan_status_enum_to_string(FAND_STATUS_UNINITIALIZED));
+        /* OPS_TODO: these have to be set, but "f2b" and "normal"
+           may not be the right values for defaults. */
+        ovsrec_fan_set_direction(ovs_fan, "f2b");
+        ovsrec_fan_set_speed(ovs_fan, fan_speed_enum_to_string(FAND_SPEED_NORMAL));
+
+        fan_array[idx] = ovs_fan;
+    }
+
+    ovsrec_subsystem_set_fans(ovsrec_subsys, fan_array, subsystem->n_fans);
+    ovsdb_idl_txn_commit_block(txn);
+    ovsdb_idl_txn_destroy(txn);
+    free(fan_array);
+    n_txns++;
+
+    /* remember which FRUs are present, to detect hotplug events */
+    for (idx = 0; idx < subsystem->n_frus; idx++) {
+        subsystem->fru_present[idx] = fand_read_fan_fru_present(subsystem, idx);
+    }
+
+    /* the previous instance already programmed the speed it published */
+    subsystem->degraded = fand_subsystem_degraded(subsystem);
+    speed = fand_subsystem_speed(subsystem);
+    for (idx = 0; idx < subsystem->n_fans && speed_published; idx++) {
+        speed_published = subsystem->fan_state.speed[idx] == speed;
+    }
+    if (speed_published) {
+        fand_resume_fanspeed(subsystem, speed);
+    } else {
+        fand_set_fanspeed(subsystem);
+    }
+
+    /* the thermal alert line may have changed while in standby */
+    subsystem->thermal_alert_pending = true;
+
+    /* read the fans right away, then settle into the subsystem's slot */
+    subsystem->next_poll_msec = fand_now();
+}
+
 /* create a new subsystem structure and add all the dependent ports
-   as a side-effect, create all fans in the database */
+   as a side-effect, create all fans in the database.
+   a subsystem that can't be managed is still added (so that it isn't
+   parsed again on every reconfigure), but is marked as not valid. */
 static struct locl_subsystem *
 add_subsystem(const struct ovsrec_subsystem *ovsrec_subsys)
 {
+    struct fand_arena *arena;
     struct locl_subsystem *result;
     int rc;
     int total_fans;
     unsigned int idx;
-    struct ovsdb_idl_txn *txn;
-    struct ovsrec_fan **fan_array;
     int total_fan_idx;
     unsigned int fan_fru_count;
     const char *dir;
@@ -130,19 +631,24 @@ add_subsystem(const struct ovsrec_subsystem *ovsrec_subsys)
     enum fanspeed override_value = FAND_SPEED_NONE;
 
     VLOG_DBG("Adding new subsystem %s", ovsrec_subsys->name);
-    result = (struct locl_subsystem *)malloc(sizeof(struct locl_subsystem));
-    memset(result, 0, sizeof(struct locl_subsystem));
+    /* everything the subsystem owns comes from its arena */
+    arena = fand_arena_create(SUBSYSTEM_ARENA_SIZE);
+    result = fand_arena_alloc(arena, sizeof(struct locl_subsystem));
+    result->arena = arena;
     (void)shash_add(&subsystem_data, ovsrec_subsys->name, (void *)result);
-    result->name = strdup(ovsrec_subsys->name);
+    result->name = fand_arena_strdup(arena, ovsrec_subsys->name);
     result->marked = false;
     result->valid = false;
     result->parent_subsystem = NULL;  /* OPS_TODO: find parent subsystem */
-    shash_init(&result->subsystem_fans);
     override = smap_get(&ovsrec_subsys->other_config, "fan_speed_override");
     if (override != NULL) {
         override_value = fan_speed_string_to_enum(override);
     }
     result->fan_speed_override = override_value;
+    result->presence_fd = -1;
+    result->thermal_alert_fd = -1;
+    fan_governor_reset(&result->governor_state);
+    fand_read_subsystem_config(result, &ovsrec_subsys->other_config);
 
     /* OPS_TODO: could check to see if the temp sensors have been populated
        with data and use that for the sensor speed when initializing the
@@ -151,45 +657,59 @@ add_subsystem(const struct ovsrec_subsystem *ovsrec_subsys)
 
     /* use a default if the hw_desc_dir has not been populated */
     dir = ovsrec_subsys->hw_desc_dir;
+    result->hw_desc_dir = fand_arena_strdup(arena, dir ? dir : "");
+    /* the register backend; a change reloads the subsystem */
+    result->hwmon_dir = fand_arena_strdup(arena,
+            fand_config_string(ovsrec_subsys, "fan_hwmon_dir"));
+    result->mmio_device = fand_arena_strdup(arena,
+            fand_config_string(ovsrec_subsys, "fan_mmio_device"));
+    result->mmio_path = fand_arena_strdup(arena,
+            fand_config_string(ovsrec_subsys, "fan_mmio_path"));
 
     if (dir == NULL || strlen(dir) == 0) {
         VLOG_ERR("No h/w description directory for subsystem %s",
                  ovsrec_subsys->name);
-        return(NULL);
+        return(result);
     }
 
     /* since this is a new subsystem, load all of the hardware description
        information about devices and fans (just for this subsystem).
-       parse fan and device data for subsystem */
-    rc = yaml_add_subsystem(yaml_handle, ovsrec_subsys->name, dir);
+       parse fan and device data for subsystem. each subsystem has its own
+       handle, so that all of it can be released when the subsystem goes. */
+    result->yaml_handle = yaml_new_config_handle();
+    rc = yaml_add_subsystem(result->yaml_handle, ovsrec_subsys->name, dir);
 
     if (rc != 0) {
         VLOG_ERR("Error getting h/w description information for subsystem %s",
                  ovsrec_subsys->name);
-        return(NULL);
+        fand_release_yaml(result);
+        return(result);
     }
 
-    rc = yaml_parse_devices(yaml_handle, ovsrec_subsys->name);
+    rc = yaml_parse_devices(result->yaml_handle, ovsrec_subsys->name);
 
     if (rc != 0) {
         VLOG_ERR("Unable to parse subsystem %s devices file (in %s)",
                  ovsrec_subsys->name, dir);
-        return(NULL);
+        fand_release_yaml(result);
+        return(result);
     }
 
-    rc = yaml_parse_fans(yaml_handle, ovsrec_subsys->name);
+    rc = yaml_parse_fans(result->yaml_handle, ovsrec_subsys->name);
 
     if (rc != 0) {
         VLOG_ERR("Unable to parse subsystem %s fan file (in %s)",
                  ovsrec_subsys->name, dir);
-        return(NULL);
+        fand_release_yaml(result);
+        return(result);
     }
 
-    fan_info = yaml_get_fan_info(yaml_handle, ovsrec_subsys->name);
+    fan_info = yaml_get_fan_info(result->yaml_handle, ovsrec_subsys->name);
 
     if (fan_info == NULL) {
         VLOG_INFO("subsystem %s has no fan info", ovsrec_subsys->name);
-        return(NULL);
+        fand_release_yaml(result);
+        return(result);
     }
 
     result->multiplier = fan_info->fan_speed_multiplier;
@@ -199,28 +719,50 @@ add_subsystem(const struct ovsrec_subsystem *ovsrec_subsys)
     total_fans = 0;
     total_fan_idx = 0;
 
-    fan_fru_count = yaml_get_fan_fru_count(yaml_handle, ovsrec_subsys->name);
+    fan_fru_count = yaml_get_fan_fru_count(result->yaml_handle,
+                                           ovsrec_subsys->name);
 
     VLOG_DBG("There are %d fan FRUS in subsystem %s", fan_fru_count, ovsrec_subsys->name);
 
     if (fan_fru_count <= 0) {
-        return(NULL);
+        fand_release_yaml(result);
+        return(result);
     }
 
     result->valid = true;
 
     for (idx = 0; idx < fan_fru_count; idx++) {
-        const YamlFanFru *fan_fru = yaml_get_fan_fru(yaml_handle, ovsrec_subsys->name, idx);
+        const YamlFanFru *fan_fru = yaml_get_fan_fru(result->yaml_handle,
+                                                     ovsrec_subsys->name,
+                                                     idx);
         /* each FanFru has one or more fans */
         for (fan_idx = 0; fan_fru->fans[fan_idx] != NULL; fan_idx++) {
             ++total_fans;
         }
     }
 
-    fan_array = (struct ovsrec_fan **)malloc(total_fans * sizeof(struct ovsrec_fan *));
-    memset(fan_array, 0, total_fans * sizeof(struct ovsrec_fan *));
-
-    txn = ovsdb_idl_txn_create(idl);
+    /* the fans and their state arrays are laid out back to back */
+    result->n_frus = fan_fru_count;
+    result->fru_first_fan = fand_arena_alloc(arena, (fan_fru_count + 1) *
+                                                    sizeof(size_t));
+    result->fan_info = fan_info;
+    result->frus = fand_arena_alloc(arena,
+                                    fan_fru_count * sizeof(YamlFanFru *));
+    result->n_fans = total_fans;
+    result->fans = fand_arena_alloc(arena,
+                                    total_fans * sizeof(struct locl_fan));
+    result->fan_state.rpm = fand_arena_alloc(arena, total_fans * sizeof(int));
+    result->fan_state.status = fand_arena_alloc(arena, total_fans);
+    result->fan_state.direction = fand_arena_alloc(arena, total_fans);
+    result->fan_state.speed = fand_arena_alloc(arena, total_fans);
+    result->fan_state.dirty = fand_arena_alloc(arena,
+                                               total_fans * sizeof(bool));
+    result->fan_state.changed = fand_arena_alloc(arena, total_fans *
+                                                 sizeof(long long int));
+    result->fan_state.rpm_filter = fand_arena_alloc(arena, total_fans *
+                                                sizeof(struct fan_rpm_filter));
+    result->fru_present = fand_arena_alloc(arena,
+                                           fan_fru_count * sizeof(bool));
 
     VLOG_DBG("There are %d total fans in subsystem %s", total_fans, ovsrec_subsys->name);
     log_event("FAN_COUNT", EV_KV("count", "%d", total_fans),
@@ -228,11 +770,15 @@ add_subsystem(const struct ovsrec_subsystem *ovsrec_subsys)
 
     /* TODO walk through fans and add them to DB */
     for (idx = 0; idx < fan_fru_count; idx++) {
-        const YamlFanFru *fan_fru = yaml_get_fan_fru(yaml_handle, ovsrec_subsys->name, idx);
+        const YamlFanFru *fan_fru = yaml_get_fan_fru(result->yaml_handle,
+                                                     ovsrec_subsys->name,
+                                                     idx);
+
+        result->frus[idx] = fan_fru;
+        result->fru_first_fan[idx] = total_fan_idx;
 
         /* each FanFru has one or more fans */
         for (fan_idx = 0; fan_fru->fans[fan_idx] != NULL; fan_idx++) {
-            struct ovsrec_fan *ovs_fan;
             char *fan_name = NULL;
             const YamlFan *fan = fan_fru->fans[fan_idx];
             struct locl_fan *new_fan;
@@ -240,42 +786,82 @@ add_subsystem(const struct ovsrec_subsystem *ovsrec_subsys)
                 fan->name,
                 ovsrec_subsys->name);
 
-            asprintf(&fan_name, "%s-%s", ovsrec_subsys->name, fan->name);
-            new_fan = (struct locl_fan *)malloc(sizeof(struct locl_fan));
+            fan_name = fand_arena_printf(arena, "%s-%s",
+                                         ovsrec_subsys->name, fan->name);
+            new_fan = &result->fans[total_fan_idx];
             new_fan->name = fan_name;
             new_fan->subsystem = result;
             new_fan->yaml_fan = fan;
+            new_fan->idx = total_fan_idx;
+            new_fan->fru_idx = idx;
 
-            shash_add(&result->subsystem_fans, fan_name, (void *)new_fan);
-            shash_add(&fan_data, fan_name, (void *)new_fan);
-
-            /* look for existing Fan rows */
-            ovs_fan = lookup_fan(fan_name);
-
-            if (ovs_fan == NULL) {
-                ovs_fan = ovsrec_fan_insert(txn);
-            }
+            /* same defaults as the row below; rpm is still unpublished */
+            result->fan_state.status[total_fan_idx] =
+                                        FAND_STATUS_UNINITIALIZED;
+            result->fan_state.direction[total_fan_idx] = FAND_DIRECTION_F2B;
+            result->fan_state.speed[total_fan_idx] = FAND_SPEED_NORMAL;
+            result->fan_state.dirty[total_fan_idx] = true;
 
-            ovsrec_fan_set_name(ovs_fan, fan_name);
-            ovsrec_fan_set_status(ovs_fan,
-                fan_status_enum_to_string(FAND_STATUS_UNINITIALIZED));
-            /* OPS_TODO: these have to be set, but "f2b" and "normal"
-               may not be the right values for defaults. */
-            ovsrec_fan_set_direction(ovs_fan, "f2b");
-            ovsrec_fan_set_speed(ovs_fan, fan_speed_enum_to_string(FAND_SPEED_NORMAL));
+            shash_add(&fan_data, fan_name, (void *)new_fan);
+            total_fan_idx++;
+        }
+    }
 
-            fan_array[total_fan_idx++] = ovs_fan;
+    result->fru_first_fan[fan_fru_count] = total_fan_idx;
+    if (result->hwmon_dir[0] != '\0') {
+        result->hwmon = fand_hwmon_open(arena, result->name,
+                                        result->hwmon_dir, total_fans);
+    }
+    fand_plugin_attach(result);
+    /* a replay gets the register values from the trace */
+    if (result->mmio_device[0] != '\0' && result->mmio_path[0] != '\0' &&
+            !fand_replaying()) {
+        result->mmio = fand_mmio_open(result->mmio_device, result->mmio_path);
+        if (result->mmio != NULL) {
+            fand_bus_map_device(result->yaml_handle, result->mmio);
         }
     }
+    fand_read_rpm_config(result, &ovsrec_subsys->other_config);
+    fand_read_event_config(result, &ovsrec_subsys->other_config);
+    fand_plan_samples(result);
+    fand_power_attach(result);
+    fand_wear_attach(result);
+    fand_flight_attach(result);
+
+    /* a standby instance leaves the rows and the hardware alone */
+    if (active) {
+        fand_claim_subsystem(ovsrec_subsys, result, false);
+    }
 
-    ovsrec_subsystem_set_fans(ovsrec_subsys, fan_array, total_fans);
-    ovsdb_idl_txn_commit_block(txn);
-    ovsdb_idl_txn_destroy(txn);
-    free(fan_array);
+    return(result);
+}
+
+/* tear down a subsystem: forget its fans, close its event line, and
+   release its hardware description data and its arena */
+static void
+fand_remove_subsystem(struct locl_subsystem *subsystem)
+{
+    size_t idx;
 
-    fand_set_fanspeed(result);
+    VLOG_DBG("Removing subsystem %s", subsystem->name);
 
-    return(result);
+    for (idx = 0; idx < subsystem->n_fans; idx++) {
+        /* delete the fan_data entry */
+        shash_find_and_delete(&fan_data, subsystem->fans[idx].name);
+    }
+    shash_find_and_delete(&subsystem_data, subsystem->name);
+
+    fand_event_close(subsystem->presence_fd);
+    free(subsystem->presence_gpio);
+    fand_event_close(subsystem->thermal_alert_fd);
+    free(subsystem->thermal_alert_gpio);
+    fand_hwmon_close(subsystem->hwmon);
+    fand_plugin_detach(subsystem);
+    fand_release_yaml(subsystem);
+    fand_mmio_close(subsystem->mmio);
+
+    /* the fans, names and per-FRU state all go with the arena */
+    fand_arena_destroy(subsystem->arena);
 }
 
 /* lookup a local subsystem structure
@@ -285,6 +871,7 @@ get_subsystem(const struct ovsrec_subsystem *ovsrec_subsys)
 {
     void *ptr;
     struct locl_subsystem *result = NULL;
+    const char *dir = ovsrec_subsys->hw_desc_dir;
 
     ptr = shash_find_data(&subsystem_data, ovsrec_subsys->name);
 
@@ -293,8 +880,16 @@ get_subsystem(const struct ovsrec_subsystem *ovsrec_subsys)
         result = add_subsystem(ovsrec_subsys);
     } else {
         result = (struct locl_subsystem *)ptr;
-        if (!result->valid) {
-            result = NULL;
+        /* a subsystem that couldn't be used gets another chance if its
+           h/w description directory changes */
+        if (!result->valid &&
+                strcmp(result->hw_desc_dir, dir ? dir : "") != 0) {
+            fand_remove_subsystem(result);
+            result = add_subsystem(ovsrec_subsys);
+        } else if (fand_backend_changed(result, ovsrec_subsys)) {
+            /* the sample plan depends on the backend: start over */
+            fand_remove_subsystem(result);
+            result = add_subsystem(ovsrec_subsys);
         }
     }
 
@@ -320,32 +915,14 @@ static void
 fand_remove_unmarked_subsystems(void)
 {
     struct shash_node *node, *next;
-    struct shash_node *fan_node, *fan_next;
-    struct shash_node *global_node;
 
     SHASH_FOR_EACH_SAFE(node, next, &subsystem_data) {
         struct locl_subsystem *subsystem = node->data;
 
+        /* the Fan rows go away with the subsystem row (they aren't
+           referenced by anything else) */
         if (subsystem->marked == false) {
-            /* also, delete all fans in the subsystem */
-            SHASH_FOR_EACH_SAFE(fan_node, fan_next, &subsystem->subsystem_fans) {
-                struct locl_fan *fan = (struct locl_fan *)fan_node->data;
-                /* delete the fan_data entry */
-                global_node = shash_find(&fan_data, fan->name);
-                shash_delete(&fan_data, global_node);
-                /* delete the subsystem entry */
-                shash_delete(&subsystem->subsystem_fans, fan_node);
-                /* free the allocated data */
-                free(fan->name);
-                free(fan);
-            }
-            free(subsystem->name);
-            free(subsystem);
-
-            shash_delete(&subsystem_data, node);
-
-            /* OPS_TODO: need to remove subsystem yaml data
-                           verify that ovsdb has deleted the fans (automatic) */
+            fand_remove_subsystem(subsystem);
         }
     }
 }
@@ -359,12 +936,16 @@ fand_init(const char *remote)
     /* initialize subsystems */
     init_subsystems();
 
-    /* initialize the yaml handle */
-    yaml_handle = yaml_new_config_handle();
-
     idl = ovsdb_idl_create(remote, &ovsrec_idl_class, false, true);
     idl_seqno = ovsdb_idl_get_seqno(idl);
-    ovsdb_idl_set_lock(idl, "ops_fand");
+    db_remote = xstrdup(remote);
+    if (shard_name != NULL) {
+        char *lock_name = xasprintf("ops_fand_%s", shard_name);
+        ovsdb_idl_set_lock(idl, lock_name);
+        free(lock_name);
+    } else {
+        ovsdb_idl_set_lock(idl, "ops_fand");
+    }
     ovsdb_idl_verify_write_only(idl);
 
     /* register interest in daemon table */
@@ -386,10 +967,16 @@ fand_init(const char *remote)
     ovsdb_idl_omit_alert(idl, &ovsrec_fan_col_rpm);
     ovsdb_idl_add_column(idl, &ovsrec_fan_col_status);
     ovsdb_idl_omit_alert(idl, &ovsrec_fan_col_status);
+    ovsdb_idl_add_column(idl, &ovsrec_fan_col_other_config);
+    ovsdb_idl_omit_alert(idl, &ovsrec_fan_col_other_config);
 
     /* handle temp sensors (fan status output of temp sensors) */
     ovsdb_idl_add_table(idl, &ovsrec_table_temp_sensor);
     ovsdb_idl_add_column(idl, &ovsrec_temp_sensor_col_fan_state);
+    if (replay_path != NULL) {
+        /* a replay creates the sensors of the recorded configuration */
+        ovsdb_idl_add_column(idl, &ovsrec_temp_sensor_col_name);
+    }
 
     /* register interest in the subsystems. this process needs the
        name and hw_desc_dir fields. the name value must be unique within
@@ -407,6 +994,29 @@ fand_init(const char *remote)
 
     unixctl_command_register("ops-fand/dump", "", 0, 0,
                              fand_unixctl_dump, NULL);
+    unixctl_command_register("ops-fand/power", "[subsystem]", 0, 1,
+                             fand_unixctl_power, NULL);
+    unixctl_command_register("ops-fand/flight-export", "[file]", 0, 1,
+                             fand_unixctl_flight_export, NULL);
+#ifdef FAND_TRACE
+    unixctl_command_register("ops-fand/trace", "[seconds]", 0, 1,
+                             fand_unixctl_trace, NULL);
+#endif
+
+    if (sim_bus) {
+        fansim_init();
+        unixctl_command_register("ops-fand/sim-fru-present",
+                                 "subsystem fru present|absent [no-event]",
+                                 3, 4,
+                                 fand_unixctl_sim_fru_present, NULL);
+        unixctl_command_register("ops-fand/sim-thermal-alert",
+                                 "subsystem asserted|clear", 2, 2,
+                                 fand_unixctl_sim_thermal_alert, NULL);
+        unixctl_command_register("ops-fand/sim-fan",
+                                 "subsystem fan rpm ok|fault "
+                                 "[failed-reads]", 4, 5,
+                                 fand_unixctl_sim_fan, NULL);
+    }
 
     retval = event_log_init("FAN");
     if(retval < 0) {
@@ -417,30 +1027,131 @@ fand_init(const char *remote)
 static void
 fand_exit(void)
 {
+    struct shash_node *node, *next;
+
+    SHASH_FOR_EACH_SAFE(node, next, &subsystem_data) {
+        fand_remove_subsystem(node->data);
+    }
+    fand_wear_close();
+    fand_flight_close();
+    fand_record_close();
+    if (load_idl != NULL) {
+        ovsdb_idl_destroy(load_idl);
+    }
+    free(db_remote);
     ovsdb_idl_destroy(idl);
 }
 
+/* clear the "needs publishing" flag of every fan */
+static void
+fand_clear_dirty(void)
+{
+    const struct shash_node *node;
+
+    SHASH_FOR_EACH(node, &subsystem_data) {
+        struct locl_subsystem *subsystem = (struct locl_subsystem *)node->data;
+        memset(subsystem->fan_state.dirty, 0,
+               subsystem->n_fans * sizeof(bool));
+    }
+}
+
+/* check whether any fan has state to publish */
+static bool
+fand_any_dirty(void)
+{
+    const struct shash_node *node;
+    size_t idx;
+
+    SHASH_FOR_EACH(node, &subsystem_data) {
+        const struct locl_subsystem *subsystem = node->data;
+
+        for (idx = 0; idx < subsystem->n_fans; idx++) {
+            if (subsystem->fan_state.dirty[idx]) {
+                return(true);
+            }
+        }
+    }
+
+    return(false);
+}
+
+/* (standby) copy the state published by the active instance into the
+   local fan state, so that it is current when this instance takes over */
+static void
+fand_follow_status(void)
+{
+    const struct ovsrec_fan *db_fan;
+
+    OVSREC_FAN_FOR_EACH(db_fan, idl) {
+        struct locl_fan_state *state;
+        struct locl_fan *fan;
+        size_t idx;
+
+        fan = shash_find_data(&fan_data, db_fan->name);
+        if (fan == NULL) {
+            continue;
+        }
+        state = &fan->subsystem->fan_state;
+        idx = fan->idx;
+
+        state->status[idx] = fan_status_string_to_enum(db_fan->status);
+        state->speed[idx] = fan_speed_string_to_enum(db_fan->speed);
+        state->direction[idx] =
+            fan_direction_string_to_enum(db_fan->direction);
+        if (db_fan->n_rpm > 0 && state->rpm[idx] != db_fan->rpm[0]) {
+            state->rpm[idx] = db_fan->rpm[0];
+            /* start the filter from the published value */
+            fan_rpm_filter_reset(&state->rpm_filter[idx]);
+            fan_rpm_filter_update(&state->rpm_filter[idx],
+                                  &fan->subsystem->rpm_filter,
+                                  state->rpm[idx]);
+        }
+        state->dirty[idx] = false;
+    }
+}
+
+/* the lock was acquired: take control of the subsystems that were loaded
+   while in standby, and poll right away */
+static void
+fand_takeover(void)
+{
+    const struct ovsrec_subsystem *cfg;
+
+    active = true;
+    fand_wear_open();
+    fand_flight_open();
+
+    if (!shash_is_empty(&subsystem_data)) {
+        VLOG_INFO("taking over %zu subsystems",
+                  shash_count(&subsystem_data));
+        fand_follow_status();
+    }
+
+    OVSREC_SUBSYSTEM_FOR_EACH(cfg, idl) {
+        struct locl_subsystem *subsystem;
+
+        subsystem = shash_find_data(&subsystem_data, cfg->name);
+        if (subsystem != NULL && subsystem->valid) {
+            fand_claim_subsystem(cfg, subsystem, true);
+        }
+    }
+}
+
+/* write the cached fan data to the DB. only fans whose state changed
+   since they were last published are looked at. */
 static void
-fand_read_status(struct ovsdb_idl *idl)
+fand_publish_status(struct ovsdb_idl *idl)
 {
     const struct ovsrec_fan *db_fan;
     const struct ovsrec_daemon *db_daemon;
-    const struct shash_node *node;
-    const struct shash_node *fan_node;
     struct ovsdb_idl_txn *txn;
+    enum ovsdb_idl_txn_status status;
     int64_t rpm[1];
     bool change;
 
-    /* read all fan status */
-    SHASH_FOR_EACH(node, &subsystem_data) {
-        struct locl_subsystem *subsystem = (struct locl_subsystem *)node->data;
-        SHASH_FOR_EACH(fan_node, &subsystem->subsystem_fans) {
-            struct locl_fan *fan;
-            fan = (struct locl_fan *)fan_node->data;
-            fan->speed = subsystem->speed;
-            fand_read_fan_status(fan);
-            VLOG_DBG("fan %s rpm set to %d\n", fan->name, fan->rpm);
-        }
+    /* a poll where nothing changed doesn't even start a transaction */
+    if (cur_hw_set && !fand_any_dirty()) {
+        return;
     }
 
     txn = ovsdb_idl_txn_create(idl);
@@ -448,26 +1159,39 @@ fand_read_status(struct ovsdb_idl *idl)
     change = false;
     /* walk through each fan in DB and update status from cached data */
     OVSREC_FAN_FOR_EACH(db_fan, idl) {
+        const struct locl_fan_state *state;
         struct locl_fan *fan;
-        fan_node = shash_find(&fan_data, db_fan->name);
-        fan = (struct locl_fan *)fan_node->data;
+        size_t idx;
+
+        fan = shash_find_data(&fan_data, db_fan->name);
+        if (fan == NULL) {
+            /* not one of ours */
+            continue;
+        }
+        state = &fan->subsystem->fan_state;
+        idx = fan->idx;
+        if (!state->dirty[idx]) {
+            continue;
+        }
 
-        const char *status = fan_status_enum_to_string(fan->status);
+        const char *status = fan_status_enum_to_string(state->status[idx]);
         if (strcmp(db_fan->status, status) != 0) {
             ovsrec_fan_set_status(db_fan, status);
             change = true;
         }
-        const char *speed = fan_speed_enum_to_string(fan->speed);
+        const char *speed = fan_speed_enum_to_string(state->speed[idx]);
         if (strcmp(db_fan->speed, speed) != 0) {
             ovsrec_fan_set_speed(db_fan, speed);
             change = true;
         }
-        if (strcmp(db_fan->direction, fan->direction) != 0) {
-            ovsrec_fan_set_direction(db_fan, fan->direction);
+        const char *direction =
+            fan_direction_enum_to_string(state->direction[idx]);
+        if (strcmp(db_fan->direction, direction) != 0) {
+            ovsrec_fan_set_direction(db_fan, direction);
             change = true;
         }
-        if (db_fan->rpm == NULL || db_fan->rpm[0] != fan->rpm) {
-            rpm[0] = fan->rpm;
+        if (db_fan->rpm == NULL || db_fan->rpm[0] != state->rpm[idx]) {
+            rpm[0] = state->rpm[idx];
             ovsrec_fan_set_rpm(db_fan, rpm, 1);
             change = true;
         }
@@ -485,53 +1209,557 @@ fand_read_status(struct ovsdb_idl *idl)
         }
     }
 
+    status = TXN_UNCHANGED;
     if (change) {
-        ovsdb_idl_txn_commit_block(txn);
+        FAND_SPAN_BEGIN(span);
+        status = ovsdb_idl_txn_commit_block(txn);
+        FAND_SPAN_END(span, "commit", NULL, -1);
+        n_txns++;
     }
 
-    ovsdb_idl_txn_destroy(txn);
-}
+    /* on failure, the fans stay dirty and are retried next time */
+    if (status == TXN_SUCCESS || status == TXN_UNCHANGED) {
+        fand_clear_dirty();
+    }
 
-static void
-fand_run__(void)
-{
-    fand_read_status(idl);
+    ovsdb_idl_txn_destroy(txn);
 }
 
+/* write the power and energy of each fan with a power model to its
+   other_config. this runs once a minute, outside of the poll path, in its
+   own transaction. */
 static void
-fand_reconfigure(struct ovsdb_idl *idl)
+fand_publish_power(struct ovsdb_idl *idl, long long int now)
 {
-    const struct ovsrec_subsystem *cfg;
-    unsigned int new_idl_seqno = ovsdb_idl_get_seqno(idl);
-
-    COVERAGE_INC(fand_reconfigure);
+    const struct ovsrec_fan *db_fan;
+    struct ovsdb_idl_txn *txn;
+    bool change = false;
 
-    if (new_idl_seqno == idl_seqno){
+    if (now < next_power_publish) {
         return;
     }
+    next_power_publish = now + FAND_POWER_PUBLISH_MSEC;
 
-    idl_seqno = new_idl_seqno;
-
-    fand_unmark_subsystems();
-
-    OVSREC_SUBSYSTEM_FOR_EACH(cfg, idl) {
-        const char *override = NULL;
-        enum fanspeed override_value;
-        struct locl_subsystem *subsystem;
-        size_t idx;
-        enum fanspeed highest = FAND_SPEED_SLOW;
-
-        subsystem = get_subsystem(cfg);
+    txn = ovsdb_idl_txn_create(idl);
+    OVSREC_FAN_FOR_EACH(db_fan, idl) {
+        struct locl_fan *fan;
+        struct smap other_config;
+        char value[32];
 
-        /* Skip if this subsystem is to be ignored. */
-        if (subsystem == NULL) {
+        fan = shash_find_data(&fan_data, db_fan->name);
+        if (fan == NULL || fan->subsystem->power == NULL) {
             continue;
         }
 
-        /* find the highest fan_state value in the subsystem */
-        for (idx = 0; idx < cfg->n_temp_sensors; idx++) {
-            struct ovsrec_temp_sensor *sensor = cfg->temp_sensors[idx];
-            enum fanspeed speed = fan_speed_string_to_enum(sensor->fan_state);
+        smap_clone(&other_config, &db_fan->other_config);
+        snprintf(value, sizeof(value), "%.1f",
+                 fand_power_fan_watts(fan->subsystem, fan->idx));
+        smap_replace(&other_config, "power_watts", value);
+        snprintf(value, sizeof(value), "%.0f",
+                 fand_power_fan_joules(fan->subsystem, fan->idx));
+        smap_replace(&other_config, "energy_joules", value);
+        ovsrec_fan_set_other_config(db_fan, &other_config);
+        smap_destroy(&other_config);
+        change = true;
+    }
+
+    if (change) {
+        ovsdb_idl_txn_commit_block(txn);
+        n_txns++;
+    }
+    ovsdb_idl_txn_destroy(txn);
+}
+
+/* schedule the next poll of a subsystem. each subsystem has a fixed phase
+   within the poll interval, derived from its name, so that the subsystems
+   (and the daemons sharing their buses) aren't all read at the same instant,
+   and the phase doesn't drift with the time a poll takes. */
+static void
+fand_schedule_poll(struct locl_subsystem *subsystem, long long int now)
+{
+    long long int interval = FAN_POLL_INTERVAL * MSEC_PER_SEC;
+    long long int phase = hash_string(subsystem->name, 0) % interval;
+    long long int offset = ((now - phase) % interval + interval) % interval;
+
+    subsystem->next_poll_msec = now - offset + interval;
+}
+
+/* read the fans of the subsystems whose poll is due. returns true if any
+   subsystem was polled. */
+static bool
+fand_read_status(long long int now)
+{
+    const struct shash_node *node;
+    unsigned long long int mux_switches;
+    enum fand_poll_result result;
+    long long int deadline;
+    bool polled = false;
+    size_t idx;
+
+    SHASH_FOR_EACH(node, &subsystem_data) {
+        struct locl_subsystem *subsystem = (struct locl_subsystem *)node->data;
+
+        if (!subsystem->valid || now < subsystem->next_poll_msec) {
+            continue;
+        }
+        mux_switches = fand_bus_mux_switches();
+        deadline = LLONG_MAX;
+        if (subsystem->poll_budget_msec > 0) {
+            deadline = time_usec() + subsystem->poll_budget_msec * 1000LL;
+        }
+
+        FAND_SPAN_BEGIN(span);
+        fand_bus_batch_begin();
+        result = fand_sample_fans(subsystem, deadline);
+        if (result == FAND_POLL_BUSY) {
+            /* rather than wait for the bus, come back to it shortly, and
+               go on from the read that found it busy */
+            fand_bus_batch_end();
+            FAND_SPAN_END(span, "poll", subsystem->name, -1);
+            subsystem->next_poll_msec = now + FAND_BUS_RETRY_MSEC;
+            n_poll_retries++;
+            continue;
+        }
+        if (result == FAND_POLL_OVERRUN) {
+            VLOG_DBG("subsystem %s: poll over its %d msec budget",
+                     subsystem->name, subsystem->poll_budget_msec);
+            subsystem->n_overruns++;
+            n_overruns++;
+        }
+        fand_schedule_poll(subsystem, now);
+        n_polls++;
+        polled = true;
+        fand_power_update(subsystem, now);
+        fand_wear_update(subsystem, now);
+        fand_flight_sample(subsystem, now);
+        /* compensate for a fan that just faulted, in this same cycle */
+        fand_check_redundancy(subsystem);
+        for (idx = 0; idx < subsystem->n_fans; idx++) {
+            fand_fan_set_speed(&subsystem->fans[idx], subsystem->speed);
+        }
+        fand_bus_batch_end();
+        FAND_SPAN_END(span, "poll", subsystem->name, -1);
+
+        poll_mux_switches = fand_bus_mux_switches() - mux_switches;
+        max_poll_mux_switches = MAX(max_poll_mux_switches,
+                                    poll_mux_switches);
+    }
+
+    return(polled);
+}
+
+/* re-read the presence of every FRU in the subsystem, and refresh the ones
+   that were inserted or removed. returns true if anything changed. */
+static bool
+fand_handle_hotplug(struct locl_subsystem *subsystem)
+{
+    bool changed = false;
+    size_t idx;
+
+    subsystem->hotplug_pending = false;
+
+    for (idx = 0; idx < subsystem->n_frus; idx++) {
+        bool present = fand_read_fan_fru_present(subsystem, idx);
+
+        if (present == subsystem->fru_present[idx]) {
+            continue;
+        }
+
+        VLOG_INFO("subsystem %s: fan FRU %d %s", subsystem->name,
+                  (int)idx + 1, present ? "inserted" : "removed");
+        log_event("FAN_FRU", EV_KV("subsystem", "%s", subsystem->name),
+            EV_KV("fru", "%d", (int)idx + 1),
+            EV_KV("state", "%s", present ? "inserted" : "removed"));
+
+        subsystem->fru_present[idx] = present;
+        fand_refresh_fan_fru(subsystem, idx);
+        changed = true;
+    }
+
+    return(changed);
+}
+
+/* check whether a FRU presence event fired (or is pending) */
+static bool
+fand_presence_event(struct locl_subsystem *subsystem)
+{
+    bool fired;
+
+    if (fand_replaying()) {
+        return(fand_replay_event(subsystem->name));
+    }
+
+    fired = fand_event_check(subsystem->presence_fd) ||
+            subsystem->hotplug_pending;
+    if (fired) {
+        fand_record_event(subsystem->name);
+    }
+
+    return(fired);
+}
+
+/* handle any pending FRU presence events */
+static bool
+fand_run_hotplug(void)
+{
+    struct shash_node *node;
+    bool changed = false;
+
+    SHASH_FOR_EACH(node, &subsystem_data) {
+        struct locl_subsystem *subsystem = node->data;
+
+        if (!subsystem->valid) {
+            continue;
+        }
+        if (!fand_presence_event(subsystem)) {
+            continue;
+        }
+        fand_bus_batch_begin();
+        if (fand_handle_hotplug(subsystem)) {
+            fand_check_redundancy(subsystem);
+            changed = true;
+        }
+        fand_bus_batch_end();
+    }
+
+    return(changed);
+}
+
+/* read the thermal alert line of a subsystem if it fired (or has to be
+   read anyway). returns the level, or -1 if there's nothing new. */
+static int
+fand_thermal_alert_level(struct locl_subsystem *subsystem)
+{
+    int level = -1;
+    char *key;
+
+    if (fand_replaying()) {
+        for (level = 1; level >= 0; level--) {
+            key = xasprintf("%s/alert/%d", subsystem->name, level);
+            if (fand_replay_event(key)) {
+                free(key);
+                return(level);
+            }
+            free(key);
+        }
+        return(-1);
+    }
+
+    if (fand_event_check(subsystem->thermal_alert_fd) ||
+            subsystem->thermal_alert_pending) {
+        subsystem->thermal_alert_pending = false;
+        if (subsystem->thermal_alert_fd >= 0) {
+            level = fand_event_level(subsystem->thermal_alert_fd);
+        } else if (sim_bus) {
+            level = subsystem->sim_thermal_alert;
+        }
+    }
+
+    if (level >= 0 && fand_recording()) {
+        key = xasprintf("%s/alert/%d", subsystem->name, level);
+        fand_record_event(key);
+        free(key);
+    }
+
+    return(level);
+}
+
+/* the fast path for the hardware thermal alert: drive the fans of the
+   subsystem to max as soon as its line is asserted, without waiting for
+   tempd and the database, and give them back to the sensors when it
+   clears. 'wake_usec' is when the main loop woke up. */
+static bool
+fand_run_thermal_alerts(long long int wake_usec)
+{
+    struct shash_node *node;
+    bool changed = false;
+
+    SHASH_FOR_EACH(node, &subsystem_data) {
+        struct locl_subsystem *subsystem = node->data;
+        long long int latency;
+        int level;
+
+        if (!subsystem->valid ||
+                (subsystem->thermal_alert_gpio == NULL && !sim_bus)) {
+            continue;
+        }
+        level = fand_thermal_alert_level(subsystem);
+        if (level < 0 || level == subsystem->thermal_alert) {
+            continue;
+        }
+
+        subsystem->thermal_alert = level;
+        fand_bus_batch_begin();
+        fand_set_fanspeed(subsystem);
+        fand_bus_batch_end();
+        changed = true;
+
+        if (!subsystem->thermal_alert) {
+            VLOG_INFO("subsystem %s: thermal alert cleared", subsystem->name);
+            log_event("FAN_THERMAL_ALERT",
+                EV_KV("subsystem", "%s", subsystem->name),
+                EV_KV("state", "%s", "cleared"));
+            continue;
+        }
+
+        latency = fand_replaying() ? 0 : time_usec() - wake_usec;
+        subsystem->n_thermal_alerts++;
+        subsystem->thermal_alert_usec = latency;
+        subsystem->max_thermal_alert_usec =
+                MAX(subsystem->max_thermal_alert_usec, latency);
+        VLOG_WARN("subsystem %s: thermal alert, fans at max in %lld usec",
+                  subsystem->name, latency);
+        log_event("FAN_THERMAL_ALERT",
+            EV_KV("subsystem", "%s", subsystem->name),
+            EV_KV("state", "%s", "asserted"),
+            EV_KV("latency_usec", "%lld", latency));
+    }
+
+    return(changed);
+}
+
+/* let the speed governors take their next (down or slew) step */
+static bool
+fand_run_governors(long long int now)
+{
+    struct shash_node *node;
+    bool changed = false;
+
+    SHASH_FOR_EACH(node, &subsystem_data) {
+        struct locl_subsystem *subsystem = node->data;
+
+        if (!subsystem->valid ||
+                now < fan_governor_next_msec(&subsystem->governor_state,
+                                             &subsystem->governor)) {
+            continue;
+        }
+        fand_set_fanspeed(subsystem);
+        changed = true;
+    }
+
+    return(changed);
+}
+
+/* the poll and control path. in the steady state (nothing to publish, no
+   event, no recording) it doesn't allocate any memory. */
+static void
+fand_run__(void)
+{
+    unsigned long long int allocs = fand_alloc_count();
+    long long int now = fand_now();
+    bool changed;
+
+    FAND_SPAN_BEGIN(governors);
+    changed = fand_run_governors(now);
+    FAND_SPAN_END(governors, "governors", NULL, -1);
+    changed |= fand_read_status(now);
+    FAND_SPAN_BEGIN(hotplug);
+    changed |= fand_run_hotplug();
+    FAND_SPAN_END(hotplug, "hotplug", NULL, -1);
+    if (changed) {
+        fand_publish_status(idl);
+    }
+
+    n_run_allocs += fand_alloc_count() - allocs;
+}
+
+/* true if a subsystem feeds the interface load forward */
+static bool
+fand_load_enabled(void)
+{
+    struct shash_node *node;
+
+    SHASH_FOR_EACH(node, &subsystem_data) {
+        struct locl_subsystem *subsystem = node->data;
+
+        if (subsystem->valid && subsystem->load.gain > 0) {
+            return(true);
+        }
+    }
+    return(false);
+}
+
+/* connect to the interface statistics while a subsystem has a load gain,
+   and drop the connection when none has. interface counters change all the
+   time: rather than replicate them for nothing, and be woken up by every
+   update, the connection is only run when a sample is taken. */
+static void
+fand_load_connect(bool enabled)
+{
+    if (enabled && load_idl == NULL && !fand_replaying()) {
+        load_idl = ovsdb_idl_create(db_remote, &ovsrec_idl_class, false,
+                                    true);
+        ovsdb_idl_add_table(load_idl, &ovsrec_table_interface);
+        ovsdb_idl_add_column(load_idl, &ovsrec_interface_col_statistics);
+        ovsdb_idl_add_column(load_idl, &ovsrec_interface_col_link_speed);
+        /* stats-update-interval */
+        ovsdb_idl_add_table(load_idl, &ovsrec_table_system);
+        ovsdb_idl_add_column(load_idl, &ovsrec_system_col_other_config);
+    } else if (!enabled && load_idl != NULL) {
+        ovsdb_idl_destroy(load_idl);
+        load_idl = NULL;
+    }
+}
+
+/* add up the byte counters and link speeds of all interfaces, and get the
+   interval at which they are refreshed. returns false until the
+   interfaces have been received. */
+static bool
+fand_load_read(uint64_t *bytes, uint64_t *capacity_bps, uint32_t *stats_msec)
+{
+    const struct ovsrec_interface *intf;
+    const struct ovsrec_system *system;
+    size_t idx;
+
+    ovsdb_idl_run(load_idl);
+    if (ovsdb_idl_get_seqno(load_idl) == 0) {
+        return(false);
+    }
+
+    system = ovsrec_system_first(load_idl);
+    *stats_msec = FAND_LOAD_STATS_MSEC;
+    if (system != NULL) {
+        *stats_msec = MAX(smap_get_int(&system->other_config,
+                                       "stats-update-interval",
+                                       FAND_LOAD_STATS_MSEC), 1);
+    }
+
+    *bytes = 0;
+    *capacity_bps = 0;
+    OVSREC_INTERFACE_FOR_EACH(intf, load_idl) {
+        for (idx = 0; idx < intf->n_statistics; idx++) {
+            if (intf->value_statistics[idx] > 0 &&
+                    (!strcmp(intf->key_statistics[idx], "rx_bytes") ||
+                     !strcmp(intf->key_statistics[idx], "tx_bytes"))) {
+                *bytes += intf->value_statistics[idx];
+            }
+        }
+        /* full duplex: the link speed each way */
+        if (intf->n_link_speed > 0 && intf->link_speed[0] > 0) {
+            *capacity_bps += 2 * intf->link_speed[0];
+        }
+    }
+
+    return(true);
+}
+
+/* sample the byte counters and link speeds of all interfaces (recorded, or
+   from the trace), and set the speed of each subsystem whose load boost
+   changed. returns true if one did. */
+static bool
+fand_run_load(long long int now)
+{
+    uint64_t bytes, capacity_bps;
+    struct shash_node *node;
+    uint32_t stats_msec;
+    bool changed = false;
+    bool enabled;
+
+    enabled = fand_load_enabled();
+    fand_load_connect(enabled);
+    if (fand_replaying()) {
+        /* take the sample on the tick the recorded run took it */
+        if (!enabled ||
+                !fand_replay_load(&bytes, &capacity_bps, &stats_msec)) {
+            return(false);
+        }
+    } else {
+        if (now < next_load_sample || !enabled) {
+            return(false);
+        }
+        next_load_sample = now + FAND_LOAD_SAMPLE_MSEC;
+        if (!fand_load_read(&bytes, &capacity_bps, &stats_msec)) {
+            return(false);
+        }
+        fand_record_load(bytes, capacity_bps, stats_msec);
+    }
+    fand_load_sample(bytes, capacity_bps, stats_msec, now);
+
+    SHASH_FOR_EACH(node, &subsystem_data) {
+        struct locl_subsystem *subsystem = node->data;
+
+        if (subsystem->valid && fand_load_update(subsystem, now)) {
+            fand_bus_batch_begin();
+            fand_set_fanspeed(subsystem);
+            fand_bus_batch_end();
+            changed = true;
+        }
+    }
+    return(changed);
+}
+
+/* record the configuration of the subsystems handled by this instance */
+static void
+fand_record_inputs(struct ovsdb_idl *idl)
+{
+    const struct ovsrec_subsystem *cfg;
+    const char **fan_states;
+    size_t idx;
+
+    OVSREC_SUBSYSTEM_FOR_EACH(cfg, idl) {
+        if (!fand_owns_subsystem(cfg)) {
+            continue;
+        }
+
+        fan_states = xmalloc(cfg->n_temp_sensors * sizeof(*fan_states));
+        for (idx = 0; idx < cfg->n_temp_sensors; idx++) {
+            fan_states[idx] = cfg->temp_sensors[idx]->fan_state;
+        }
+        fand_record_subsystem(cfg->name, cfg->hw_desc_dir,
+                              &cfg->other_config, fan_states,
+                              cfg->n_temp_sensors);
+        free(fan_states);
+    }
+    fand_record_inputs_end();
+}
+
+static bool
+fand_reconfigure(struct ovsdb_idl *idl)
+{
+    const struct ovsrec_subsystem *cfg;
+    unsigned int new_idl_seqno = ovsdb_idl_get_seqno(idl);
+
+    COVERAGE_INC(fand_reconfigure);
+
+    if (new_idl_seqno == idl_seqno){
+        return(false);
+    }
+
+    idl_seqno = new_idl_seqno;
+
+    if (fand_recording()) {
+        fand_record_inputs(idl);
+    }
+
+    fand_unmark_subsystems();
+
+    OVSREC_SUBSYSTEM_FOR_EACH(cfg, idl) {
+        const char *override = NULL;
+        enum fanspeed override_value;
+        struct locl_subsystem *subsystem;
+        size_t idx;
+        enum fanspeed highest = FAND_SPEED_SLOW;
+
+        /* leave subsystems that belong to another shard alone (if this
+           one used to own it, it is removed below, since it's unmarked) */
+        if (!fand_owns_subsystem(cfg)) {
+            continue;
+        }
+
+        subsystem = get_subsystem(cfg);
+
+        /* "mark" the subsystem, to indicate that it is still present */
+        subsystem->marked = true;
+
+        /* Skip if this subsystem is to be ignored. */
+        if (!subsystem->valid) {
+            continue;
+        }
+
+        /* find the highest fan_state value in the subsystem */
+        for (idx = 0; idx < cfg->n_temp_sensors; idx++) {
+            struct ovsrec_temp_sensor *sensor = cfg->temp_sensors[idx];
+            enum fanspeed speed = fan_speed_string_to_enum(sensor->fan_state);
 
             if (speed > highest) {
                 highest = speed;
@@ -546,36 +1774,78 @@ fand_reconfigure(struct ovsdb_idl *idl)
         if (subsystem->fan_speed_override != override_value) {
             subsystem->fan_speed_override = override_value;
         }
+        fand_read_subsystem_config(subsystem, &cfg->other_config);
 
-        fand_set_fanspeed(subsystem);
-        fand_set_fanleds(subsystem);
-
-        /* "mark" the subsystem, to indicate that it is still present */
-        subsystem->marked = true;
+        if (active) {
+            fand_bus_batch_begin();
+            fand_set_fanspeed(subsystem);
+            fand_set_fanleds(subsystem);
+            fand_bus_batch_end();
+        }
     }
 
     /* delete all subsystems that aren't actually present in the DB */
     fand_remove_unmarked_subsystems();
+
+    return(true);
 }
 
 static void
 fand_run(void)
 {
+    long long int wake_usec = time_usec();
+    bool changed = false;
+
+    /* the thermal alert goes first, it's the fast path: it must not wait
+       behind a backlog of database updates. the fans are ours to drive
+       only if we held the lock as of the last run */
+    if (active) {
+        FAND_SPAN_BEGIN(alerts);
+        changed = fand_run_thermal_alerts(wake_usec);
+        FAND_SPAN_END(alerts, "thermal_alerts", NULL, -1);
+    }
+
+    FAND_SPAN_BEGIN(idl_run);
     ovsdb_idl_run(idl);
+    FAND_SPAN_END(idl_run, "idl_run", NULL, -1);
 
-    if (ovsdb_idl_is_lock_contended(idl)) {
+    if (!ovsdb_idl_has_lock(idl)) {
         static struct vlog_rate_limit rl = VLOG_RATE_LIMIT_INIT(1, 1);
 
-        VLOG_ERR_RL(&rl, "another ops-fand process is running, "
-                    "disabling this process until it goes away");
-
-        return;
-    } else if (!ovsdb_idl_has_lock(idl)) {
+        if (active) {
+            VLOG_WARN("lost the ops-fand lock, no longer in control");
+            active = false;
+        }
+        if (ovsdb_idl_is_lock_contended(idl) && !standby) {
+            VLOG_ERR_RL(&rl, "another ops-fand process is running, "
+                        "disabling this process until it goes away");
+        } else if (standby) {
+            /* keep the topology loaded and the fan state current */
+            fand_reconfigure(idl);
+            fand_follow_status();
+            daemonize_complete();
+        }
         return;
     }
 
-    fand_reconfigure(idl);
+    fand_clock_tick();
+
+    if (!active) {
+        fand_takeover();
+    }
+
+    FAND_SPAN_BEGIN(reconfigure);
+    changed |= fand_reconfigure(idl);
+    FAND_SPAN_END(reconfigure, "reconfigure", NULL, -1);
+    changed |= fand_run_load(fand_now());
+    if (changed) {
+        /* publish the new speeds without waiting for the next poll */
+        fand_publish_status(idl);
+    }
     fand_run__();
+    fand_publish_power(idl, fand_now());
+    fand_wear_run(fand_now());
+    fand_flight_run(fand_now());
 
     daemonize_complete();
     vlog_enable_async();
@@ -585,8 +1855,154 @@ fand_run(void)
 static void
 fand_wait(void)
 {
+    struct shash_node *node;
+
     ovsdb_idl_wait(idl);
-    poll_timer_wait(FAN_POLL_INTERVAL * MSEC_PER_SEC);
+    if (!active) {
+        return;
+    }
+
+    if (fand_load_enabled()) {
+        poll_timer_wait_until(next_load_sample);
+    }
+
+    SHASH_FOR_EACH(node, &subsystem_data) {
+        struct locl_subsystem *subsystem = node->data;
+
+        if (!subsystem->valid) {
+            continue;
+        }
+        poll_timer_wait_until(subsystem->next_poll_msec);
+        fand_event_wait(subsystem->presence_fd);
+        fand_event_wait(subsystem->thermal_alert_fd);
+        if (subsystem->thermal_alert_pending) {
+            poll_immediate_wake();
+        }
+        poll_timer_wait_until(
+            fan_governor_next_msec(&subsystem->governor_state,
+                                   &subsystem->governor));
+        if (subsystem->hotplug_pending) {
+            poll_immediate_wake();
+        }
+    }
+}
+
+/* bring the Subsystem rows (and their temperature sensors) of the replay
+   database in line with the recorded configuration */
+static void
+fand_replay_apply_inputs(void)
+{
+    const struct ovsrec_subsystem *row, *next;
+    struct ovsrec_temp_sensor **sensors;
+    struct ovsdb_idl_txn *txn;
+    enum ovsdb_idl_txn_status status;
+    size_t idx, sensor_idx;
+
+    txn = ovsdb_idl_txn_create(idl);
+
+    OVSREC_SUBSYSTEM_FOR_EACH_SAFE(row, next, idl) {
+        for (idx = 0; idx < fand_replay_n_subsystems(); idx++) {
+            if (strcmp(fand_replay_subsystem(idx)->name, row->name) == 0) {
+                break;
+            }
+        }
+        if (idx == fand_replay_n_subsystems()) {
+            ovsrec_subsystem_delete(row);
+        }
+    }
+
+    for (idx = 0; idx < fand_replay_n_subsystems(); idx++) {
+        const struct fand_replay_subsystem *rec = fand_replay_subsystem(idx);
+
+        OVSREC_SUBSYSTEM_FOR_EACH(row, idl) {
+            if (strcmp(row->name, rec->name) == 0) {
+                break;
+            }
+        }
+        if (row == NULL) {
+            row = ovsrec_subsystem_insert(txn);
+            ovsrec_subsystem_set_name(row, rec->name);
+        }
+        ovsrec_subsystem_set_hw_desc_dir(row, rec->hw_desc_dir);
+        ovsrec_subsystem_set_other_config(row, &rec->other_config);
+
+        sensors = xcalloc(rec->fan_states.n, sizeof(*sensors));
+        for (sensor_idx = 0; sensor_idx < rec->fan_states.n; sensor_idx++) {
+            if (sensor_idx < row->n_temp_sensors) {
+                sensors[sensor_idx] = row->temp_sensors[sensor_idx];
+            } else {
+                char *name = xasprintf("%s-replay-%zu", rec->name,
+                                       sensor_idx);
+
+                sensors[sensor_idx] = ovsrec_temp_sensor_insert(txn);
+                ovsrec_temp_sensor_set_name(sensors[sensor_idx], name);
+                free(name);
+            }
+            ovsrec_temp_sensor_set_fan_state(sensors[sensor_idx],
+                                    rec->fan_states.names[sensor_idx]);
+        }
+        ovsrec_subsystem_set_temp_sensors(row, sensors, rec->fan_states.n);
+        free(sensors);
+    }
+
+    status = ovsdb_idl_txn_commit_block(txn);
+    if (status != TXN_SUCCESS && status != TXN_UNCHANGED) {
+        VLOG_WARN("unable to apply the recorded configuration");
+    }
+    ovsdb_idl_txn_destroy(txn);
+}
+
+/* drive the control code from a recorded trace, as fast as it goes.
+   the recorded configuration is written to the database given on the
+   command line, which should be a scratch one. */
+static int
+fand_replay(void)
+{
+    struct ds ds = DS_EMPTY_INITIALIZER;
+    bool diverged;
+    bool changed;
+
+    while (!ovsdb_idl_has_lock(idl)) {
+        ovsdb_idl_run(idl);
+        if (ovsdb_idl_is_lock_contended(idl)) {
+            VLOG_ERR("another ops-fand process is using the database");
+            return(EXIT_FAILURE);
+        }
+        ovsdb_idl_wait(idl);
+        poll_block();
+    }
+
+    while (fand_replay_next_tick()) {
+        ovsdb_idl_run(idl);
+
+        /* reconfigure exactly when the recorded run did */
+        if (fand_replay_has_inputs()) {
+            fand_replay_apply_inputs();
+            idl_seqno = ovsdb_idl_get_seqno(idl) - 1;
+        } else {
+            idl_seqno = ovsdb_idl_get_seqno(idl);
+        }
+
+        if (!active) {
+            fand_takeover();
+        }
+        changed = fand_run_thermal_alerts(0);
+        changed |= fand_reconfigure(idl);
+        changed |= fand_run_load(fand_now());
+        if (changed) {
+            fand_publish_status(idl);
+        }
+        fand_run__();
+    }
+
+    fand_replay_report(&ds);
+    fputs(ds_cstr(&ds), stdout);
+    ds_destroy(&ds);
+
+    diverged = fand_replay_diverged();
+    fand_replay_close();
+
+    return(diverged ? EXIT_FAILURE : EXIT_SUCCESS);
 }
 
 static void
@@ -596,8 +2012,28 @@ fand_unixctl_dump(struct unixctl_conn *conn, int argc OVS_UNUSED,
     const struct locl_subsystem *subsystem = NULL;
     const struct locl_fan *fan = NULL;
     const struct shash_node *node = NULL;
-    const struct shash_node *fan_node = NULL;
     struct ds ds = DS_EMPTY_INITIALIZER;
+    size_t idx;
+
+    if (shard_name != NULL) {
+        ds_put_format(&ds, "Shard: %s\n", shard_name);
+    }
+    if (standby) {
+        ds_put_format(&ds, "Role: %s\n", active ? "active" : "standby");
+    }
+    ds_put_format(&ds, "Polls: %llu (%llu put off for a busy bus)\n",
+                  n_polls, n_poll_retries);
+    ds_put_format(&ds, "Transactions: %llu\n", n_txns);
+    fand_bus_stats(&ds);
+    ds_put_format(&ds, "Mux switches per poll: %u last, %u max\n",
+                  poll_mux_switches, max_poll_mux_switches);
+    ds_put_format(&ds, "Poll overruns: %llu\n", n_overruns);
+    ds_put_cstr(&ds, "Flight recorder: ");
+    fand_flight_format(&ds);
+    ds_put_cstr(&ds, "\n");
+#ifdef FAND_ALLOC_STATS
+    ds_put_format(&ds, "Poll path allocations: %llu\n", n_run_allocs);
+#endif
 
     SHASH_FOR_EACH(node, &subsystem_data) {
 
@@ -611,22 +2047,100 @@ fand_unixctl_dump(struct unixctl_conn *conn, int argc OVS_UNUSED,
         ds_put_format(&ds, "    Fan speed: %s\n",
                       fan_speed_enum_to_string(subsystem->fan_speed));
 
+        if (subsystem->thermal_alert_gpio != NULL || sim_bus) {
+            ds_put_format(&ds, "    Thermal alert: %s (%llu alerts, "
+                          "last %lld usec, max %lld usec to max speed)\n",
+                          subsystem->thermal_alert ? "asserted" : "clear",
+                          subsystem->n_thermal_alerts,
+                          subsystem->thermal_alert_usec,
+                          subsystem->max_thermal_alert_usec);
+        }
+        if (subsystem->hwmon != NULL) {
+            ds_put_format(&ds, "    Fan backend: hwmon %s\n",
+                          subsystem->hwmon_dir);
+        }
+        if (subsystem->plugin != NULL) {
+            /* the hooks it leaves out go to the registers */
+            ds_put_format(&ds, "    Fan plugin: %s (hooks:",
+                          subsystem->plugin_device + strlen("plugin:"));
+            if (FAND_PLUGIN_HAS(subsystem, sample)) {
+                ds_put_cstr(&ds, " sample");
+            }
+            if (FAND_PLUGIN_HAS(subsystem, set_speed)) {
+                ds_put_cstr(&ds, " set_speed");
+            }
+            if (FAND_PLUGIN_HAS(subsystem, set_leds)) {
+                ds_put_cstr(&ds, " set_leds");
+            }
+            ds_put_cstr(&ds, ")\n");
+        }
+        if (subsystem->mmio != NULL) {
+            ds_put_cstr(&ds, "    Mapped registers: ");
+            fand_mmio_format(subsystem->mmio, &ds);
+            ds_put_cstr(&ds, "\n");
+        }
+        if (subsystem->wear != NULL && subsystem->n_frus > 0) {
+            ds_put_cstr(&ds, "    Fan wear:\n");
+            fand_wear_format(subsystem, &ds);
+        }
+        if (subsystem->power != NULL) {
+            ds_put_cstr(&ds, "    Fan power: ");
+            fand_power_format(subsystem, false, &ds);
+            ds_put_cstr(&ds, "\n");
+        }
+        if (subsystem->governor.down_dwell_msec > 0 ||
+                subsystem->governor.slew > 0) {
+            ds_put_format(&ds, "    Speed governor: %s, register %d "
+                          "(target %d)\n",
+                          fan_speed_enum_to_string(
+                              subsystem->governor_state.level),
+                          subsystem->governor_state.hw_value,
+                          subsystem->governor_state.hw_target);
+        }
+        ds_put_format(&ds, "    Poll plan: %zu reads on %zu mux paths\n",
+                      subsystem->samples.n_plan,
+                      subsystem->samples.n_mux_paths);
+        if (subsystem->poll_budget_msec > 0) {
+            ds_put_format(&ds, "    Poll budget: %d msec (%llu overruns)\n",
+                          subsystem->poll_budget_msec, subsystem->n_overruns);
+        }
+        if (subsystem->load.gain > 0) {
+            ds_put_cstr(&ds, "    Load feed-forward: ");
+            fand_load_format(subsystem, &ds);
+            ds_put_cstr(&ds, "\n");
+        }
+        if (subsystem->redundancy_step > 0) {
+            ds_put_format(&ds, "    Redundancy step: %d (%s)\n",
+                          subsystem->redundancy_step,
+                          subsystem->degraded ? "degraded" : "not degraded");
+        }
+
+        ds_put_format(&ds, "    Memory: %zu bytes\n",
+                      subsystem->arena->total);
+
+        ds_put_format(&ds, "    RPM filter: %s\n",
+                      fan_rpm_filter_enum_to_string(
+                          subsystem->rpm_filter.type));
+
         ds_put_cstr(&ds, "    Fan details:");
 
-        if (shash_is_empty(&subsystem->subsystem_fans)) {
+        if (subsystem->n_fans == 0) {
             ds_put_cstr(&ds, "No Fans found.\n");
             continue;
         }
         ds_put_cstr(&ds, "\n");
 
-        SHASH_FOR_EACH(fan_node, &subsystem->subsystem_fans) {
-            fan = (struct locl_fan *)fan_node->data;
+        for (idx = 0; idx < subsystem->n_fans; idx++) {
+            fan = &subsystem->fans[idx];
             ds_put_format(&ds, "        Name: %s\n", fan->name);
-            ds_put_format(&ds, "            rpm: %d\n", fan->rpm);
+            ds_put_format(&ds, "            rpm: %d\n",
+                          subsystem->fan_state.rpm[idx]);
             ds_put_format(&ds, "            direction: %s\n",
-                          fan->direction);
+                          fan_direction_enum_to_string(
+                              subsystem->fan_state.direction[idx]));
             ds_put_format(&ds, "            status: %s\n",
-                          fan_status_enum_to_string(fan->status));
+                          fan_status_enum_to_string(
+                              subsystem->fan_state.status[idx]));
         }
     }
 
@@ -635,6 +2149,230 @@ fand_unixctl_dump(struct unixctl_conn *conn, int argc OVS_UNUSED,
     ds_destroy(&ds);
 }
 
+/* the estimated fan power and energy of one subsystem, or of all of them,
+   with the totals per FRU and the fans of each FRU */
+static void
+fand_unixctl_power(struct unixctl_conn *conn, int argc,
+                   const char *argv[], void *aux OVS_UNUSED)
+{
+    const struct locl_subsystem *subsystem;
+    const struct shash_node *node;
+    struct ds ds = DS_EMPTY_INITIALIZER;
+
+    SHASH_FOR_EACH(node, &subsystem_data) {
+        subsystem = node->data;
+        if (!subsystem->valid ||
+                (argc > 1 && strcmp(subsystem->name, argv[1]) != 0)) {
+            continue;
+        }
+        ds_put_format(&ds, "Subsystem %s: ", subsystem->name);
+        fand_power_format(subsystem, true, &ds);
+        if (subsystem->power == NULL) {
+            ds_put_cstr(&ds, "\n");
+        }
+    }
+
+    if (argc > 1 && ds.length == 0) {
+        unixctl_command_reply_error(conn, "no such subsystem");
+    } else {
+        unixctl_command_reply(conn, ds_cstr(&ds));
+    }
+    ds_destroy(&ds);
+}
+
+/* decode the flight recorder, to a file or in the reply */
+static void
+fand_unixctl_flight_export(struct unixctl_conn *conn, int argc,
+                           const char *argv[], void *aux OVS_UNUSED)
+{
+    struct ds ds = DS_EMPTY_INITIALIZER;
+    FILE *file;
+
+    fand_flight_export(&ds);
+
+    if (argc < 2) {
+        unixctl_command_reply(conn, ds_cstr(&ds));
+    } else if ((file = fopen(argv[1], "w")) == NULL ||
+               fputs(ds_cstr(&ds), file) == EOF || fclose(file) != 0) {
+        char *error = xasprintf("%s: %s", argv[1], ovs_strerror(errno));
+
+        unixctl_command_reply_error(conn, error);
+        free(error);
+    } else {
+        unixctl_command_reply(conn, NULL);
+    }
+
+    ds_destroy(&ds);
+}
+
+/* simulate the insertion or removal of a fan FRU: change its presence
+   register on the simulated bus and raise a presence event */
+static void
+fand_unixctl_sim_fru_present(struct unixctl_conn *conn, int argc,
+                             const char *argv[], void *aux OVS_UNUSED)
+{
+    struct locl_subsystem *subsystem;
+    const YamlFanFru *fru = NULL;
+    bool present;
+    int number;
+    size_t idx;
+
+    subsystem = shash_find_data(&subsystem_data, argv[1]);
+    if (subsystem == NULL || !subsystem->valid) {
+        unixctl_command_reply_error(conn, "no such subsystem");
+        return;
+    }
+
+    number = atoi(argv[2]);
+    for (idx = 0; idx < subsystem->n_frus; idx++) {
+        fru = yaml_get_fan_fru(subsystem->yaml_handle, subsystem->name, idx);
+        if (fru->number == number) {
+            break;
+        }
+    }
+    if (idx == subsystem->n_frus) {
+        unixctl_command_reply_error(conn, "no such fan FRU");
+        return;
+    }
+    if (fru->fan_present == NULL) {
+        unixctl_command_reply_error(conn, "fan FRU has no presence detect");
+        return;
+    }
+
+    if (strcmp(argv[3], "present") == 0) {
+        present = true;
+    } else if (strcmp(argv[3], "absent") == 0) {
+        present = false;
+    } else {
+        unixctl_command_reply_error(conn, "expected present or absent");
+        return;
+    }
+
+    /* straight into the register file: a trace holds what the control
+       code read and wrote, not what the simulation did */
+    fansim_reg_write(subsystem->name, fru->fan_present,
+                     present ? fru->fan_present->bit_mask : 0);
+    /* without the event, the FRU is only seen by the next poll */
+    if (argc < 5 || strcmp(argv[4], "no-event") != 0) {
+        subsystem->hotplug_pending = true;
+        poll_immediate_wake();
+    }
+
+    unixctl_command_reply(conn, NULL);
+}
+
+/* set the tach and fault registers of a fan, so that it reads as running
+   at the given rpm, and faulted or not, and optionally make the next reads
+   of its tach fail */
+static void
+fand_unixctl_sim_fan(struct unixctl_conn *conn, int argc,
+                     const char *argv[], void *aux OVS_UNUSED)
+{
+    struct locl_subsystem *subsystem;
+    const YamlFan *fan = NULL;
+    int failed_reads = 0;
+    uint32_t tach;
+    bool fault;
+    int rpm;
+    size_t idx;
+
+    subsystem = shash_find_data(&subsystem_data, argv[1]);
+    if (subsystem == NULL || !subsystem->valid) {
+        unixctl_command_reply_error(conn, "no such subsystem");
+        return;
+    }
+
+    for (idx = 0; idx < subsystem->n_fans; idx++) {
+        if (strcmp(subsystem->fans[idx].name, argv[2]) == 0) {
+            fan = subsystem->fans[idx].yaml_fan;
+            break;
+        }
+    }
+    if (fan == NULL) {
+        unixctl_command_reply_error(conn, "no such fan");
+        return;
+    }
+
+    if (!str_to_int(argv[3], 10, &rpm) || rpm < 0) {
+        unixctl_command_reply_error(conn, "invalid rpm");
+        return;
+    }
+    if (strcmp(argv[4], "fault") == 0) {
+        fault = true;
+    } else if (strcmp(argv[4], "ok") == 0) {
+        fault = false;
+    } else {
+        unixctl_command_reply_error(conn, "expected ok or fault");
+        return;
+    }
+    if (argc > 5 && (!str_to_int(argv[5], 10, &failed_reads) ||
+                     failed_reads < 0)) {
+        unixctl_command_reply_error(conn, "invalid failed-reads");
+        return;
+    }
+    tach = fand_rpm_to_tach(subsystem, rpm);
+    if (fan->fan_speed_msb != NULL) {
+        fansim_reg_write(subsystem->name, fan->fan_speed, tach & 0xff);
+        fansim_reg_write(subsystem->name, fan->fan_speed_msb, tach >> 8);
+    } else {
+        fansim_reg_write(subsystem->name, fan->fan_speed, tach);
+    }
+    if (fan->fan_fault != NULL) {
+        fansim_reg_write(subsystem->name, fan->fan_fault,
+                         fault ? fan->fan_fault->bit_mask : 0);
+    }
+    fansim_fail_reads(subsystem->name, fan->fan_speed, failed_reads);
+
+    unixctl_command_reply(conn, NULL);
+}
+
+static void
+fand_unixctl_sim_thermal_alert(struct unixctl_conn *conn,
+                               int argc OVS_UNUSED, const char *argv[],
+                               void *aux OVS_UNUSED)
+{
+    struct locl_subsystem *subsystem;
+
+    subsystem = shash_find_data(&subsystem_data, argv[1]);
+    if (subsystem == NULL || !subsystem->valid) {
+        unixctl_command_reply_error(conn, "no such subsystem");
+        return;
+    }
+
+    if (strcmp(argv[2], "asserted") == 0) {
+        subsystem->sim_thermal_alert = 1;
+    } else if (strcmp(argv[2], "clear") == 0) {
+        subsystem->sim_thermal_alert = 0;
+    } else {
+        unixctl_command_reply_error(conn, "expected asserted or clear");
+        return;
+    }
+    subsystem->thermal_alert_pending = true;
+    poll_immediate_wake();
+
+    unixctl_command_reply(conn, NULL);
+}
+
+#ifdef FAND_TRACE
+/* dump the spans of the last 'seconds' (default: all of the ring) as
+   Chrome trace-event JSON, for chrome://tracing or Perfetto */
+static void
+fand_unixctl_trace(struct unixctl_conn *conn, int argc, const char *argv[],
+                   void *aux OVS_UNUSED)
+{
+    struct ds ds = DS_EMPTY_INITIALIZER;
+    int seconds = 0;
+
+    if (argc > 1 && (!str_to_int(argv[1], 10, &seconds) || seconds < 0)) {
+        unixctl_command_reply_error(conn, "expected a number of seconds");
+        return;
+    }
+
+    fand_trace_dump(&ds, seconds);
+    unixctl_command_reply(conn, ds_cstr(&ds));
+    ds_destroy(&ds);
+}
+#endif
 
 static unixctl_cb_func ops_fand_exit;
 
@@ -669,6 +2407,42 @@ main(int argc, char *argv[])
     fand_init(remote);
     free(remote);
 
+    if (record_path != NULL && !fand_record_open(record_path)) {
+        exit(EXIT_FAILURE);
+    }
+
+    if (replay_path != NULL) {
+        if (!fand_replay_open(replay_path)) {
+            exit(EXIT_FAILURE);
+        }
+        retval = fand_replay();
+        fand_exit();
+        unixctl_server_destroy(unixctl);
+        return retval;
+    }
+
+    /* each shard has its own wear log and flight recorder */
+    if (wear_log_path == NULL) {
+        char *path = shard_name
+            ? xasprintf("%s/ops-fand-%s-wear.log", ovs_dbdir(), shard_name)
+            : xasprintf("%s/ops-fand-wear.log", ovs_dbdir());
+
+        fand_wear_set_log(path);
+        free(path);
+    } else if (wear_log_path[0] != '\0') {
+        fand_wear_set_log(wear_log_path);
+    }
+    if (flight_path == NULL) {
+        char *path = shard_name
+            ? xasprintf("%s/ops-fand-%s-flight", ovs_dbdir(), shard_name)
+            : xasprintf("%s/ops-fand-flight", ovs_dbdir());
+
+        fand_flight_set_file(path);
+        free(path);
+    } else if (flight_path[0] != '\0') {
+        fand_flight_set_file(flight_path);
+    }
+
     exiting = false;
     while (!exiting) {
         fand_run();
@@ -679,7 +2453,9 @@ main(int argc, char *argv[])
         if (exiting) {
             poll_immediate_wake();
         }
+        FAND_SPAN_BEGIN(span);
         poll_block();
+        FAND_SPAN_END(span, "poll_block", NULL, -1);
     }
     fand_exit();
     unixctl_server_destroy(unixctl);
@@ -699,11 +2475,29 @@ parse_options(int argc, char *argv[], char **unixctl_pathp)
         OPT_DISABLE_SYSTEM,
         DAEMON_OPTION_ENUMS,
         OPT_DPDK,
+        OPT_SIM_BUS,
+        OPT_SHARD,
+        OPT_SUBSYSTEMS,
+        OPT_STANDBY,
+        OPT_RECORD,
+        OPT_REPLAY,
+        OPT_BUS_LOCK_DIR,
+        OPT_WEAR_LOG,
+        OPT_FLIGHT_RECORDER,
     };
     static const struct option long_options[] = {
         {"help",        no_argument, NULL, 'h'},
         {"version",     no_argument, NULL, 'V'},
         {"unixctl",     required_argument, NULL, OPT_UNIXCTL},
+        {"sim-bus",     no_argument, NULL, OPT_SIM_BUS},
+        {"shard",       required_argument, NULL, OPT_SHARD},
+        {"subsystems",  required_argument, NULL, OPT_SUBSYSTEMS},
+        {"standby",     no_argument, NULL, OPT_STANDBY},
+        {"record",      required_argument, NULL, OPT_RECORD},
+        {"replay",      required_argument, NULL, OPT_REPLAY},
+        {"bus-lock-dir", required_argument, NULL, OPT_BUS_LOCK_DIR},
+        {"wear-log",    required_argument, NULL, OPT_WEAR_LOG},
+        {"flight-recorder", required_argument, NULL, OPT_FLIGHT_RECORDER},
         DAEMON_LONG_OPTIONS,
         VLOG_LONG_OPTIONS,
         STREAM_SSL_LONG_OPTIONS,
@@ -712,6 +2506,7 @@ parse_options(int argc, char *argv[], char **unixctl_pathp)
         {NULL, 0, NULL, 0},
     };
     char *short_options = long_options_to_short_options(long_options);
+    bool bus_lock_dir = false;
 
     for (;;) {
         int c;
@@ -733,6 +2528,52 @@ parse_options(int argc, char *argv[], char **unixctl_pathp)
             *unixctl_pathp = optarg;
             break;
 
+        case OPT_SIM_BUS:
+            sim_bus = true;
+            break;
+
+        case OPT_SHARD:
+            shard_name = optarg;
+            break;
+
+        case OPT_SUBSYSTEMS: {
+            char *patterns = xstrdup(optarg);
+            char *save_ptr = NULL;
+            char *pattern;
+
+            for (pattern = strtok_r(patterns, ",", &save_ptr); pattern;
+                    pattern = strtok_r(NULL, ",", &save_ptr)) {
+                svec_add(&shard_patterns, pattern);
+            }
+            free(patterns);
+            break;
+        }
+
+        case OPT_STANDBY:
+            standby = true;
+            break;
+
+        case OPT_RECORD:
+            record_path = optarg;
+            break;
+
+        case OPT_REPLAY:
+            replay_path = optarg;
+            break;
+
+        case OPT_BUS_LOCK_DIR:
+            fand_bus_set_lock_dir(optarg[0] ? optarg : NULL);
+            bus_lock_dir = true;
+            break;
+
+        case OPT_WEAR_LOG:
+            wear_log_path = optarg;
+            break;
+
+        case OPT_FLIGHT_RECORDER:
+            flight_path = optarg;
+            break;
+
         VLOG_OPTION_HANDLERS
         DAEMON_OPTION_HANDLERS
         STREAM_SSL_OPTION_HANDLERS
@@ -754,6 +2595,12 @@ parse_options(int argc, char *argv[], char **unixctl_pathp)
     }
     free(short_options);
 
+    /* the simulated bus only arbitrates with the lock files it is given,
+       not with the daemons on the real buses */
+    if (!bus_lock_dir && !sim_bus) {
+        fand_bus_set_lock_dir(ovs_rundir());
+    }
+
     argc -= optind;
     argv += optind;
 
@@ -783,8 +2630,28 @@ usage(void)
     vlog_usage();
     printf("\nOther options:\n"
            "  --unixctl=SOCKET        override default control socket name\n"
+           "  --sim-bus               use a simulated fan bus instead of i2c\n"
+           "  --shard=NAME            handle only subsystems of this shard,\n"
+           "                          using the OVSDB lock ops_fand_NAME\n"
+           "  --subsystems=PATTERN,.. handle untagged subsystems whose name\n"
+           "                          matches one of the (glob) patterns\n"
+           "  --standby               stay loaded and follow the fan state\n"
+           "                          while another instance has the lock\n"
+           "  --record=FILE           record the hardware and database inputs\n"
+           "  --replay=FILE           run on the inputs recorded in FILE,\n"
+           "                          against a scratch DATABASE, and exit\n"
+           "  --bus-lock-dir=DIR      take the i2c bus locks shared with the\n"
+           "                          other daemons in DIR (default: %s;\n"
+           "                          empty: don't arbitrate)\n"
+           "  --wear-log=FILE         persist the fan wear counters in FILE\n"
+           "                          (default: %s/ops-fand[-SHARD]-wear.log;\n"
+           "                          empty: don't persist them)\n"
+           "  --flight-recorder=FILE  keep the recent fan history in FILE\n"
+           "                          (default: %s/ops-fand[-SHARD]-flight;\n"
+           "                          empty: no flight recorder)\n"
            "  -h, --help              display this help message\n"
-           "  -V, --version           display version information\n");
+           "  -V, --version           display version information\n",
+           ovs_rundir(), ovs_dbdir(), ovs_dbdir());
     exit(EXIT_SUCCESS);
 }
 
@@ -0,0 +1,116 @@
+/*
+ *  (c) Copyright 2015 Hewlett Packard Enterprise Development LP
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License. You may obtain
+ *  a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *  License for the specific language governing permissions and limitations
+ *  under the License.
+ */
+
+/************************************************************************//**
+ * @ingroup fand
+ *
+ * @file
+ * Source file for fan event line functions.
+ ***************************************************************************/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "poll-loop.h"
+#include "util.h"
+#include "openvswitch/vlog.h"
+#include "fanevent.h"
+
+VLOG_DEFINE_THIS_MODULE(fanevent);
+
+/* reading the value file acknowledges the pending edge */
+static int
+fand_event_read(int fd)
+{
+    char buf[8];
+    ssize_t len;
+
+    len = pread(fd, buf, sizeof(buf) - 1, 0);
+    if (len <= 0) {
+        return(-1);
+    }
+    buf[len] = '\0';
+
+    return(buf[0] == '1');
+}
+
+int
+fand_event_open(const char *path)
+{
+    int fd;
+
+    fd = open(path, O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+    if (fd < 0) {
+        VLOG_WARN("unable to open event line %s (%s)",
+                  path, ovs_strerror(errno));
+        return(-1);
+    }
+
+    (void)fand_event_read(fd);
+
+    return(fd);
+}
+
+void
+fand_event_close(int fd)
+{
+    if (fd >= 0) {
+        close(fd);
+    }
+}
+
+bool
+fand_event_check(int fd)
+{
+    struct pollfd pfd;
+
+    if (fd < 0) {
+        return(false);
+    }
+
+    pfd.fd = fd;
+    pfd.events = POLLPRI;
+    pfd.revents = 0;
+
+    if (poll(&pfd, 1, 0) <= 0 || !(pfd.revents & (POLLPRI | POLLERR))) {
+        return(false);
+    }
+
+    (void)fand_event_read(fd);
+
+    return(true);
+}
+
+int
+fand_event_level(int fd)
+{
+    if (fd < 0) {
+        return(-1);
+    }
+
+    return(fand_event_read(fd));
+}
+
+void
+fand_event_wait(int fd)
+{
+    if (fd >= 0) {
+        poll_fd_wait(fd, POLLPRI);
+    }
+}
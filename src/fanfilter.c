@@ -0,0 +1,196 @@
+/*
+ *  (c) Copyright 2015 Hewlett Packard Enterprise Development LP
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License. You may obtain
+ *  a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *  License for the specific language governing permissions and limitations
+ *  under the License.
+ */
+
+/************************************************************************//**
+ * @ingroup fand
+ *
+ * @file
+ * Source file for fan rpm filter functions.
+ *
+ * A single tach reading can be garbage (bus glitch, counter caught
+ * mid-update), and it would otherwise be published as-is. The filter
+ * runs on the computed rpm: samples that are too far from the current
+ * filtered value are dropped, unless they keep coming, in which case the
+ * fan really changed speed and the filter restarts from the new value.
+ ***************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "fanfilter.h"
+
+#define FAND_RPM_FILTER_DEFAULT_WINDOW          5
+#define FAND_RPM_FILTER_DEFAULT_ALPHA           50
+#define FAND_RPM_FILTER_DEFAULT_OUTLIER_LIMIT   3
+
+/* the order of these strings must match the fan_rpm_filter_type values */
+static const char *fanfilter_string[] =
+{
+    "none",
+    "median",
+    "ema"
+};
+
+void
+fan_rpm_filter_config_init(struct fan_rpm_filter_config *cfg)
+{
+    cfg->type = FAND_RPM_FILTER_NONE;
+    cfg->window = FAND_RPM_FILTER_DEFAULT_WINDOW;
+    cfg->alpha = FAND_RPM_FILTER_DEFAULT_ALPHA;
+    cfg->outlier_pct = 0;
+    cfg->outlier_limit = FAND_RPM_FILTER_DEFAULT_OUTLIER_LIMIT;
+}
+
+void
+fan_rpm_filter_reset(struct fan_rpm_filter *filter)
+{
+    memset(filter, 0, sizeof(*filter));
+}
+
+static int
+compare_int(const void *a, const void *b)
+{
+    int x = *(const int *)a;
+    int y = *(const int *)b;
+
+    return (x > y) - (x < y);
+}
+
+static int
+fan_rpm_filter_median(const struct fan_rpm_filter *filter)
+{
+    int sorted[FAND_RPM_FILTER_MAX_WINDOW];
+
+    memcpy(sorted, filter->samples, filter->n_samples * sizeof(int));
+    qsort(sorted, filter->n_samples, sizeof(int), compare_int);
+
+    return(sorted[filter->n_samples / 2]);
+}
+
+static bool
+fan_rpm_filter_is_outlier(const struct fan_rpm_filter *filter,
+                          const struct fan_rpm_filter_config *cfg, int rpm)
+{
+    long long delta;
+
+    /* nothing is off a stopped fan: it may be spinning up */
+    if (cfg->outlier_pct <= 0 || filter->n_samples == 0 ||
+            filter->value == 0) {
+        return(false);
+    }
+
+    delta = (long long)rpm - filter->value;
+    if (delta < 0) {
+        delta = -delta;
+    }
+
+    return(delta * 100 > (long long)cfg->outlier_pct * filter->value);
+}
+
+int
+fan_rpm_filter_update(struct fan_rpm_filter *filter,
+                      const struct fan_rpm_filter_config *cfg, int rpm)
+{
+    int window;
+
+    filter->n_read_errors = 0;
+    if (cfg->type == FAND_RPM_FILTER_NONE) {
+        filter->value = rpm;
+        return(rpm);
+    }
+
+    if (fan_rpm_filter_is_outlier(filter, cfg, rpm)) {
+        if (++filter->n_rejected <= cfg->outlier_limit) {
+            return(filter->value);
+        }
+        /* the "outlier" persisted: the fan really changed speed */
+        fan_rpm_filter_reset(filter);
+    }
+    filter->n_rejected = 0;
+
+    switch (cfg->type) {
+    case FAND_RPM_FILTER_MEDIAN:
+        window = cfg->window;
+        if (window < 1) {
+            window = 1;
+        } else if (window > FAND_RPM_FILTER_MAX_WINDOW) {
+            window = FAND_RPM_FILTER_MAX_WINDOW;
+        }
+        if (filter->next >= window) {
+            filter->next = 0;
+        }
+        filter->samples[filter->next] = rpm;
+        filter->next = (filter->next + 1) % window;
+        if (filter->n_samples < window) {
+            filter->n_samples++;
+        }
+        filter->value = fan_rpm_filter_median(filter);
+        break;
+    case FAND_RPM_FILTER_EMA:
+    default:
+        if (filter->n_samples == 0) {
+            filter->value = rpm;
+            filter->n_samples = 1;
+        } else {
+            filter->value = (int)(((long long)cfg->alpha * rpm +
+                                   (long long)(100 - cfg->alpha) *
+                                   filter->value) / 100);
+        }
+        break;
+    }
+
+    return(filter->value);
+}
+
+int
+fan_rpm_filter_read_error(struct fan_rpm_filter *filter,
+                          const struct fan_rpm_filter_config *cfg)
+{
+    if (cfg->type != FAND_RPM_FILTER_NONE &&
+            ++filter->n_read_errors <= cfg->outlier_limit) {
+        return(filter->value);
+    }
+
+    /* the tach keeps failing: the fan can't be told to be running */
+    fan_rpm_filter_reset(filter);
+    return(0);
+}
+
+enum fan_rpm_filter_type
+fan_rpm_filter_string_to_enum(const char *name)
+{
+    size_t i;
+
+    if (name == NULL) {
+        return(FAND_RPM_FILTER_NONE);
+    }
+
+    for (i = 0; i < sizeof(fanfilter_string)/sizeof(const char *); i++) {
+        if (strcmp(fanfilter_string[i], name) == 0) {
+            return(i);
+        }
+    }
+
+    return(FAND_RPM_FILTER_NONE);
+}
+
+const char *
+fan_rpm_filter_enum_to_string(enum fan_rpm_filter_type type)
+{
+    if ((unsigned int)type < (sizeof(fanfilter_string)/sizeof(const char *)))
+        return(fanfilter_string[type]);
+    return(fanfilter_string[FAND_RPM_FILTER_NONE]);
+}
@@ -0,0 +1,677 @@
+/*
+ *  (c) Copyright 2015 Hewlett Packard Enterprise Development LP
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License. You may obtain
+ *  a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *  License for the specific language governing permissions and limitations
+ *  under the License.
+ */
+
+
+/************************************************************************//**
+ * @ingroup fand
+ *
+ * @file
+ * Source file for the fan flight recorder.
+ *
+ * The file is a header block, a ring of FAND_FLIGHT_LIVE_BLOCKS blocks and
+ * FAND_FLIGHT_SLOTS slots of FAND_FLIGHT_SLOT_BLOCKS blocks each, all of
+ * FAND_FLIGHT_BLOCK_SIZE bytes. Each block starts with its sequence number
+ * and wall clock time, and holds whole sample records; the first record of
+ * a subsystem in a block has its name and absolute values, and the next
+ * ones hold the rpm as a difference from the previous record, so that any
+ * block can be decoded on its own. A zero byte ends the records of a block.
+ *
+ * A sample record is, with varints (7 bits per byte, LSB first):
+ *
+ *     kind (FAND_FLIGHT_SAMPLE, | FAND_FLIGHT_KEY in a subsystem's first)
+ *     msec since the block's time
+ *     subsystem id in the block; for a key record, the name length and name
+ *     speed, speed from the sensors, override (each enum fanspeed + 1)
+ *     flags (FAND_FLIGHT_F_*)
+ *     speed control value + 1 (0: none yet)
+ *     number of fans, then for each: rpm (zigzag), status
+ *
+ * Writes only go to the mapping; the kernel writes the dirty pages back.
+ * A subsystem is sampled at most every FAND_FLIGHT_INTERVAL_MSEC unless
+ * its state changed, and the header is only touched when a block is
+ * started, so only a page or two are dirtied between two writebacks.
+ *
+ * A fan fault or a move to max speed schedules a freeze: once
+ * FAND_FLIGHT_POST_MSEC more have been recorded, the last
+ * FAND_FLIGHT_SLOT_BLOCKS blocks are copied to a slot, the oldest one if
+ * they're all taken. Freezes are at least FAND_FLIGHT_FREEZE_MSEC apart.
+ ***************************************************************************/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "timeval.h"
+#include "util.h"
+#include "openvswitch/vlog.h"
+#include "fanarena.h"
+#include "fanflight.h"
+
+VLOG_DEFINE_THIS_MODULE(fanflight);
+
+#define FAND_FLIGHT_MAGIC        0x46444652 /* "RFDF" */
+#define FAND_FLIGHT_BLOCK_MAGIC  0x4b4c4246 /* "FBLK" */
+#define FAND_FLIGHT_VERSION      1
+
+#define FAND_FLIGHT_BLOCK_SIZE   4096
+#define FAND_FLIGHT_LIVE_BLOCKS  256
+#define FAND_FLIGHT_SLOTS        4
+#define FAND_FLIGHT_SLOT_BLOCKS  32
+
+#define FAND_FLIGHT_INTERVAL_MSEC 10000
+#define FAND_FLIGHT_POST_MSEC     60000
+#define FAND_FLIGHT_FREEZE_MSEC   (10 * 60 * 1000)
+
+#define FAND_FLIGHT_END          0
+#define FAND_FLIGHT_SAMPLE       1
+#define FAND_FLIGHT_KEY          0x80
+
+#define FAND_FLIGHT_F_ALERT      0x01 /* the thermal alert is asserted */
+#define FAND_FLIGHT_F_DEGRADED   0x02 /* a fan is faulted or absent */
+#define FAND_FLIGHT_F_EVENT      0x04 /* this sample scheduled a freeze */
+
+#define FAND_FLIGHT_NAME_MAX     64
+#define FAND_FLIGHT_MAX_IDS      64  /* subsystems per block */
+#define FAND_FLIGHT_MAX_FANS     256 /* fans per record */
+#define FAND_FLIGHT_REASON_MAX   16
+
+struct fand_flight_slot {
+    uint64_t wall_msec;           /* of the event */
+    uint32_t valid;
+    uint32_t pad;
+    char subsystem[FAND_FLIGHT_NAME_MAX];
+    char reason[FAND_FLIGHT_REASON_MAX];
+};
+
+struct fand_flight_header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t block_size;
+    uint32_t live_blocks;
+    uint32_t n_slots;
+    uint32_t slot_blocks;
+    uint32_t next_seq;            /* of the next block to start */
+    uint32_t head;                /* live block being written */
+    struct fand_flight_slot slots[FAND_FLIGHT_SLOTS];
+};
+
+struct fand_flight_block {
+    uint32_t magic;
+    uint32_t seq;                 /* 0: never written */
+    uint64_t wall_msec;           /* record times are relative to this */
+    uint8_t data[FAND_FLIGHT_BLOCK_SIZE - 16];
+};
+
+BUILD_ASSERT_DECL(sizeof(struct fand_flight_header) <= FAND_FLIGHT_BLOCK_SIZE);
+BUILD_ASSERT_DECL(sizeof(struct fand_flight_block) == FAND_FLIGHT_BLOCK_SIZE);
+
+#define FAND_FLIGHT_FILE_SIZE \
+    ((1 + FAND_FLIGHT_LIVE_BLOCKS + \
+      FAND_FLIGHT_SLOTS * FAND_FLIGHT_SLOT_BLOCKS) * FAND_FLIGHT_BLOCK_SIZE)
+
+/* per subsystem */
+struct fand_flight_state {
+    uint32_t block_seq;           /* block of the last record, 0: none */
+    unsigned int block_id;        /* the subsystem's id in that block */
+    long long int last_msec;      /* of the last record */
+    int8_t speed;                 /* in the last record */
+    int8_t fan_speed;
+    int8_t override;
+    uint8_t flags;
+    int hw_value;
+    int *rpm;                     /* per fan, in the last record */
+    uint8_t *status;
+};
+
+static char *flight_path = NULL;
+static uint8_t *flight_map = NULL;
+static struct fand_flight_header *flight_header;
+static struct fand_flight_block *flight_block; /* being written */
+static size_t flight_used;        /* bytes of its data used */
+static unsigned int flight_n_ids; /* subsystem ids given in the block */
+
+/* the freeze scheduled by the last event, if any */
+static bool freeze_pending = false;
+static long long int freeze_msec;
+static long long int last_freeze_msec;
+static bool frozen = false;         /* a window was frozen since startup */
+static struct fand_flight_slot freeze_slot;
+
+static struct fand_flight_block *
+fand_flight_live(uint32_t idx)
+{
+    return((struct fand_flight_block *)
+           (flight_map + (1 + idx) * FAND_FLIGHT_BLOCK_SIZE));
+}
+
+static struct fand_flight_block *
+fand_flight_slot_block(uint32_t slot, uint32_t idx)
+{
+    return((struct fand_flight_block *)
+           (flight_map + (1 + FAND_FLIGHT_LIVE_BLOCKS +
+                          slot * FAND_FLIGHT_SLOT_BLOCKS + idx) *
+                         FAND_FLIGHT_BLOCK_SIZE));
+}
+
+static bool
+fand_flight_layout_matches(const struct fand_flight_header *header)
+{
+    return(header->magic == FAND_FLIGHT_MAGIC &&
+           header->version == FAND_FLIGHT_VERSION &&
+           header->block_size == FAND_FLIGHT_BLOCK_SIZE &&
+           header->live_blocks == FAND_FLIGHT_LIVE_BLOCKS &&
+           header->n_slots == FAND_FLIGHT_SLOTS &&
+           header->slot_blocks == FAND_FLIGHT_SLOT_BLOCKS &&
+           header->head < FAND_FLIGHT_LIVE_BLOCKS);
+}
+
+/* move to the next live block */
+static void
+fand_flight_next_block(void)
+{
+    struct fand_flight_header *header = flight_header;
+
+    header->head = (header->head + 1) % FAND_FLIGHT_LIVE_BLOCKS;
+    flight_block = fand_flight_live(header->head);
+    memset(flight_block, 0, sizeof(*flight_block));
+    flight_block->magic = FAND_FLIGHT_BLOCK_MAGIC;
+    flight_block->wall_msec = time_wall_msec();
+    flight_block->seq = header->next_seq++;
+    if (header->next_seq == 0) {
+        header->next_seq = 1;
+    }
+    flight_used = 0;
+    flight_n_ids = 0;
+}
+
+void
+fand_flight_set_file(const char *path)
+{
+    free(flight_path);
+    flight_path = path ? xstrdup(path) : NULL;
+}
+
+void
+fand_flight_open(void)
+{
+    struct stat st;
+    void *map;
+    int fd;
+
+    if (flight_path == NULL || flight_map != NULL) {
+        return;
+    }
+
+    fd = open(flight_path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        VLOG_WARN("unable to open flight recorder %s (%s)", flight_path,
+                  ovs_strerror(errno));
+        return;
+    }
+    if (fstat(fd, &st) != 0 ||
+            (st.st_size != FAND_FLIGHT_FILE_SIZE &&
+             ftruncate(fd, FAND_FLIGHT_FILE_SIZE) != 0)) {
+        VLOG_WARN("unable to size flight recorder %s (%s)", flight_path,
+                  ovs_strerror(errno));
+        close(fd);
+        return;
+    }
+
+    map = mmap(NULL, FAND_FLIGHT_FILE_SIZE, PROT_READ | PROT_WRITE,
+               MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        VLOG_WARN("unable to map flight recorder %s (%s)", flight_path,
+                  ovs_strerror(errno));
+        return;
+    }
+    flight_map = map;
+    flight_header = map;
+
+    if (!fand_flight_layout_matches(flight_header)) {
+        VLOG_INFO("initializing flight recorder %s", flight_path);
+        memset(flight_map, 0, FAND_FLIGHT_FILE_SIZE);
+        flight_header->magic = FAND_FLIGHT_MAGIC;
+        flight_header->version = FAND_FLIGHT_VERSION;
+        flight_header->block_size = FAND_FLIGHT_BLOCK_SIZE;
+        flight_header->live_blocks = FAND_FLIGHT_LIVE_BLOCKS;
+        flight_header->n_slots = FAND_FLIGHT_SLOTS;
+        flight_header->slot_blocks = FAND_FLIGHT_SLOT_BLOCKS;
+        flight_header->next_seq = 1;
+        flight_header->head = FAND_FLIGHT_LIVE_BLOCKS - 1;
+    }
+
+    /* never append to a block a crash may have cut short */
+    fand_flight_next_block();
+}
+
+void
+fand_flight_close(void)
+{
+    if (flight_map != NULL) {
+        msync(flight_map, FAND_FLIGHT_FILE_SIZE, MS_SYNC);
+        munmap(flight_map, FAND_FLIGHT_FILE_SIZE);
+        flight_map = NULL;
+        flight_block = NULL;
+    }
+}
+
+void
+fand_flight_attach(struct locl_subsystem *subsystem)
+{
+    struct fand_flight_state *state;
+
+    state = fand_arena_alloc(subsystem->arena, sizeof(*state));
+    state->rpm = fand_arena_alloc(subsystem->arena,
+                                  subsystem->n_fans * sizeof(int));
+    state->status = fand_arena_alloc(subsystem->arena, subsystem->n_fans);
+    state->hw_value = -1;
+    subsystem->flight = state;
+}
+
+static size_t
+fand_flight_put_varint(uint8_t *buf, uint64_t value)
+{
+    size_t n = 0;
+
+    while (value >= 0x80) {
+        buf[n++] = (value & 0x7f) | 0x80;
+        value >>= 7;
+    }
+    buf[n++] = value;
+    return(n);
+}
+
+static uint64_t
+fand_flight_zigzag(int64_t value)
+{
+    return(((uint64_t)value << 1) ^ (uint64_t)(value >> 63));
+}
+
+/* encode a sample of the subsystem into 'buf' (at least a block's data),
+   in full if 'key'. returns its length. */
+static size_t
+fand_flight_encode(const struct locl_subsystem *subsystem,
+                   const struct fand_flight_state *state, bool key,
+                   unsigned int id, uint64_t msec, uint8_t flags,
+                   uint8_t *buf)
+{
+    const struct locl_fan_state *fans = &subsystem->fan_state;
+    size_t max = sizeof(flight_block->data) - 1;
+    size_t name_len = strlen(subsystem->name);
+    size_t n = 0, n_fans, idx;
+
+    name_len = MIN(name_len, FAND_FLIGHT_NAME_MAX - 1);
+
+    buf[n++] = FAND_FLIGHT_SAMPLE | (key ? FAND_FLIGHT_KEY : 0);
+    n += fand_flight_put_varint(buf + n, msec);
+    n += fand_flight_put_varint(buf + n, id);
+    if (key) {
+        buf[n++] = name_len;
+        memcpy(buf + n, subsystem->name, name_len);
+        n += name_len;
+    }
+    buf[n++] = subsystem->speed + 1;
+    buf[n++] = subsystem->fan_speed + 1;
+    buf[n++] = subsystem->fan_speed_override + 1;
+    buf[n++] = flags;
+    n += fand_flight_put_varint(buf + n,
+                                subsystem->governor_state.hw_value + 1);
+
+    /* a subsystem too large for one block only has its first fans */
+    n_fans = MIN(subsystem->n_fans, (max - n - 10) / 11);
+    n_fans = MIN(n_fans, FAND_FLIGHT_MAX_FANS);
+    n += fand_flight_put_varint(buf + n, n_fans);
+    for (idx = 0; idx < n_fans; idx++) {
+        int64_t rpm = fans->rpm[idx];
+
+        if (!key) {
+            rpm -= state->rpm[idx];
+        }
+        n += fand_flight_put_varint(buf + n, fand_flight_zigzag(rpm));
+        buf[n++] = fans->status[idx];
+    }
+
+    return(n);
+}
+
+/* schedule a freeze of the window around an event */
+static bool
+fand_flight_event(const struct locl_subsystem *subsystem, const char *reason,
+                  long long int now)
+{
+    if (freeze_pending ||
+            (frozen && now - last_freeze_msec < FAND_FLIGHT_FREEZE_MSEC)) {
+        return(false);
+    }
+
+    freeze_pending = true;
+    freeze_msec = now + FAND_FLIGHT_POST_MSEC;
+    memset(&freeze_slot, 0, sizeof(freeze_slot));
+    freeze_slot.wall_msec = time_wall_msec();
+    freeze_slot.valid = 1;
+    ovs_strlcpy(freeze_slot.subsystem, subsystem->name,
+                sizeof(freeze_slot.subsystem));
+    ovs_strlcpy(freeze_slot.reason, reason, sizeof(freeze_slot.reason));
+    return(true);
+}
+
+void
+fand_flight_sample(struct locl_subsystem *subsystem, long long int now)
+{
+    struct fand_flight_state *state = subsystem->flight;
+    const struct locl_fan_state *fans = &subsystem->fan_state;
+    uint8_t buf[FAND_FLIGHT_BLOCK_SIZE];
+    const char *event = NULL;
+    bool changed, key;
+    int64_t msec;
+    uint8_t flags;
+    size_t n, idx;
+
+    if (flight_map == NULL || state == NULL) {
+        return;
+    }
+
+    flags = (subsystem->thermal_alert ? FAND_FLIGHT_F_ALERT : 0) |
+            (subsystem->degraded ? FAND_FLIGHT_F_DEGRADED : 0);
+    changed = state->speed != subsystem->speed ||
+              state->fan_speed != subsystem->fan_speed ||
+              state->override != subsystem->fan_speed_override ||
+              state->flags != flags ||
+              state->hw_value != subsystem->governor_state.hw_value;
+    for (idx = 0; idx < subsystem->n_fans; idx++) {
+        if (fans->status[idx] != state->status[idx]) {
+            changed = true;
+            if (fans->status[idx] == FAND_STATUS_FAULT) {
+                event = "fan fault";
+            }
+        }
+    }
+    if (subsystem->speed == FAND_SPEED_MAX &&
+            state->speed != FAND_SPEED_MAX) {
+        event = "max speed";
+    }
+    /* the first sample has nothing to compare with */
+    if (state->block_seq == 0) {
+        event = NULL;
+    }
+
+    if (!changed && state->block_seq != 0 &&
+            now - state->last_msec < FAND_FLIGHT_INTERVAL_MSEC) {
+        return;
+    }
+    if (event != NULL && fand_flight_event(subsystem, event, now)) {
+        flags |= FAND_FLIGHT_F_EVENT;
+    }
+
+    /* a block too old for its msec to be worth encoding gets a successor */
+    msec = time_wall_msec() - (int64_t)flight_block->wall_msec;
+    if (msec < 0 || msec > 24LL * 3600 * 1000) {
+        fand_flight_next_block();
+        msec = 0;
+    }
+
+    key = state->block_seq != flight_block->seq;
+    if (key && flight_n_ids >= FAND_FLIGHT_MAX_IDS) {
+        fand_flight_next_block();
+        msec = 0;
+    }
+    n = fand_flight_encode(subsystem, state, key,
+                           key ? flight_n_ids : state->block_id, msec, flags,
+                           buf);
+    if (flight_used + n >= sizeof(flight_block->data)) {
+        fand_flight_next_block();
+        key = true;
+        n = fand_flight_encode(subsystem, state, key, flight_n_ids, 0, flags,
+                               buf);
+    }
+    if (key) {
+        state->block_seq = flight_block->seq;
+        state->block_id = flight_n_ids++;
+    }
+    memcpy(flight_block->data + flight_used, buf, n);
+    flight_used += n;
+
+    state->last_msec = now;
+    state->speed = subsystem->speed;
+    state->fan_speed = subsystem->fan_speed;
+    state->override = subsystem->fan_speed_override;
+    state->flags = flags & ~FAND_FLIGHT_F_EVENT;
+    state->hw_value = subsystem->governor_state.hw_value;
+    memcpy(state->rpm, fans->rpm, subsystem->n_fans * sizeof(int));
+    memcpy(state->status, fans->status, subsystem->n_fans);
+}
+
+void
+fand_flight_run(long long int now)
+{
+    struct fand_flight_header *header = flight_header;
+    uint32_t slot, oldest = 0, idx;
+
+    if (flight_map == NULL || !freeze_pending || now < freeze_msec) {
+        return;
+    }
+    freeze_pending = false;
+    frozen = true;
+    last_freeze_msec = now;
+
+    for (slot = 0; slot < FAND_FLIGHT_SLOTS; slot++) {
+        if (!header->slots[slot].valid) {
+            break;
+        }
+        if (header->slots[slot].wall_msec <
+                header->slots[oldest].wall_msec) {
+            oldest = slot;
+        }
+    }
+    if (slot == FAND_FLIGHT_SLOTS) {
+        slot = oldest;
+    }
+
+    /* the blocks that lead up to the head, the head last */
+    for (idx = 0; idx < FAND_FLIGHT_SLOT_BLOCKS; idx++) {
+        uint32_t live = (header->head + FAND_FLIGHT_LIVE_BLOCKS -
+                         FAND_FLIGHT_SLOT_BLOCKS + 1 + idx) %
+                        FAND_FLIGHT_LIVE_BLOCKS;
+
+        memcpy(fand_flight_slot_block(slot, idx), fand_flight_live(live),
+               FAND_FLIGHT_BLOCK_SIZE);
+    }
+    header->slots[slot] = freeze_slot;
+
+    VLOG_INFO("flight recorder: froze the window around the %s of "
+              "subsystem %s in slot %u", freeze_slot.reason,
+              freeze_slot.subsystem, slot);
+}
+
+static bool
+fand_flight_get_varint(const uint8_t *data, size_t size, size_t *pos,
+                       uint64_t *value)
+{
+    int shift = 0;
+
+    *value = 0;
+    while (*pos < size && shift < 64) {
+        uint8_t byte = data[(*pos)++];
+
+        *value |= (uint64_t)(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            return(true);
+        }
+        shift += 7;
+    }
+    return(false);
+}
+
+static const char *
+fand_flight_speed(uint8_t value)
+{
+    return(fan_speed_enum_to_string((enum fanspeed)((int)value - 1)));
+}
+
+/* decode the records of one block, each on a line. stops at the first
+   record that is cut short. */
+static void
+fand_flight_decode_block(const struct fand_flight_block *block,
+                         struct ds *ds)
+{
+    const uint8_t *data = block->data;
+    size_t size = sizeof(block->data);
+    char names[FAND_FLIGHT_MAX_IDS][FAND_FLIGHT_NAME_MAX];
+    int (*rpm)[FAND_FLIGHT_MAX_FANS];
+    unsigned int n_names = 0;
+    size_t pos = 0;
+
+    /* the rpm of each subsystem's fans, as of its last record */
+    rpm = xcalloc(FAND_FLIGHT_MAX_IDS, sizeof(*rpm));
+    memset(names, 0, sizeof(names));
+
+    while (pos < size && data[pos] != FAND_FLIGHT_END) {
+        uint8_t kind = data[pos++];
+        uint64_t msec, id, hw_value, n_fans, value, idx;
+        uint8_t speed, fan_speed, override, flags;
+        bool key = kind & FAND_FLIGHT_KEY;
+
+        if ((kind & ~FAND_FLIGHT_KEY) != FAND_FLIGHT_SAMPLE ||
+                !fand_flight_get_varint(data, size, &pos, &msec) ||
+                !fand_flight_get_varint(data, size, &pos, &id) ||
+                id >= FAND_FLIGHT_MAX_IDS) {
+            break;
+        }
+        if (key) {
+            size_t len;
+
+            if (pos >= size || pos + 1 + data[pos] > size) {
+                break;
+            }
+            len = data[pos++];
+            memcpy(names[id], data + pos, MIN(len, FAND_FLIGHT_NAME_MAX - 1));
+            pos += len;
+            n_names = MAX(n_names, id + 1);
+        } else if (id >= n_names) {
+            break;
+        }
+        if (pos + 4 > size) {
+            break;
+        }
+        speed = data[pos++];
+        fan_speed = data[pos++];
+        override = data[pos++];
+        flags = data[pos++];
+        if (!fand_flight_get_varint(data, size, &pos, &hw_value) ||
+                !fand_flight_get_varint(data, size, &pos, &n_fans) ||
+                n_fans > FAND_FLIGHT_MAX_FANS) {
+            break;
+        }
+
+        ds_put_format(ds, "%llu %s speed=%s sensors=%s override=%s "
+                      "control=%lld%s%s%s fans=",
+                      (unsigned long long int)(block->wall_msec + msec),
+                      names[id], fand_flight_speed(speed),
+                      fand_flight_speed(fan_speed),
+                      fand_flight_speed(override),
+                      (long long int)hw_value - 1,
+                      flags & FAND_FLIGHT_F_ALERT ? " alert" : "",
+                      flags & FAND_FLIGHT_F_DEGRADED ? " degraded" : "",
+                      flags & FAND_FLIGHT_F_EVENT ? " event" : "");
+        for (idx = 0; idx < n_fans; idx++) {
+            int64_t delta;
+            uint8_t status;
+
+            if (!fand_flight_get_varint(data, size, &pos, &value) ||
+                    pos >= size) {
+                break;
+            }
+            status = data[pos++];
+            delta = (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+            rpm[id][idx] = key ? delta : rpm[id][idx] + delta;
+            ds_put_format(ds, "%s%d/%s", idx ? "," : "", rpm[id][idx],
+                          fan_status_enum_to_string(status));
+        }
+        ds_put_cstr(ds, "\n");
+        if (idx < n_fans) {
+            break;
+        }
+    }
+
+    free(rpm);
+}
+
+static void
+fand_flight_export_block(const struct fand_flight_block *block,
+                         struct ds *ds)
+{
+    if (block->magic == FAND_FLIGHT_BLOCK_MAGIC && block->seq != 0) {
+        fand_flight_decode_block(block, ds);
+    }
+}
+
+void
+fand_flight_export(struct ds *ds)
+{
+    const struct fand_flight_header *header = flight_header;
+    uint32_t slot, idx;
+
+    if (flight_map == NULL) {
+        ds_put_cstr(ds, "flight recorder not open\n");
+        return;
+    }
+
+    for (slot = 0; slot < FAND_FLIGHT_SLOTS; slot++) {
+        const struct fand_flight_slot *frozen = &header->slots[slot];
+
+        if (!frozen->valid) {
+            continue;
+        }
+        ds_put_format(ds, "# frozen window %u: %.*s of subsystem %.*s at "
+                      "%llu\n", slot, FAND_FLIGHT_REASON_MAX, frozen->reason,
+                      FAND_FLIGHT_NAME_MAX, frozen->subsystem,
+                      (unsigned long long int)frozen->wall_msec);
+        for (idx = 0; idx < FAND_FLIGHT_SLOT_BLOCKS; idx++) {
+            fand_flight_export_block(fand_flight_slot_block(slot, idx), ds);
+        }
+    }
+
+    /* the oldest block is the one after the head */
+    ds_put_cstr(ds, "# live\n");
+    for (idx = 1; idx <= FAND_FLIGHT_LIVE_BLOCKS; idx++) {
+        fand_flight_export_block(
+            fand_flight_live((header->head + idx) % FAND_FLIGHT_LIVE_BLOCKS),
+            ds);
+    }
+}
+
+void
+fand_flight_format(struct ds *ds)
+{
+    uint32_t slot, n_frozen = 0;
+
+    if (flight_map == NULL) {
+        ds_put_cstr(ds, "off");
+        return;
+    }
+    for (slot = 0; slot < FAND_FLIGHT_SLOTS; slot++) {
+        n_frozen += flight_header->slots[slot].valid != 0;
+    }
+    ds_put_format(ds, "%s, block %u, %u of %d windows frozen%s",
+                  flight_path, (unsigned int)flight_header->next_seq - 1,
+                  (unsigned int)n_frozen,
+                  FAND_FLIGHT_SLOTS, freeze_pending ? ", freeze pending" : "");
+}
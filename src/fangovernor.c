@@ -0,0 +1,138 @@
+/*
+ *  (c) Copyright 2015 Hewlett Packard Enterprise Development LP
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License. You may obtain
+ *  a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *  License for the specific language governing permissions and limitations
+ *  under the License.
+ */
+
+/************************************************************************//**
+ * @ingroup fand
+ *
+ * @file
+ * Source file for fan speed governor functions.
+ *
+ * The governor sits between the speed computed from the sensors and the
+ * speed control register. Going up is immediate, but a lower speed has to
+ * be requested without interruption for the down dwell time before it is
+ * applied, so a sensor flapping across a threshold doesn't make the fans
+ * surge. The register itself is moved in steps of at most "slew" per
+ * interval. Going to max bypasses both.
+ ***************************************************************************/
+
+#include <limits.h>
+
+#include "fangovernor.h"
+
+#define FAND_GOVERNOR_DEFAULT_SLEW_INTERVAL  1000
+
+void
+fan_governor_config_init(struct fan_governor_config *cfg)
+{
+    cfg->down_dwell_msec = 0;
+    cfg->slew = 0;
+    cfg->slew_interval_msec = FAND_GOVERNOR_DEFAULT_SLEW_INTERVAL;
+}
+
+void
+fan_governor_reset(struct fan_governor *gov)
+{
+    gov->level = FAND_SPEED_NONE;
+    gov->down_since = 0;
+    gov->hw_value = -1;
+    gov->hw_target = -1;
+    gov->last_step = 0;
+}
+
+void
+fan_governor_resume(struct fan_governor *gov, enum fanspeed level,
+                    int hw_value)
+{
+    fan_governor_reset(gov);
+    gov->level = level;
+    gov->hw_value = hw_value;
+    gov->hw_target = hw_value;
+}
+
+enum fanspeed
+fan_governor_level(struct fan_governor *gov,
+                   const struct fan_governor_config *cfg,
+                   enum fanspeed requested, long long int now)
+{
+    if (gov->level == FAND_SPEED_NONE || requested >= gov->level ||
+            requested == FAND_SPEED_MAX || cfg->down_dwell_msec <= 0) {
+        /* any request at or above the current level also restarts the
+           dwell time of a pending lower one */
+        gov->level = requested;
+        gov->down_since = 0;
+        return(gov->level);
+    }
+
+    if (gov->down_since == 0) {
+        gov->down_since = now;
+    }
+    if (now - gov->down_since >= cfg->down_dwell_msec) {
+        gov->level = requested;
+        gov->down_since = 0;
+    }
+
+    return(gov->level);
+}
+
+int
+fan_governor_hw_value(struct fan_governor *gov,
+                      const struct fan_governor_config *cfg,
+                      int hw_target, long long int now)
+{
+    int step;
+
+    gov->hw_target = hw_target;
+
+    if (gov->hw_value < 0 || cfg->slew <= 0 ||
+            gov->level == FAND_SPEED_MAX) {
+        gov->hw_value = hw_target;
+        gov->last_step = now;
+        return(gov->hw_value);
+    }
+
+    if (gov->hw_value == hw_target ||
+            now - gov->last_step < cfg->slew_interval_msec) {
+        return(gov->hw_value);
+    }
+
+    step = hw_target - gov->hw_value;
+    if (step > cfg->slew) {
+        step = cfg->slew;
+    } else if (step < -cfg->slew) {
+        step = -cfg->slew;
+    }
+    gov->hw_value += step;
+    gov->last_step = now;
+
+    return(gov->hw_value);
+}
+
+long long int
+fan_governor_next_msec(const struct fan_governor *gov,
+                       const struct fan_governor_config *cfg)
+{
+    long long int next = LLONG_MAX;
+
+    if (gov->down_since != 0) {
+        next = gov->down_since + cfg->down_dwell_msec;
+    }
+    if (gov->hw_value >= 0 && gov->hw_value != gov->hw_target &&
+            gov->last_step + cfg->slew_interval_msec < next) {
+        next = gov->last_step + cfg->slew_interval_msec;
+    }
+
+    return(next);
+}
@@ -0,0 +1,297 @@
+/*
+ *  (c) Copyright 2015 Hewlett Packard Enterprise Development LP
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License. You may obtain
+ *  a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *  License for the specific language governing permissions and limitations
+ *  under the License.
+ */
+
+/************************************************************************//**
+ * @ingroup fand
+ *
+ * @file
+ * Source file for the hwmon fan backend.
+ *
+ * Each attribute is opened when the subsystem is added and kept open, so a
+ * poll is one pread() per attribute, with no path lookups. Attribute
+ * accesses are recorded and replayed like register accesses: the attribute
+ * name stands for the device, at register 0.
+ ***************************************************************************/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "util.h"
+#include "openvswitch/vlog.h"
+#include "fanhwmon.h"
+#include "fanrecord.h"
+#include "fantrace.h"
+
+VLOG_DEFINE_THIS_MODULE(fanhwmon);
+
+struct fand_hwmon_attr {
+    int fd;                       /* -1 if the attribute doesn't exist */
+    i2c_bit_op op;                /* stands for the attribute in traces */
+};
+
+struct fand_hwmon_fan {
+    struct fand_hwmon_attr input;
+    struct fand_hwmon_attr fault;
+    struct fand_hwmon_attr pwm;
+    struct fand_hwmon_attr target; /* rpm the driver regulates to */
+};
+
+struct fand_hwmon {
+    const char *subsystem_name;
+    size_t n_fans;
+    struct fand_hwmon_fan *fans;
+};
+
+static void
+fand_hwmon_attr_open(struct fand_arena *arena, struct fand_hwmon *hwmon,
+                     struct fand_hwmon_attr *attr, const char *dir,
+                     const char *name, int flags)
+{
+    char *path;
+
+    attr->op.device = fand_arena_strdup(arena, name);
+    attr->op.register_address = 0;
+    attr->op.register_size = 4;
+    attr->op.bit_mask = 0xffffffff;
+    attr->fd = -1;
+
+    /* a replay gets the values from the trace */
+    if (fand_replaying()) {
+        return;
+    }
+
+    path = xasprintf("%s/%s", dir, name);
+    attr->fd = open(path, flags | O_CLOEXEC);
+    if (attr->fd < 0 && errno != ENOENT) {
+        VLOG_WARN("subsystem %s: unable to open %s (%s)",
+                  hwmon->subsystem_name, path, ovs_strerror(errno));
+    }
+    free(path);
+}
+
+/* put a pwm under manual control, if the driver has a choice */
+static void
+fand_hwmon_pwm_enable(const struct fand_hwmon *hwmon, const char *dir,
+                      size_t number)
+{
+    char *path;
+    int fd;
+
+    if (fand_replaying()) {
+        return;
+    }
+
+    path = xasprintf("%s/pwm%zu_enable", dir, number);
+    fd = open(path, O_WRONLY | O_CLOEXEC);
+    if (fd >= 0) {
+        if (write(fd, "1\n", 2) != 2) {
+            VLOG_WARN("subsystem %s: unable to enable %s (%s)",
+                      hwmon->subsystem_name, path, ovs_strerror(errno));
+        }
+        close(fd);
+    }
+    free(path);
+}
+
+struct fand_hwmon *
+fand_hwmon_open(struct fand_arena *arena, const char *subsystem_name,
+                const char *dir, size_t n_fans)
+{
+    struct fand_hwmon *hwmon;
+    char name[32];
+    size_t idx;
+
+    hwmon = fand_arena_alloc(arena, sizeof(*hwmon));
+    hwmon->subsystem_name = subsystem_name;
+    hwmon->n_fans = n_fans;
+    hwmon->fans = fand_arena_alloc(arena, n_fans * sizeof(*hwmon->fans));
+
+    for (idx = 0; idx < n_fans; idx++) {
+        struct fand_hwmon_fan *fan = &hwmon->fans[idx];
+
+        snprintf(name, sizeof(name), "fan%zu_input", idx + 1);
+        fand_hwmon_attr_open(arena, hwmon, &fan->input, dir, name, O_RDONLY);
+        if (fan->input.fd < 0 && !fand_replaying()) {
+            VLOG_WARN("subsystem %s: no %s in %s", subsystem_name, name, dir);
+        }
+        snprintf(name, sizeof(name), "fan%zu_fault", idx + 1);
+        fand_hwmon_attr_open(arena, hwmon, &fan->fault, dir, name, O_RDONLY);
+        snprintf(name, sizeof(name), "pwm%zu", idx + 1);
+        fand_hwmon_attr_open(arena, hwmon, &fan->pwm, dir, name, O_WRONLY);
+        if (fan->pwm.fd >= 0) {
+            fand_hwmon_pwm_enable(hwmon, dir, idx + 1);
+        }
+        snprintf(name, sizeof(name), "fan%zu_target", idx + 1);
+        fand_hwmon_attr_open(arena, hwmon, &fan->target, dir, name,
+                             O_WRONLY);
+    }
+
+    return(hwmon);
+}
+
+void
+fand_hwmon_close(struct fand_hwmon *hwmon)
+{
+    size_t idx;
+
+    if (hwmon == NULL) {
+        return;
+    }
+
+    for (idx = 0; idx < hwmon->n_fans; idx++) {
+        struct fand_hwmon_fan *fan = &hwmon->fans[idx];
+
+        if (fan->input.fd >= 0) {
+            close(fan->input.fd);
+        }
+        if (fan->fault.fd >= 0) {
+            close(fan->fault.fd);
+        }
+        if (fan->pwm.fd >= 0) {
+            close(fan->pwm.fd);
+        }
+        if (fan->target.fd >= 0) {
+            close(fan->target.fd);
+        }
+    }
+}
+
+/* read an attribute holding a decimal number */
+static int
+fand_hwmon_read(const struct fand_hwmon *hwmon,
+                const struct fand_hwmon_attr *attr, uint32_t *value)
+{
+    char buf[16];
+    ssize_t len;
+    int rc = 0;
+
+    if (fand_replaying()) {
+        return(fand_replay_reg(false, hwmon->subsystem_name, &attr->op,
+                               value));
+    }
+
+    *value = 0;
+    if (attr->fd < 0) {
+        rc = -ENOENT;
+    } else {
+        FAND_SPAN_BEGIN(span);
+        len = pread(attr->fd, buf, sizeof(buf) - 1, 0);
+        FAND_SPAN_END(span, "hwmon_read", attr->op.device, -1);
+        if (len < 0) {
+            rc = -errno;
+        } else if (len == 0) {
+            rc = -EIO;
+        } else {
+            buf[len] = '\0';
+            *value = strtoul(buf, NULL, 10);
+        }
+    }
+    fand_record_reg(false, hwmon->subsystem_name, &attr->op, rc, *value);
+
+    return(rc);
+}
+
+static int
+fand_hwmon_write(const struct fand_hwmon *hwmon,
+                 const struct fand_hwmon_attr *attr, uint32_t value)
+{
+    char buf[16];
+    int len;
+    int rc = 0;
+
+    if (fand_replaying()) {
+        return(fand_replay_reg(true, hwmon->subsystem_name, &attr->op,
+                               &value));
+    }
+
+    if (attr->fd < 0) {
+        rc = -ENOENT;
+    } else {
+        len = snprintf(buf, sizeof(buf), "%u\n", value);
+        FAND_SPAN_BEGIN(span);
+        if (pwrite(attr->fd, buf, len, 0) != len) {
+            rc = -errno;
+        }
+        FAND_SPAN_END(span, "hwmon_write", attr->op.device, -1);
+    }
+    fand_record_reg(true, hwmon->subsystem_name, &attr->op, rc, value);
+
+    return(rc);
+}
+
+void
+fand_hwmon_read_fan(struct fand_hwmon *hwmon, size_t idx, int *rc,
+                    uint32_t *rpm, enum fanstatus *status)
+{
+    const struct fand_hwmon_fan *fan = &hwmon->fans[idx];
+    uint32_t fault = 0;
+
+    *rc = fand_hwmon_read(hwmon, &fan->input, rpm);
+    if (*rc != 0) {
+        *status = FAND_STATUS_FAULT;
+        return;
+    }
+
+    /* a missing attribute is recorded as such, so that a replay knows */
+    if (fand_hwmon_read(hwmon, &fan->fault, &fault) == 0 && fault != 0) {
+        *status = FAND_STATUS_FAULT;
+    } else {
+        *status = FAND_STATUS_OK;
+    }
+}
+
+static int
+fand_hwmon_write_all(struct fand_hwmon *hwmon, bool target, uint32_t value)
+{
+    static struct vlog_rate_limit rl = VLOG_RATE_LIMIT_INIT(1, 5);
+    int result = 0;
+    size_t idx;
+    int rc;
+
+    for (idx = 0; idx < hwmon->n_fans; idx++) {
+        const struct fand_hwmon_fan *fan = &hwmon->fans[idx];
+        const struct fand_hwmon_attr *attr = target ? &fan->target : &fan->pwm;
+
+        /* fans without a pwm of their own share another fan's */
+        rc = fand_hwmon_write(hwmon, attr, value);
+        if (rc != 0 && rc != -ENOENT) {
+            VLOG_WARN_RL(&rl, "subsystem %s: unable to write %s (%s)",
+                         hwmon->subsystem_name, attr->op.device,
+                         ovs_strerror(-rc));
+            if (result == 0) {
+                result = rc;
+            }
+        }
+    }
+
+    return(result);
+}
+
+int
+fand_hwmon_set_pwm(struct fand_hwmon *hwmon, uint32_t value)
+{
+    return(fand_hwmon_write_all(hwmon, false, value));
+}
+
+int
+fand_hwmon_set_target(struct fand_hwmon *hwmon, uint32_t rpm)
+{
+    return(fand_hwmon_write_all(hwmon, true, rpm));
+}
@@ -0,0 +1,138 @@
+/*
+ *  (c) Copyright 2015 Hewlett Packard Enterprise Development LP
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License. You may obtain
+ *  a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *  License for the specific language governing permissions and limitations
+ *  under the License.
+ */
+
+
+/************************************************************************//**
+ * @ingroup fand
+ *
+ * @file
+ * Source file for the feed-forward of switch load into the fan speed.
+ *
+ * The interface statistics are refreshed every few seconds, all at once, so
+ * the rate is taken between two samples whose byte total differs, over at
+ * most one refresh interval. Each subsystem keeps a baseline of the
+ * utilization that follows it with a first order lag of fan_load_decay
+ * msec; the boost is gain * (utilization - baseline) speed steps, rounded,
+ * and nothing while the load falls.
+ ***************************************************************************/
+
+#include "openvswitch/vlog.h"
+#include "fanload.h"
+
+VLOG_DEFINE_THIS_MODULE(fanload);
+
+/* with no change of the total for this many refresh intervals, the
+   interfaces are idle */
+#define FAND_LOAD_IDLE_INTERVALS 3
+
+static bool load_started = false;
+static unsigned long long int load_bytes;  /* total at the last change */
+static long long int load_change_msec;    /* when it was seen */
+static double load_utilization = 0;
+
+void
+fand_load_sample(unsigned long long int bytes,
+                 unsigned long long int capacity_bps, int stats_msec,
+                 long long int now)
+{
+    long long int elapsed = now - load_change_msec;
+    double bps;
+
+    if (stats_msec <= 0) {
+        stats_msec = FAND_LOAD_STATS_MSEC;
+    }
+
+    /* an interface went away or its counters were cleared */
+    if (!load_started || bytes < load_bytes) {
+        load_started = true;
+        load_bytes = bytes;
+        load_change_msec = now;
+        return;
+    }
+
+    if (bytes == load_bytes) {
+        if (elapsed >= FAND_LOAD_IDLE_INTERVALS * (long long) stats_msec) {
+            load_utilization = 0;
+        }
+        return;
+    }
+
+    /* the bytes since the last change went through in one refresh
+       interval, however long ago that change was seen */
+    if (elapsed > stats_msec) {
+        elapsed = stats_msec;
+    }
+    if (elapsed > 0 && capacity_bps > 0) {
+        bps = (double) (bytes - load_bytes) * 8 * 1000 / elapsed;
+        load_utilization = bps < capacity_bps ? bps / capacity_bps : 1;
+    } else {
+        load_utilization = 0;
+    }
+    load_bytes = bytes;
+    load_change_msec = now;
+}
+
+double
+fand_load_utilization(void)
+{
+    return(load_utilization);
+}
+
+bool
+fand_load_update(struct locl_subsystem *subsystem, long long int now)
+{
+    struct locl_load *load = &subsystem->load;
+    int boost = 0;
+    double rise;
+
+    if (load->gain > 0) {
+        if (load->last_msec < 0) {
+            /* start at the current load, not with a jump to it */
+            load->baseline = load_utilization;
+        } else if (now > load->last_msec) {
+            double dt = now - load->last_msec;
+
+            /* backward Euler, stable for any step */
+            load->baseline += (load_utilization - load->baseline) * dt /
+                              (load->decay_msec + dt);
+        }
+        load->last_msec = now;
+
+        rise = load_utilization - load->baseline;
+        if (rise > 0) {
+            boost = (int) (load->gain * rise + 0.5);
+        }
+    }
+
+    if (boost == load->boost) {
+        return(false);
+    }
+    VLOG_DBG("subsystem %s: load %.0f%%, baseline %.0f%%, boost %d",
+             subsystem->name, load_utilization * 100, load->baseline * 100,
+             boost);
+    load->boost = boost;
+    return(true);
+}
+
+void
+fand_load_format(const struct locl_subsystem *subsystem, struct ds *ds)
+{
+    const struct locl_load *load = &subsystem->load;
+
+    ds_put_format(ds, "gain %d, decay %d msec, load %.0f%%, baseline %.0f%%, "
+                  "boost %d", load->gain, load->decay_msec,
+                  load_utilization * 100, load->baseline * 100, load->boost);
+}
@@ -0,0 +1,199 @@
+/*
+ *  (c) Copyright 2015 Hewlett Packard Enterprise Development LP
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License. You may obtain
+ *  a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *  License for the specific language governing permissions and limitations
+ *  under the License.
+ */
+
+/************************************************************************//**
+ * @ingroup fand
+ *
+ * @file
+ * Source file for memory-mapped fan registers.
+ *
+ * The window is the whole file, mapped shared. Every access is a single
+ * volatile load or store of the register's width, so that the compiler
+ * neither merges nor reorders them; a masked write is a load, then a
+ * store.
+ ***************************************************************************/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "util.h"
+#include "openvswitch/vlog.h"
+#include "fanmmio.h"
+
+VLOG_DEFINE_THIS_MODULE(fanmmio);
+
+struct fand_mmio {
+    char *device;
+    char *path;
+    volatile uint8_t *base;
+    size_t size;
+    unsigned long long int n_reads;
+    unsigned long long int n_writes;
+};
+
+struct fand_mmio *
+fand_mmio_open(const char *device, const char *path)
+{
+    struct fand_mmio *mmio;
+    struct stat st;
+    void *base;
+    int fd;
+
+    fd = open(path, O_RDWR | O_SYNC | O_CLOEXEC);
+    if (fd < 0) {
+        VLOG_ERR("unable to open register window %s (%s)",
+                 path, ovs_strerror(errno));
+        return(NULL);
+    }
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+        VLOG_ERR("register window %s has no size", path);
+        close(fd);
+        return(NULL);
+    }
+
+    base = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    /* the mapping holds its own reference to the file */
+    close(fd);
+    if (base == MAP_FAILED) {
+        VLOG_ERR("unable to map register window %s (%s)",
+                 path, ovs_strerror(errno));
+        return(NULL);
+    }
+
+    mmio = xzalloc(sizeof(*mmio));
+    mmio->device = xstrdup(device);
+    mmio->path = xstrdup(path);
+    mmio->base = base;
+    mmio->size = st.st_size;
+
+    VLOG_INFO("device %s: registers mapped from %s (%zu bytes)",
+              device, path, mmio->size);
+
+    return(mmio);
+}
+
+void
+fand_mmio_close(struct fand_mmio *mmio)
+{
+    if (mmio == NULL) {
+        return;
+    }
+
+    munmap((void *)mmio->base, mmio->size);
+    free(mmio->device);
+    free(mmio->path);
+    free(mmio);
+}
+
+const char *
+fand_mmio_device(const struct fand_mmio *mmio)
+{
+    return(mmio->device);
+}
+
+static volatile void *
+fand_mmio_register(const struct fand_mmio *mmio, const i2c_bit_op *op)
+{
+    size_t size = op->register_size;
+    size_t address = op->register_address;
+
+    if ((size != 1 && size != 2 && size != 4) || address % size != 0 ||
+            address + size > mmio->size) {
+        return(NULL);
+    }
+
+    return(mmio->base + address);
+}
+
+static uint32_t
+fand_mmio_load(volatile void *reg, int size)
+{
+    switch (size) {
+    case 1:
+        return(*(volatile uint8_t *)reg);
+    case 2:
+        return(*(volatile uint16_t *)reg);
+    default:
+        return(*(volatile uint32_t *)reg);
+    }
+}
+
+static void
+fand_mmio_store(volatile void *reg, int size, uint32_t value)
+{
+    switch (size) {
+    case 1:
+        *(volatile uint8_t *)reg = value;
+        break;
+    case 2:
+        *(volatile uint16_t *)reg = value;
+        break;
+    default:
+        *(volatile uint32_t *)reg = value;
+        break;
+    }
+}
+
+int
+fand_mmio_read(struct fand_mmio *mmio, const i2c_bit_op *op, uint32_t *value)
+{
+    volatile void *reg = fand_mmio_register(mmio, op);
+
+    if (reg == NULL) {
+        return(-EINVAL);
+    }
+
+    *value = fand_mmio_load(reg, op->register_size) & op->bit_mask;
+    mmio->n_reads++;
+
+    return(0);
+}
+
+int
+fand_mmio_write(struct fand_mmio *mmio, const i2c_bit_op *op, uint32_t value)
+{
+    volatile void *reg = fand_mmio_register(mmio, op);
+    uint32_t width_mask;
+    uint32_t old;
+
+    if (reg == NULL) {
+        return(-EINVAL);
+    }
+
+    width_mask = op->register_size == 4 ? 0xffffffff
+                                        : (1u << (8 * op->register_size)) - 1;
+    if ((op->bit_mask & width_mask) != width_mask) {
+        old = fand_mmio_load(reg, op->register_size);
+        value = (old & ~op->bit_mask) | (value & op->bit_mask);
+    }
+    fand_mmio_store(reg, op->register_size, value);
+    mmio->n_writes++;
+
+    return(0);
+}
+
+void
+fand_mmio_format(const struct fand_mmio *mmio, struct ds *ds)
+{
+    ds_put_format(ds, "%s at %s (%zu bytes, %llu reads, %llu writes)",
+                  mmio->device, mmio->path, mmio->size,
+                  mmio->n_reads, mmio->n_writes);
+}
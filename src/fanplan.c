@@ -0,0 +1,125 @@
+/*
+ *  (c) Copyright 2015 Hewlett Packard Enterprise Development LP
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License. You may obtain
+ *  a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *  License for the specific language governing permissions and limitations
+ *  under the License.
+ */
+
+/************************************************************************//**
+ * @ingroup fand
+ *
+ * @file
+ * Source file for the per-poll sampling plan of a subsystem.
+ *
+ * Fan controllers usually sit behind i2c muxes. Reading the fans one after
+ * the other switches the mux back and forth between channels, which costs
+ * a mux write each time. The plan lists the register accesses of a poll,
+ * sorted by mux path (the bus of the device), then device and register, so
+ * that each channel is selected once per poll.
+ *
+ * The sort is by tier first. FRU presence comes first, since the fans of
+ * an absent FRU aren't read, then the fault bits, the tach registers, and
+ * the airflow direction, which hardly ever changes, last. When a poll has
+ * a time budget, the samples that don't fit are left for the next poll,
+ * and the tiers keep it from being the important ones. Each tier selects a
+ * channel once. A poll without a budget reads all of it anyway, in a single
+ * pass by mux path that ignores the tiers, so that a channel is selected
+ * once. The fans of a FRU found absent in that pass are dropped afterwards.
+ ***************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "fanplan.h"
+
+int
+fan_sample_tier(enum fan_sample_kind kind)
+{
+    switch (kind) {
+    case FAN_SAMPLE_PRESENT:
+        return(0);
+    case FAN_SAMPLE_FAULT:
+    case FAN_SAMPLE_CONTROL:
+        return(1);
+    case FAN_SAMPLE_RPM:
+        return(2);
+    case FAN_SAMPLE_DIRECTION:
+    default:
+        return(3);
+    }
+}
+
+const char *
+fan_plan_mux_path(YamlConfigHandle handle, const char *subsystem_name,
+                  const i2c_bit_op *op)
+{
+    const YamlDevice *device;
+
+    device = yaml_find_device(handle, subsystem_name, op->device);
+    if (device == NULL || device->bus == NULL) {
+        return("");
+    }
+
+    return(device->bus);
+}
+
+static int
+fan_plan_compare_path(const void *a_, const void *b_)
+{
+    const struct fan_sample *a = a_;
+    const struct fan_sample *b = b_;
+    int cmp;
+
+    cmp = strcmp(a->mux_path, b->mux_path);
+    if (cmp == 0) {
+        cmp = strcmp(a->op->device, b->op->device);
+    }
+    if (cmp == 0 && a->op->register_address != b->op->register_address) {
+        cmp = a->op->register_address < b->op->register_address ? -1 : 1;
+    }
+    /* keep the order stable, so that every poll is the same */
+    if (cmp == 0 && a->kind != b->kind) {
+        cmp = a->kind < b->kind ? -1 : 1;
+    }
+    if (cmp == 0 && a->idx != b->idx) {
+        cmp = a->idx < b->idx ? -1 : 1;
+    }
+
+    return(cmp);
+}
+
+static int
+fan_plan_compare(const void *a_, const void *b_)
+{
+    const struct fan_sample *a = a_;
+    const struct fan_sample *b = b_;
+    int cmp;
+
+    cmp = fan_sample_tier(a->kind) - fan_sample_tier(b->kind);
+    if (cmp == 0) {
+        cmp = fan_plan_compare_path(a, b);
+    }
+
+    return(cmp);
+}
+
+void
+fan_plan_sort(struct fan_sample *samples, size_t n)
+{
+    qsort(samples, n, sizeof(*samples), fan_plan_compare);
+}
+
+void
+fan_plan_sort_by_path(struct fan_sample *samples, size_t n)
+{
+    qsort(samples, n, sizeof(*samples), fan_plan_compare_path);
+}
@@ -0,0 +1,280 @@
+/*
+ *  (c) Copyright 2015 Hewlett Packard Enterprise Development LP
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License. You may obtain
+ *  a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *  License for the specific language governing permissions and limitations
+ *  under the License.
+ */
+
+/************************************************************************//**
+ * @ingroup fand
+ *
+ * @file
+ * Source file for loading and calling vendor driver plugins.
+ *
+ * A plugin is loaded the first time a hardware description selects it,
+ * and stays loaded. What its hooks read and write goes into a --record
+ * trace as registers of a device named "plugin:NAME": the rpm of fan i at
+ * register 2i, its status at 2i+1, the speed setting at register
+ * FAND_PLUGIN_SPEED_REG, and the LED statuses as writes of the status of
+ * FRU i at FAND_PLUGIN_LEDS_REG + i and of the subsystem's at
+ * FAND_PLUGIN_LEDS_REG + 0xff. A replay answers from the trace and never
+ * calls the plugin's hooks, but it needs the plugin, to know which hooks it
+ * has.
+ ***************************************************************************/
+
+#include <dlfcn.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "shash.h"
+#include "util.h"
+#include "openvswitch/vlog.h"
+#include "fanarena.h"
+#include "fanplugin.h"
+#include "fanrecord.h"
+#include "fantrace.h"
+
+VLOG_DEFINE_THIS_MODULE(fanplugin);
+
+#ifndef FAND_PLUGIN_DIR
+#define FAND_PLUGIN_DIR "/usr/lib/ops-fand"
+#endif
+
+/* the file of a hardware description that selects a plugin */
+#define FAND_PLUGIN_FILE "fand-plugin"
+
+#define FAND_PLUGIN_SPEED_REG 0xffff
+#define FAND_PLUGIN_LEDS_REG  0xfe00
+
+/* the plugins loaded so far, by path; NULL for one that failed */
+static struct shash plugins = SHASH_INITIALIZER(&plugins);
+
+static const struct fand_plugin_ops *
+fand_plugin_load(const char *name)
+{
+    fand_plugin_init_func *init;
+    const struct fand_plugin_ops *ops = NULL;
+    struct shash_node *node;
+    void *handle;
+    char *path;
+
+    path = strchr(name, '/') ? xstrdup(name)
+                             : xasprintf("%s/%s.so", FAND_PLUGIN_DIR, name);
+    node = shash_find(&plugins, path);
+    if (node != NULL) {
+        free(path);
+        return(node->data);
+    }
+
+    handle = dlopen(path, RTLD_NOW | RTLD_LOCAL);
+    if (handle == NULL) {
+        VLOG_ERR("unable to load fan plugin %s (%s)", path, dlerror());
+        goto out;
+    }
+
+    init = (fand_plugin_init_func *)dlsym(handle, "fand_plugin_init");
+    ops = init ? init() : NULL;
+    if (ops == NULL || ops->api_version != FAND_PLUGIN_API_VERSION) {
+        VLOG_ERR("fan plugin %s: missing fand_plugin_init or wrong API "
+                 "version (expected %d)", path, FAND_PLUGIN_API_VERSION);
+        dlclose(handle);
+        ops = NULL;
+        goto out;
+    }
+
+    VLOG_INFO("loaded fan plugin %s from %s", ops->name, path);
+
+out:
+    /* a plugin that failed isn't tried again, until a restart */
+    shash_add(&plugins, path, ops);
+    free(path);
+    return(ops);
+}
+
+/* the plugin name in the hardware description, or NULL */
+static char *
+fand_plugin_selected(const char *hw_desc_dir)
+{
+    char line[256];
+    char *path;
+    FILE *file;
+    char *name = NULL;
+
+    path = xasprintf("%s/%s", hw_desc_dir, FAND_PLUGIN_FILE);
+    file = fopen(path, "r");
+    free(path);
+    if (file == NULL) {
+        return(NULL);
+    }
+
+    if (fgets(line, sizeof(line), file) != NULL) {
+        line[strcspn(line, " \t\r\n")] = '\0';
+        if (line[0] != '\0') {
+            name = xstrdup(line);
+        }
+    }
+    fclose(file);
+
+    return(name);
+}
+
+void
+fand_plugin_attach(struct locl_subsystem *subsystem)
+{
+    const struct fand_plugin_ops *ops;
+    char *name;
+
+    name = fand_plugin_selected(subsystem->hw_desc_dir);
+    if (name == NULL) {
+        return;
+    }
+    ops = fand_plugin_load(name);
+    free(name);
+    if (ops == NULL) {
+        return;
+    }
+
+    /* a replay doesn't touch the hardware */
+    if (!fand_replaying() && ops->open != NULL) {
+        subsystem->plugin_data = ops->open(subsystem->name,
+                                           subsystem->hw_desc_dir,
+                                           subsystem->n_frus,
+                                           subsystem->fru_first_fan);
+        if (subsystem->plugin_data == NULL) {
+            VLOG_WARN("subsystem %s: fan plugin %s declined it, using the "
+                      "hardware description registers", subsystem->name,
+                      ops->name);
+            return;
+        }
+    }
+
+    subsystem->plugin = ops;
+    subsystem->plugin_device = fand_arena_printf(subsystem->arena,
+                                                 "plugin:%s", ops->name);
+    subsystem->plugin_fru_status = fand_arena_alloc(subsystem->arena,
+                                                    subsystem->n_frus);
+}
+
+void
+fand_plugin_detach(struct locl_subsystem *subsystem)
+{
+    if (subsystem->plugin != NULL && subsystem->plugin->close != NULL &&
+            subsystem->plugin_data != NULL) {
+        subsystem->plugin->close(subsystem->plugin_data);
+    }
+    subsystem->plugin = NULL;
+    subsystem->plugin_data = NULL;
+}
+
+static void
+fand_plugin_op(const struct locl_subsystem *subsystem, uint32_t reg,
+               i2c_bit_op *op)
+{
+    op->device = subsystem->plugin_device;
+    op->register_address = reg;
+    op->register_size = 4;
+    op->bit_mask = 0xffffffff;
+}
+
+void
+fand_plugin_sample(struct locl_subsystem *subsystem)
+{
+    struct locl_fan_samples *samples = &subsystem->samples;
+    uint32_t status;
+    i2c_bit_op op;
+    size_t idx;
+
+    if (!fand_replaying()) {
+        FAND_SPAN_BEGIN(span);
+        subsystem->plugin->sample(subsystem->plugin_data, subsystem->n_fans,
+                                  samples->rpm_raw, samples->rpm_rc,
+                                  samples->status);
+        FAND_SPAN_END(span, "plugin_sample", subsystem->name, -1);
+    }
+
+    for (idx = 0; idx < subsystem->n_fans; idx++) {
+        if (fand_replaying()) {
+            fand_plugin_op(subsystem, 2 * idx, &op);
+            samples->rpm_rc[idx] = fand_replay_reg(false, subsystem->name,
+                                                   &op, &samples->rpm_raw[idx]);
+            fand_plugin_op(subsystem, 2 * idx + 1, &op);
+            fand_replay_reg(false, subsystem->name, &op, &status);
+            samples->status[idx] = status;
+        } else if (fand_recording()) {
+            fand_plugin_op(subsystem, 2 * idx, &op);
+            fand_record_reg(false, subsystem->name, &op, samples->rpm_rc[idx],
+                            samples->rpm_raw[idx]);
+            fand_plugin_op(subsystem, 2 * idx + 1, &op);
+            fand_record_reg(false, subsystem->name, &op, 0,
+                            samples->status[idx]);
+        }
+        samples->fresh[idx] |= 1 << FAN_SAMPLE_RPM | 1 << FAN_SAMPLE_FAULT;
+    }
+}
+
+int
+fand_plugin_set_speed(struct locl_subsystem *subsystem, uint32_t hw_value)
+{
+    i2c_bit_op op;
+    int rc;
+
+    fand_plugin_op(subsystem, FAND_PLUGIN_SPEED_REG, &op);
+    if (fand_replaying()) {
+        return(fand_replay_reg(true, subsystem->name, &op, &hw_value));
+    }
+
+    FAND_SPAN_BEGIN(span);
+    rc = subsystem->plugin->set_speed(subsystem->plugin_data, hw_value);
+    FAND_SPAN_END(span, "plugin_set_speed", subsystem->name, -1);
+    fand_record_reg(true, subsystem->name, &op, rc, hw_value);
+
+    return(rc);
+}
+
+int
+fand_plugin_set_leds(struct locl_subsystem *subsystem,
+                     uint8_t subsystem_status)
+{
+    uint32_t value;
+    i2c_bit_op op;
+    size_t idx;
+    int rc = 0;
+
+    if (!fand_replaying()) {
+        FAND_SPAN_BEGIN(span);
+        rc = subsystem->plugin->set_leds(subsystem->plugin_data,
+                                         subsystem->n_frus,
+                                         subsystem->plugin_fru_status,
+                                         subsystem_status);
+        FAND_SPAN_END(span, "plugin_set_leds", subsystem->name, -1);
+    }
+
+    for (idx = 0; idx < subsystem->n_frus; idx++) {
+        fand_plugin_op(subsystem, FAND_PLUGIN_LEDS_REG + idx, &op);
+        value = subsystem->plugin_fru_status[idx];
+        if (fand_replaying()) {
+            fand_replay_reg(true, subsystem->name, &op, &value);
+        } else {
+            fand_record_reg(true, subsystem->name, &op, 0, value);
+        }
+    }
+    /* the result of the call goes with the subsystem's status */
+    fand_plugin_op(subsystem, FAND_PLUGIN_LEDS_REG + 0xff, &op);
+    value = subsystem_status;
+    if (fand_replaying()) {
+        return(fand_replay_reg(true, subsystem->name, &op, &value));
+    }
+    fand_record_reg(true, subsystem->name, &op, rc, value);
+
+    return(rc);
+}
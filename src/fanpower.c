@@ -0,0 +1,228 @@
+/*
+ *  (c) Copyright 2015 Hewlett Packard Enterprise Development LP
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License. You may obtain
+ *  a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *  License for the specific language governing permissions and limitations
+ *  under the License.
+ */
+
+
+/************************************************************************//**
+ * @ingroup fand
+ *
+ * @file
+ * Source file for fan power and energy accounting.
+ *
+ * Each line of the fan-power file is "PATTERN WATTS RPM [STATIC_WATTS]": a
+ * fan whose hardware description name matches the glob PATTERN (the first
+ * line that matches) draws WATTS at RPM. Its power at r rpm is
+ * STATIC_WATTS + (WATTS - STATIC_WATTS) * (r / RPM)^3, and nothing at 0
+ * rpm. The power is integrated with the trapezoidal rule at every poll, so
+ * a change of speed is accounted for in the poll that sees it.
+ ***************************************************************************/
+
+#include <fnmatch.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "util.h"
+#include "openvswitch/vlog.h"
+#include "fanarena.h"
+#include "fanpower.h"
+
+VLOG_DEFINE_THIS_MODULE(fanpower);
+
+/* the file of a hardware description with the fan power models */
+#define FAND_POWER_FILE "fan-power"
+
+struct fand_power_model {
+    bool valid;                   /* a line of the file matched the fan */
+    double static_watts;          /* drawn at any rpm above 0 */
+    double k;                     /* the rest is k * rpm^3 */
+};
+
+struct fand_power {
+    struct fand_power_model *models; /* per fan */
+    double *watts;                /* per fan, at the last update */
+    double *joules;               /* per fan, since the subsystem was added */
+    long long int last_msec;      /* of the last update, or -1 */
+};
+
+/* find the model of a fan in the file. returns false if no line matches. */
+static bool
+fand_power_read_model(FILE *file, const char *path, const char *fan_name,
+                      struct fand_power_model *model)
+{
+    char line[256];
+    char pattern[128];
+    double watts, rpm, static_watts;
+    int n;
+
+    rewind(file);
+    while (fgets(line, sizeof(line), file) != NULL) {
+        line[strcspn(line, "#\r\n")] = '\0';
+        static_watts = 0;
+        n = sscanf(line, "%127s %lf %lf %lf", pattern, &watts, &rpm,
+                   &static_watts);
+        if (n <= 0) {
+            continue;
+        }
+        if (n < 3 || watts < static_watts || rpm <= 0 || static_watts < 0) {
+            VLOG_WARN("%s: invalid line \"%s\"", path, line);
+            continue;
+        }
+        if (fnmatch(pattern, fan_name, 0) == 0) {
+            model->valid = true;
+            model->static_watts = static_watts;
+            model->k = (watts - static_watts) / (rpm * rpm * rpm);
+            return(true);
+        }
+    }
+
+    return(false);
+}
+
+void
+fand_power_attach(struct locl_subsystem *subsystem)
+{
+    struct fand_arena *arena = subsystem->arena;
+    struct fand_power *power;
+    size_t n_fans = subsystem->n_fans;
+    size_t n_models = 0;
+    FILE *file;
+    char *path;
+    size_t idx;
+
+    path = xasprintf("%s/%s", subsystem->hw_desc_dir, FAND_POWER_FILE);
+    file = fopen(path, "r");
+    if (file == NULL) {
+        free(path);
+        return;
+    }
+
+    power = fand_arena_alloc(arena, sizeof(*power));
+    power->models = fand_arena_alloc(arena, n_fans * sizeof(*power->models));
+    power->watts = fand_arena_alloc(arena, n_fans * sizeof(double));
+    power->joules = fand_arena_alloc(arena, n_fans * sizeof(double));
+    power->last_msec = -1;
+
+    for (idx = 0; idx < n_fans; idx++) {
+        const char *name = subsystem->fans[idx].yaml_fan->name;
+
+        if (fand_power_read_model(file, path, name, &power->models[idx])) {
+            n_models++;
+        } else {
+            VLOG_WARN("subsystem %s: no power model for fan %s in %s",
+                      subsystem->name, name, path);
+        }
+    }
+    fclose(file);
+    free(path);
+
+    if (n_models > 0) {
+        subsystem->power = power;
+    }
+}
+
+static double
+fand_power_watts(const struct fand_power_model *model, int rpm)
+{
+    if (!model->valid || rpm <= 0) {
+        return(0);
+    }
+    return(model->static_watts + model->k * rpm * rpm * rpm);
+}
+
+void
+fand_power_update(struct locl_subsystem *subsystem, long long int now)
+{
+    struct fand_power *power = subsystem->power;
+    double seconds;
+    size_t idx;
+
+    if (power == NULL) {
+        return;
+    }
+
+    seconds = power->last_msec < 0 ? 0 : (now - power->last_msec) / 1000.0;
+    power->last_msec = now;
+
+    for (idx = 0; idx < subsystem->n_fans; idx++) {
+        double watts = fand_power_watts(&power->models[idx],
+                                        subsystem->fan_state.rpm[idx]);
+
+        power->joules[idx] += (power->watts[idx] + watts) / 2 * seconds;
+        power->watts[idx] = watts;
+    }
+}
+
+double
+fand_power_fan_watts(const struct locl_subsystem *subsystem, size_t idx)
+{
+    return(subsystem->power ? subsystem->power->watts[idx] : 0);
+}
+
+double
+fand_power_fan_joules(const struct locl_subsystem *subsystem, size_t idx)
+{
+    return(subsystem->power ? subsystem->power->joules[idx] : 0);
+}
+
+static void
+fand_power_put(struct ds *ds, double watts, double joules)
+{
+    ds_put_format(ds, "%.1f W, %.3f Wh", watts, joules / 3600);
+}
+
+void
+fand_power_format(const struct locl_subsystem *subsystem, bool fans,
+                  struct ds *ds)
+{
+    const struct fand_power *power = subsystem->power;
+    double watts = 0, joules = 0;
+    size_t fru, idx;
+
+    if (power == NULL) {
+        ds_put_cstr(ds, "no power model");
+        return;
+    }
+
+    for (idx = 0; idx < subsystem->n_fans; idx++) {
+        watts += power->watts[idx];
+        joules += power->joules[idx];
+    }
+    fand_power_put(ds, watts, joules);
+    if (!fans) {
+        return;
+    }
+    ds_put_cstr(ds, "\n");
+
+    for (fru = 0; fru < subsystem->n_frus; fru++) {
+        size_t first = subsystem->fru_first_fan[fru];
+        size_t end = subsystem->fru_first_fan[fru + 1];
+
+        watts = joules = 0;
+        for (idx = first; idx < end; idx++) {
+            watts += power->watts[idx];
+            joules += power->joules[idx];
+        }
+        ds_put_format(ds, "    FRU %d: ", subsystem->frus[fru]->number);
+        fand_power_put(ds, watts, joules);
+        ds_put_cstr(ds, "\n");
+
+        for (idx = first; idx < end; idx++) {
+            ds_put_format(ds, "        %s: ", subsystem->fans[idx].name);
+            fand_power_put(ds, power->watts[idx], power->joules[idx]);
+            ds_put_format(ds, " (%d rpm)\n", subsystem->fan_state.rpm[idx]);
+        }
+    }
+}
@@ -0,0 +1,821 @@
+/*
+ *  (c) Copyright 2015 Hewlett Packard Enterprise Development LP
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License. You may obtain
+ *  a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *  License for the specific language governing permissions and limitations
+ *  under the License.
+ */
+
+/************************************************************************//**
+ * @ingroup fand
+ *
+ * @file
+ * Source file for recording and replaying the daemon's inputs.
+ *
+ * The trace starts with an 8 byte magic, followed by records made of a one
+ * byte type, a two byte payload length and the payload. All integers are
+ * little-endian, so that a trace taken on the switch can be replayed on any
+ * host. Strings are a two byte length followed by the bytes; subsystem and
+ * device names are sent once as a STRING record and then referred to by id.
+ *
+ *     TICK        i64 time
+ *     STRING      u16 id, str
+ *     READ/WRITE  u16 subsystem, u16 device, u32 address, u8 size,
+ *                 u32 mask, i32 rc, u32 value
+ *     EVENT       u16 subsystem
+ *     SUBSYSTEM   u16 name, str hw_desc_dir, u16 n, n * (str key, str value),
+ *                 u16 m, m * str fan_state
+ *     INPUTS_END  (empty, ends a complete set of SUBSYSTEM records)
+ *     LOAD        u64 bytes, u64 capacity_bps, u32 stats_msec (interface
+ *                 load sample, and the statistics refresh interval)
+ *
+ * Within a tick, the replayed register accesses and events are matched to
+ * the recorded ones by their address rather than by their order, since the
+ * order in which the subsystems are walked isn't the same from run to run.
+ ***************************************************************************/
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "shash.h"
+#include "timeval.h"
+#include "util.h"
+#include "openvswitch/vlog.h"
+#include "fanrecord.h"
+
+VLOG_DEFINE_THIS_MODULE(fanrecord);
+
+static struct vlog_rate_limit rl = VLOG_RATE_LIMIT_INIT(1, 5);
+
+#define FAND_RECORD_MAGIC  "FANDREC1"
+#define FAND_RECORD_MAGIC_LEN  8
+
+enum fand_record_type {
+    FAND_REC_TICK = 1,
+    FAND_REC_STRING = 2,
+    FAND_REC_READ = 3,
+    FAND_REC_WRITE = 4,
+    FAND_REC_EVENT = 5,
+    FAND_REC_SUBSYSTEM = 6,
+    FAND_REC_INPUTS_END = 7,
+    FAND_REC_LOAD = 8
+};
+
+/* a recorded register access of the current replay tick */
+struct fand_replay_op {
+    bool write;
+    bool used;
+    const char *subsystem_name;
+    const char *device;
+    uint32_t address;
+    int size;
+    uint32_t mask;
+    int rc;
+    uint32_t value;
+};
+
+/* a recorded presence event of the current replay tick */
+struct fand_replay_ev {
+    const char *subsystem_name;
+    bool used;
+};
+
+/* a cursor over the payload of one record */
+struct fand_record_reader {
+    const uint8_t *p;
+    const uint8_t *end;
+    bool error;
+};
+
+static long long int clock_msec = 0;
+
+/* recording state */
+static FILE *record_file = NULL;
+static struct shash record_strings = SHASH_INITIALIZER(&record_strings);
+
+/* replay state */
+static FILE *replay_file = NULL;
+static struct svec replay_strings = SVEC_EMPTY_INITIALIZER;
+static bool replay_next_valid = false;
+static long long int replay_next_time;
+
+static struct fand_replay_op *replay_ops = NULL;
+static size_t replay_n_ops = 0, replay_allocated_ops = 0;
+static struct fand_replay_ev *replay_evs = NULL;
+static size_t replay_n_evs = 0, replay_allocated_evs = 0;
+static struct fand_replay_subsystem *replay_subsystems = NULL;
+static size_t replay_n_subsystems = 0, replay_allocated_subsystems = 0;
+static bool replay_inputs = false;
+/* the interface load sample of the current replay tick, if any */
+static bool replay_load = false;
+static uint64_t replay_load_bytes, replay_load_capacity;
+static uint32_t replay_load_stats_msec;
+
+/* replay results */
+static unsigned long long replay_ticks = 0;
+static unsigned long long replay_reads = 0;
+static unsigned long long replay_reads_missing = 0;
+static unsigned long long replay_writes = 0;
+static unsigned long long replay_writes_diverged = 0;
+static unsigned long long replay_writes_unreproduced = 0;
+static unsigned long long replay_events = 0;
+static unsigned long long replay_loads = 0;
+
+long long int
+fand_now(void)
+{
+    return(clock_msec || replay_file ? clock_msec : time_msec());
+}
+
+/* little-endian encoding helpers */
+static void
+put_u8(struct ds *ds, uint8_t value)
+{
+    ds_put_char(ds, (char)value);
+}
+
+static void
+put_u16(struct ds *ds, uint16_t value)
+{
+    put_u8(ds, value & 0xff);
+    put_u8(ds, value >> 8);
+}
+
+static void
+put_u32(struct ds *ds, uint32_t value)
+{
+    put_u16(ds, value & 0xffff);
+    put_u16(ds, value >> 16);
+}
+
+static void
+put_u64(struct ds *ds, uint64_t value)
+{
+    put_u32(ds, value & 0xffffffff);
+    put_u32(ds, value >> 32);
+}
+
+static void
+put_str(struct ds *ds, const char *s)
+{
+    size_t len = s ? strlen(s) : 0;
+
+    if (len > UINT16_MAX) {
+        len = UINT16_MAX;
+    }
+    put_u16(ds, len);
+    ds_put_buffer(ds, s, len);
+}
+
+static uint8_t
+get_u8(struct fand_record_reader *r)
+{
+    if (r->p >= r->end) {
+        r->error = true;
+        return(0);
+    }
+    return(*r->p++);
+}
+
+static uint16_t
+get_u16(struct fand_record_reader *r)
+{
+    uint16_t lo = get_u8(r);
+
+    return(lo | (uint16_t)get_u8(r) << 8);
+}
+
+static uint32_t
+get_u32(struct fand_record_reader *r)
+{
+    uint32_t lo = get_u16(r);
+
+    return(lo | (uint32_t)get_u16(r) << 16);
+}
+
+static uint64_t
+get_u64(struct fand_record_reader *r)
+{
+    uint64_t lo = get_u32(r);
+
+    return(lo | (uint64_t)get_u32(r) << 32);
+}
+
+/* returns a malloc'd copy of the next string */
+static char *
+get_str(struct fand_record_reader *r)
+{
+    uint16_t len = get_u16(r);
+    char *s;
+
+    if (r->error || r->end - r->p < len) {
+        r->error = true;
+        return(xstrdup(""));
+    }
+    s = xmemdup0((const char *)r->p, len);
+    r->p += len;
+
+    return(s);
+}
+
+static const char *
+get_string_ref(struct fand_record_reader *r)
+{
+    uint16_t id = get_u16(r);
+
+    if (r->error || id >= replay_strings.n) {
+        r->error = true;
+        return("");
+    }
+    return(replay_strings.names[id]);
+}
+
+/* recording */
+
+static void
+fand_record_put(enum fand_record_type type, const struct ds *payload)
+{
+    uint8_t header[3];
+
+    if (record_file == NULL) {
+        return;
+    }
+    if (payload->length > UINT16_MAX) {
+        VLOG_WARN_RL(&rl, "dropping oversized record of type %d", type);
+        return;
+    }
+
+    header[0] = type;
+    header[1] = payload->length & 0xff;
+    header[2] = payload->length >> 8;
+    if (fwrite(header, sizeof(header), 1, record_file) != 1 ||
+            (payload->length &&
+             fwrite(payload->string, payload->length, 1, record_file) != 1)) {
+        VLOG_ERR("error writing trace (%s), recording stopped",
+                 ovs_strerror(errno));
+        fand_record_close();
+    }
+}
+
+static uint16_t
+fand_record_string_id(const char *s)
+{
+    struct shash_node *node;
+    struct ds payload = DS_EMPTY_INITIALIZER;
+    uint16_t id;
+
+    node = shash_find(&record_strings, s);
+    if (node != NULL) {
+        return((uintptr_t)node->data);
+    }
+
+    id = shash_count(&record_strings);
+    shash_add(&record_strings, s, (void *)(uintptr_t)id);
+
+    put_u16(&payload, id);
+    put_str(&payload, s);
+    fand_record_put(FAND_REC_STRING, &payload);
+    ds_destroy(&payload);
+
+    return(id);
+}
+
+bool
+fand_record_open(const char *path)
+{
+    record_file = fopen(path, "wb");
+    if (record_file == NULL) {
+        VLOG_ERR("%s: cannot create trace (%s)", path, ovs_strerror(errno));
+        return(false);
+    }
+    if (fwrite(FAND_RECORD_MAGIC, FAND_RECORD_MAGIC_LEN, 1,
+               record_file) != 1) {
+        VLOG_ERR("%s: cannot write trace (%s)", path, ovs_strerror(errno));
+        fand_record_close();
+        return(false);
+    }
+
+    VLOG_INFO("recording inputs to %s", path);
+
+    return(true);
+}
+
+void
+fand_record_close(void)
+{
+    if (record_file != NULL) {
+        fclose(record_file);
+        record_file = NULL;
+    }
+    shash_clear(&record_strings);
+}
+
+bool
+fand_recording(void)
+{
+    return(record_file != NULL);
+}
+
+void
+fand_clock_tick(void)
+{
+    struct ds payload = DS_EMPTY_INITIALIZER;
+
+    if (replay_file != NULL) {
+        return;
+    }
+
+    clock_msec = time_msec();
+
+    if (record_file != NULL) {
+        /* flush the previous tick, so a crash loses at most one tick */
+        fflush(record_file);
+        put_u64(&payload, clock_msec);
+        fand_record_put(FAND_REC_TICK, &payload);
+        ds_destroy(&payload);
+    }
+}
+
+void
+fand_record_reg(bool write, const char *subsystem_name, const i2c_bit_op *op,
+                int rc, uint32_t value)
+{
+    struct ds payload = DS_EMPTY_INITIALIZER;
+    uint16_t subsystem_id;
+    uint16_t device_id;
+
+    if (record_file == NULL) {
+        return;
+    }
+
+    subsystem_id = fand_record_string_id(subsystem_name);
+    device_id = fand_record_string_id(op->device);
+
+    put_u16(&payload, subsystem_id);
+    put_u16(&payload, device_id);
+    put_u32(&payload, op->register_address);
+    put_u8(&payload, op->register_size);
+    put_u32(&payload, op->bit_mask);
+    put_u32(&payload, (uint32_t)rc);
+    put_u32(&payload, value);
+    fand_record_put(write ? FAND_REC_WRITE : FAND_REC_READ, &payload);
+    ds_destroy(&payload);
+}
+
+void
+fand_record_event(const char *subsystem_name)
+{
+    struct ds payload = DS_EMPTY_INITIALIZER;
+    uint16_t subsystem_id;
+
+    if (record_file == NULL) {
+        return;
+    }
+
+    subsystem_id = fand_record_string_id(subsystem_name);
+    put_u16(&payload, subsystem_id);
+    fand_record_put(FAND_REC_EVENT, &payload);
+    ds_destroy(&payload);
+}
+
+void
+fand_record_load(uint64_t bytes, uint64_t capacity_bps, uint32_t stats_msec)
+{
+    struct ds payload = DS_EMPTY_INITIALIZER;
+
+    if (record_file == NULL) {
+        return;
+    }
+
+    put_u64(&payload, bytes);
+    put_u64(&payload, capacity_bps);
+    put_u32(&payload, stats_msec);
+    fand_record_put(FAND_REC_LOAD, &payload);
+    ds_destroy(&payload);
+}
+
+void
+fand_record_subsystem(const char *name, const char *hw_desc_dir,
+                      const struct smap *other_config,
+                      const char **fan_states, size_t n_fan_states)
+{
+    struct ds payload = DS_EMPTY_INITIALIZER;
+    const struct smap_node *node;
+    uint16_t name_id;
+    size_t idx;
+
+    if (record_file == NULL) {
+        return;
+    }
+
+    name_id = fand_record_string_id(name);
+    put_u16(&payload, name_id);
+    put_str(&payload, hw_desc_dir);
+    put_u16(&payload, smap_count(other_config));
+    SMAP_FOR_EACH (node, other_config) {
+        put_str(&payload, node->key);
+        put_str(&payload, node->value);
+    }
+    put_u16(&payload, n_fan_states);
+    for (idx = 0; idx < n_fan_states; idx++) {
+        put_str(&payload, fan_states[idx]);
+    }
+    fand_record_put(FAND_REC_SUBSYSTEM, &payload);
+    ds_destroy(&payload);
+}
+
+void
+fand_record_inputs_end(void)
+{
+    struct ds payload = DS_EMPTY_INITIALIZER;
+
+    if (record_file != NULL) {
+        fand_record_put(FAND_REC_INPUTS_END, &payload);
+    }
+}
+
+/* replaying */
+
+bool
+fand_replay_open(const char *path)
+{
+    char magic[FAND_RECORD_MAGIC_LEN];
+
+    replay_file = fopen(path, "rb");
+    if (replay_file == NULL) {
+        VLOG_ERR("%s: cannot open trace (%s)", path, ovs_strerror(errno));
+        return(false);
+    }
+    if (fread(magic, sizeof(magic), 1, replay_file) != 1 ||
+            memcmp(magic, FAND_RECORD_MAGIC, sizeof(magic)) != 0) {
+        VLOG_ERR("%s: not an ops-fand trace", path);
+        fand_replay_close();
+        return(false);
+    }
+
+    return(true);
+}
+
+static void
+fand_replay_clear_subsystems(void)
+{
+    size_t idx;
+
+    for (idx = 0; idx < replay_n_subsystems; idx++) {
+        struct fand_replay_subsystem *subsystem = &replay_subsystems[idx];
+
+        free(subsystem->hw_desc_dir);
+        smap_destroy(&subsystem->other_config);
+        svec_destroy(&subsystem->fan_states);
+    }
+    replay_n_subsystems = 0;
+}
+
+void
+fand_replay_close(void)
+{
+    if (replay_file != NULL) {
+        fclose(replay_file);
+        replay_file = NULL;
+    }
+    fand_replay_clear_subsystems();
+    free(replay_subsystems);
+    free(replay_ops);
+    free(replay_evs);
+    svec_destroy(&replay_strings);
+}
+
+bool
+fand_replaying(void)
+{
+    return(replay_file != NULL);
+}
+
+/* read the next record; returns false at the end of the trace */
+static bool
+fand_replay_read(uint8_t *type, uint8_t *payload, uint16_t *length)
+{
+    uint8_t header[3];
+
+    if (fread(header, sizeof(header), 1, replay_file) != 1) {
+        return(false);
+    }
+    *type = header[0];
+    *length = header[1] | (uint16_t)header[2] << 8;
+    if (*length && fread(payload, *length, 1, replay_file) != 1) {
+        VLOG_WARN("trace ends with a truncated record");
+        return(false);
+    }
+
+    return(true);
+}
+
+static void
+fand_replay_add_subsystem(struct fand_record_reader *r)
+{
+    struct fand_replay_subsystem *subsystem;
+    uint16_t n;
+
+    if (replay_n_subsystems >= replay_allocated_subsystems) {
+        replay_subsystems = x2nrealloc(replay_subsystems,
+                                       &replay_allocated_subsystems,
+                                       sizeof(*replay_subsystems));
+    }
+    subsystem = &replay_subsystems[replay_n_subsystems++];
+    subsystem->name = get_string_ref(r);
+    subsystem->hw_desc_dir = get_str(r);
+    smap_init(&subsystem->other_config);
+    for (n = get_u16(r); n > 0 && !r->error; n--) {
+        char *key = get_str(r);
+        char *value = get_str(r);
+
+        smap_replace(&subsystem->other_config, key, value);
+        free(key);
+        free(value);
+    }
+    svec_init(&subsystem->fan_states);
+    for (n = get_u16(r); n > 0 && !r->error; n--) {
+        char *state = get_str(r);
+
+        svec_add(&subsystem->fan_states, state);
+        free(state);
+    }
+}
+
+/* handle a record that belongs to the current tick */
+static void
+fand_replay_record(uint8_t type, struct fand_record_reader *r)
+{
+    switch (type) {
+    case FAND_REC_STRING: {
+        uint16_t id = get_u16(r);
+        char *s = get_str(r);
+
+        if (id != replay_strings.n) {
+            r->error = true;
+        } else {
+            svec_add(&replay_strings, s);
+        }
+        free(s);
+        break;
+    }
+
+    case FAND_REC_READ:
+    case FAND_REC_WRITE: {
+        struct fand_replay_op *op;
+
+        if (replay_n_ops >= replay_allocated_ops) {
+            replay_ops = x2nrealloc(replay_ops, &replay_allocated_ops,
+                                    sizeof(*replay_ops));
+        }
+        op = &replay_ops[replay_n_ops++];
+        op->write = type == FAND_REC_WRITE;
+        op->used = false;
+        op->subsystem_name = get_string_ref(r);
+        op->device = get_string_ref(r);
+        op->address = get_u32(r);
+        op->size = get_u8(r);
+        op->mask = get_u32(r);
+        op->rc = (int32_t)get_u32(r);
+        op->value = get_u32(r);
+        break;
+    }
+
+    case FAND_REC_EVENT:
+        if (replay_n_evs >= replay_allocated_evs) {
+            replay_evs = x2nrealloc(replay_evs, &replay_allocated_evs,
+                                    sizeof(*replay_evs));
+        }
+        replay_evs[replay_n_evs].subsystem_name = get_string_ref(r);
+        replay_evs[replay_n_evs].used = false;
+        replay_n_evs++;
+        break;
+
+    case FAND_REC_SUBSYSTEM:
+        if (replay_inputs) {
+            /* a later set of inputs in the same tick replaces this one */
+            fand_replay_clear_subsystems();
+            replay_inputs = false;
+        }
+        fand_replay_add_subsystem(r);
+        break;
+
+    case FAND_REC_INPUTS_END:
+        replay_inputs = true;
+        break;
+
+    case FAND_REC_LOAD:
+        replay_load_bytes = get_u64(r);
+        replay_load_capacity = get_u64(r);
+        replay_load_stats_msec = get_u32(r);
+        replay_load = true;
+        break;
+
+    default:
+        VLOG_WARN_RL(&rl, "skipping unknown trace record type %d", type);
+        break;
+    }
+
+    if (r->error) {
+        VLOG_WARN_RL(&rl, "malformed trace record of type %d", type);
+    }
+}
+
+/* close out the current tick, counting the writes it didn't reproduce */
+static void
+fand_replay_end_tick(void)
+{
+    size_t idx;
+
+    for (idx = 0; idx < replay_n_ops; idx++) {
+        if (replay_ops[idx].write && !replay_ops[idx].used) {
+            replay_writes_unreproduced++;
+        }
+    }
+    replay_n_ops = 0;
+    replay_n_evs = 0;
+    replay_load = false;
+    if (replay_inputs) {
+        fand_replay_clear_subsystems();
+        replay_inputs = false;
+    }
+}
+
+bool
+fand_replay_next_tick(void)
+{
+    static uint8_t payload[UINT16_MAX];
+    uint16_t length;
+    uint8_t type;
+
+    fand_replay_end_tick();
+
+    /* skip to the first tick */
+    while (!replay_next_valid) {
+        if (!fand_replay_read(&type, payload, &length)) {
+            return(false);
+        }
+        struct fand_record_reader r = { payload, payload + length, false };
+        if (type == FAND_REC_TICK) {
+            replay_next_time = (long long int)get_u64(&r);
+            replay_next_valid = true;
+        } else {
+            fand_replay_record(type, &r);
+        }
+    }
+
+    clock_msec = replay_next_time;
+    replay_next_valid = false;
+    replay_ticks++;
+
+    /* load everything up to the next tick */
+    while (fand_replay_read(&type, payload, &length)) {
+        struct fand_record_reader r = { payload, payload + length, false };
+
+        if (type == FAND_REC_TICK) {
+            replay_next_time = (long long int)get_u64(&r);
+            replay_next_valid = true;
+            break;
+        }
+        fand_replay_record(type, &r);
+    }
+
+    return(true);
+}
+
+bool
+fand_replay_has_inputs(void)
+{
+    return(replay_inputs);
+}
+
+size_t
+fand_replay_n_subsystems(void)
+{
+    return(replay_n_subsystems);
+}
+
+const struct fand_replay_subsystem *
+fand_replay_subsystem(size_t idx)
+{
+    return(&replay_subsystems[idx]);
+}
+
+static struct fand_replay_op *
+fand_replay_find_op(bool write, const char *subsystem_name,
+                    const i2c_bit_op *op)
+{
+    size_t idx;
+
+    for (idx = 0; idx < replay_n_ops; idx++) {
+        struct fand_replay_op *rec = &replay_ops[idx];
+
+        if (!rec->used && rec->write == write &&
+                rec->address == op->register_address &&
+                rec->size == op->register_size &&
+                rec->mask == op->bit_mask &&
+                strcmp(rec->device, op->device) == 0 &&
+                strcmp(rec->subsystem_name, subsystem_name) == 0) {
+            return(rec);
+        }
+    }
+
+    return(NULL);
+}
+
+int
+fand_replay_reg(bool write, const char *subsystem_name, const i2c_bit_op *op,
+                uint32_t *value)
+{
+    struct fand_replay_op *rec;
+
+    rec = fand_replay_find_op(write, subsystem_name, op);
+
+    if (write) {
+        replay_writes++;
+        if (rec == NULL || rec->value != *value) {
+            replay_writes_diverged++;
+            VLOG_DBG("tick %lld: write %s/%s 0x%x = 0x%x was not recorded",
+                     clock_msec, subsystem_name, op->device,
+                     op->register_address, *value);
+        }
+    } else {
+        replay_reads++;
+        if (rec == NULL) {
+            replay_reads_missing++;
+            *value = 0;
+            return(-EIO);
+        }
+        *value = rec->value;
+    }
+
+    if (rec == NULL) {
+        return(0);
+    }
+    rec->used = true;
+
+    return(rec->rc);
+}
+
+bool
+fand_replay_event(const char *subsystem_name)
+{
+    size_t idx;
+
+    for (idx = 0; idx < replay_n_evs; idx++) {
+        if (!replay_evs[idx].used &&
+                strcmp(replay_evs[idx].subsystem_name, subsystem_name) == 0) {
+            replay_evs[idx].used = true;
+            replay_events++;
+            return(true);
+        }
+    }
+
+    return(false);
+}
+
+bool
+fand_replay_load(uint64_t *bytes, uint64_t *capacity_bps,
+                 uint32_t *stats_msec)
+{
+    if (!replay_load) {
+        return(false);
+    }
+
+    replay_load = false;
+    replay_loads++;
+    *bytes = replay_load_bytes;
+    *capacity_bps = replay_load_capacity;
+    *stats_msec = replay_load_stats_msec;
+    return(true);
+}
+
+bool
+fand_replay_diverged(void)
+{
+    return(replay_reads_missing || replay_writes_diverged ||
+           replay_writes_unreproduced);
+}
+
+void
+fand_replay_report(struct ds *ds)
+{
+    ds_put_format(ds, "ticks: %llu\n", replay_ticks);
+    ds_put_format(ds, "register reads: %llu (%llu not in trace)\n",
+                  replay_reads, replay_reads_missing);
+    ds_put_format(ds, "register writes: %llu (%llu diverged, "
+                  "%llu recorded but not reproduced)\n", replay_writes,
+                  replay_writes_diverged, replay_writes_unreproduced);
+    ds_put_format(ds, "presence events: %llu\n", replay_events);
+    ds_put_format(ds, "load samples: %llu\n", replay_loads);
+}
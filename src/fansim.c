@@ -0,0 +1,315 @@
+/*
+ *  (c) Copyright 2015 Hewlett Packard Enterprise Development LP
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License. You may obtain
+ *  a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *  License for the specific language governing permissions and limitations
+ *  under the License.
+ */
+
+/************************************************************************//**
+ * @ingroup fand
+ *
+ * @file
+ * Source file for the simulated fan bus.
+ *
+ * Each simulated device is a flat array of byte registers. Multi-byte
+ * registers are little-endian (the byte at the lower address is the low
+ * byte), the same as a two-byte i2c read of adjacent registers.
+ *
+ * A device can also emulate a closed-loop fan controller: for each loop, a
+ * tach register follows a target register with a first order response, as
+ * a chip regulating the fan speed to the programmed tach count would.
+ ***************************************************************************/
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "shash.h"
+#include "timeval.h"
+#include "unixctl.h"
+#include "util.h"
+#include "openvswitch/vlog.h"
+#include "fansim.h"
+
+VLOG_DEFINE_THIS_MODULE(fansim);
+
+/* emulated closed-loop controllers per device, and their time constant */
+#define FANSIM_DEVICE_LOOPS     8
+#define FANSIM_LOOP_TAU_MSEC    500
+
+struct fansim_loop {
+    uint32_t target_reg;          /* tach count to regulate to */
+    uint32_t tach_reg;            /* follows target_reg */
+    int size;                     /* of both registers */
+    long long int last_msec;      /* when tach_reg was last updated */
+};
+
+struct fansim_device {
+    uint8_t regs[FANSIM_DEVICE_REGS];
+    uint8_t fail[FANSIM_DEVICE_REGS]; /* reads of a register left to fail */
+    size_t n_loops;
+    struct fansim_loop loops[FANSIM_DEVICE_LOOPS];
+};
+
+static bool sim_enabled = false;
+
+/* simulated devices, by "subsystem/device" */
+static struct shash sim_devices = SHASH_INITIALIZER(&sim_devices);
+
+static unixctl_cb_func fansim_unixctl_set;
+static unixctl_cb_func fansim_unixctl_get;
+static unixctl_cb_func fansim_unixctl_rpm_loop;
+
+static struct fansim_device *
+fansim_get_device(const char *subsystem_name, const char *device_name)
+{
+    struct fansim_device *device;
+    char key[128];
+
+    snprintf(key, sizeof(key), "%s/%s", subsystem_name, device_name);
+
+    device = shash_find_data(&sim_devices, key);
+    if (device == NULL) {
+        device = xzalloc(sizeof(*device));
+        shash_add(&sim_devices, key, device);
+    }
+
+    return(device);
+}
+
+static bool
+fansim_op_valid(const i2c_bit_op *op)
+{
+    return(op->register_size >= 1 && op->register_size <= 4 &&
+           op->register_address + op->register_size <= FANSIM_DEVICE_REGS);
+}
+
+static uint32_t
+fansim_get(const struct fansim_device *device, uint32_t address, int size)
+{
+    uint32_t value = 0;
+    int idx;
+
+    for (idx = 0; idx < size; idx++) {
+        value |= (uint32_t)device->regs[address + idx] << (8 * idx);
+    }
+
+    return(value);
+}
+
+static void
+fansim_put(struct fansim_device *device, uint32_t address, int size,
+           uint32_t value)
+{
+    int idx;
+
+    for (idx = 0; idx < size; idx++) {
+        device->regs[address + idx] = (value >> (8 * idx)) & 0xff;
+    }
+}
+
+/* move the tach registers toward their targets, for the time since the
+   last read */
+static void
+fansim_run_loops(struct fansim_device *device)
+{
+    long long int now = time_msec();
+    size_t idx;
+
+    for (idx = 0; idx < device->n_loops; idx++) {
+        struct fansim_loop *loop = &device->loops[idx];
+        long long int elapsed = now - loop->last_msec;
+        int64_t target, tach;
+
+        target = fansim_get(device, loop->target_reg, loop->size);
+        tach = fansim_get(device, loop->tach_reg, loop->size);
+        if (elapsed >= FANSIM_LOOP_TAU_MSEC * 5) {
+            tach = target;
+        } else {
+            /* a backward Euler step of the first order lag */
+            tach += (target - tach) * elapsed / (FANSIM_LOOP_TAU_MSEC +
+                                                 elapsed);
+        }
+        fansim_put(device, loop->tach_reg, loop->size, tach);
+        loop->last_msec = now;
+    }
+}
+
+void
+fansim_init(void)
+{
+    sim_enabled = true;
+
+    unixctl_command_register("ops-fand/sim-set",
+                             "subsystem device register value", 4, 4,
+                             fansim_unixctl_set, NULL);
+    unixctl_command_register("ops-fand/sim-get",
+                             "subsystem device register", 3, 3,
+                             fansim_unixctl_get, NULL);
+    unixctl_command_register("ops-fand/sim-rpm-loop",
+                             "subsystem device target-register "
+                             "tach-register size", 5, 5,
+                             fansim_unixctl_rpm_loop, NULL);
+
+    /* time/stop and time/warp put the daemon on a virtual clock, so a
+       simulation can run faster than real time */
+    timeval_dummy_register();
+
+    VLOG_INFO("using simulated fan bus");
+}
+
+bool
+fansim_enabled(void)
+{
+    return(sim_enabled);
+}
+
+int
+fansim_reg_read(const char *subsystem_name, const i2c_bit_op *op,
+                uint32_t *value)
+{
+    struct fansim_device *device;
+    int idx;
+
+    if (!fansim_op_valid(op)) {
+        return(-EINVAL);
+    }
+
+    device = fansim_get_device(subsystem_name, op->device);
+    for (idx = 0; idx < op->register_size; idx++) {
+        if (device->fail[op->register_address + idx] > 0) {
+            device->fail[op->register_address + idx]--;
+            return(-EIO);
+        }
+    }
+    fansim_run_loops(device);
+    *value = fansim_get(device, op->register_address,
+                        op->register_size) & op->bit_mask;
+
+    return(0);
+}
+
+int
+fansim_reg_write(const char *subsystem_name, const i2c_bit_op *op,
+                 uint32_t value)
+{
+    struct fansim_device *device;
+    uint32_t old;
+
+    if (!fansim_op_valid(op)) {
+        return(-EINVAL);
+    }
+
+    device = fansim_get_device(subsystem_name, op->device);
+    old = fansim_get(device, op->register_address, op->register_size);
+    fansim_put(device, op->register_address, op->register_size,
+               (old & ~op->bit_mask) | (value & op->bit_mask));
+
+    return(0);
+}
+
+void
+fansim_fail_reads(const char *subsystem_name, const i2c_bit_op *op,
+                  int count)
+{
+    struct fansim_device *device;
+
+    if (fansim_op_valid(op)) {
+        device = fansim_get_device(subsystem_name, op->device);
+        device->fail[op->register_address] = MIN(count, UINT8_MAX);
+    }
+}
+
+static bool
+fansim_parse_register(const char *arg, unsigned long *value,
+                      unsigned long max)
+{
+    char *end;
+
+    errno = 0;
+    *value = strtoul(arg, &end, 0);
+
+    return(errno == 0 && *end == '\0' && end != arg && *value <= max);
+}
+
+static void
+fansim_unixctl_set(struct unixctl_conn *conn, int argc OVS_UNUSED,
+                   const char *argv[], void *aux OVS_UNUSED)
+{
+    struct fansim_device *device;
+    unsigned long address;
+    unsigned long value;
+
+    if (!fansim_parse_register(argv[3], &address, FANSIM_DEVICE_REGS - 1) ||
+            !fansim_parse_register(argv[4], &value, 0xff)) {
+        unixctl_command_reply_error(conn, "invalid register or value");
+        return;
+    }
+
+    device = fansim_get_device(argv[1], argv[2]);
+    device->regs[address] = value;
+
+    unixctl_command_reply(conn, NULL);
+}
+
+static void
+fansim_unixctl_get(struct unixctl_conn *conn, int argc OVS_UNUSED,
+                   const char *argv[], void *aux OVS_UNUSED)
+{
+    const struct fansim_device *device;
+    unsigned long address;
+    char reply[16];
+
+    if (!fansim_parse_register(argv[3], &address, FANSIM_DEVICE_REGS - 1)) {
+        unixctl_command_reply_error(conn, "invalid register");
+        return;
+    }
+
+    device = fansim_get_device(argv[1], argv[2]);
+    snprintf(reply, sizeof(reply), "0x%02x", device->regs[address]);
+
+    unixctl_command_reply(conn, reply);
+}
+
+static void
+fansim_unixctl_rpm_loop(struct unixctl_conn *conn, int argc OVS_UNUSED,
+                        const char *argv[], void *aux OVS_UNUSED)
+{
+    struct fansim_device *device;
+    struct fansim_loop *loop;
+    unsigned long target_reg;
+    unsigned long tach_reg;
+    unsigned long size;
+
+    if (!fansim_parse_register(argv[5], &size, 4) || size == 0 ||
+            !fansim_parse_register(argv[3], &target_reg,
+                                   FANSIM_DEVICE_REGS - size) ||
+            !fansim_parse_register(argv[4], &tach_reg,
+                                   FANSIM_DEVICE_REGS - size)) {
+        unixctl_command_reply_error(conn, "invalid register or size");
+        return;
+    }
+
+    device = fansim_get_device(argv[1], argv[2]);
+    if (device->n_loops >= FANSIM_DEVICE_LOOPS) {
+        unixctl_command_reply_error(conn, "too many loops on this device");
+        return;
+    }
+
+    loop = &device->loops[device->n_loops++];
+    loop->target_reg = target_reg;
+    loop->tach_reg = tach_reg;
+    loop->size = size;
+    loop->last_msec = time_msec();
+
+    unixctl_command_reply(conn, NULL);
+}
@@ -0,0 +1,141 @@
+/*
+ *  (c) Copyright 2015 Hewlett Packard Enterprise Development LP
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License. You may obtain
+ *  a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *  License for the specific language governing permissions and limitations
+ *  under the License.
+ */
+
+/************************************************************************//**
+ * @ingroup fand
+ *
+ * @file
+ * Source file for span tracing of the control loop (FAND_TRACE builds).
+ *
+ * A span is a name, an optional argument (a subsystem or device name) and
+ * register, a start time and a duration. Spans go into a fixed ring buffer
+ * that overwrites the oldest one, so tracing never allocates and its cost
+ * is a clock read at each end of a span and a copy of the argument.
+ ***************************************************************************/
+
+#include <limits.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "timeval.h"
+#include "fantrace.h"
+
+#define FAND_TRACE_SPANS    16384
+#define FAND_TRACE_ARG_LEN  32
+
+struct fand_trace_entry {
+    const char *name;             /* string literal */
+    char arg[FAND_TRACE_ARG_LEN];
+    int64_t reg;                  /* -1 if none */
+    long long int start_usec;
+    long long int dur_usec;
+};
+
+static struct fand_trace_entry trace_ring[FAND_TRACE_SPANS];
+static unsigned long long int trace_n = 0;   /* spans ever recorded */
+
+long long int
+fand_trace_clock(void)
+{
+    return(time_usec());
+}
+
+void
+fand_trace_span(const char *name, const char *arg, int64_t reg,
+                long long int start_usec)
+{
+    struct fand_trace_entry *entry;
+
+    entry = &trace_ring[trace_n++ % FAND_TRACE_SPANS];
+    entry->name = name;
+    entry->reg = reg;
+    entry->start_usec = start_usec;
+    entry->dur_usec = time_usec() - start_usec;
+    if (arg != NULL) {
+        strncpy(entry->arg, arg, sizeof(entry->arg) - 1);
+        entry->arg[sizeof(entry->arg) - 1] = '\0';
+    } else {
+        entry->arg[0] = '\0';
+    }
+}
+
+static void
+fand_trace_put_string(struct ds *ds, const char *string)
+{
+    const char *p;
+
+    ds_put_char(ds, '"');
+    for (p = string; *p; p++) {
+        if (*p == '"' || *p == '\\') {
+            ds_put_char(ds, '\\');
+            ds_put_char(ds, *p);
+        } else if ((unsigned char)*p < 0x20) {
+            ds_put_format(ds, "\\u%04x", (unsigned char)*p);
+        } else {
+            ds_put_char(ds, *p);
+        }
+    }
+    ds_put_char(ds, '"');
+}
+
+void
+fand_trace_dump(struct ds *ds, int seconds)
+{
+    unsigned long long int first = 0;
+    unsigned long long int idx;
+    long long int since = LLONG_MIN;
+    bool comma = false;
+    int pid = getpid();
+
+    if (trace_n > FAND_TRACE_SPANS) {
+        first = trace_n - FAND_TRACE_SPANS;
+    }
+    if (seconds > 0) {
+        since = time_usec() - seconds * 1000000LL;
+    }
+
+    ds_put_cstr(ds, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [");
+    for (idx = first; idx < trace_n; idx++) {
+        const struct fand_trace_entry *entry;
+
+        entry = &trace_ring[idx % FAND_TRACE_SPANS];
+        if (entry->start_usec < since) {
+            continue;
+        }
+
+        ds_put_format(ds, "%s\n{\"name\": \"%s\", \"ph\": \"X\", "
+                      "\"pid\": %d, \"tid\": 1, \"ts\": %lld, \"dur\": %lld",
+                      comma ? "," : "", entry->name, pid, entry->start_usec,
+                      entry->dur_usec);
+        if (entry->arg[0] != '\0' || entry->reg >= 0) {
+            ds_put_cstr(ds, ", \"args\": {");
+            if (entry->arg[0] != '\0') {
+                ds_put_cstr(ds, "\"on\": ");
+                fand_trace_put_string(ds, entry->arg);
+            }
+            if (entry->reg >= 0) {
+                ds_put_format(ds, "%s\"reg\": \"0x%llx\"",
+                              entry->arg[0] != '\0' ? ", " : "",
+                              (unsigned long long int)entry->reg);
+            }
+            ds_put_char(ds, '}');
+        }
+        ds_put_char(ds, '}');
+        comma = true;
+    }
+    ds_put_cstr(ds, "\n]}\n");
+}
@@ -0,0 +1,446 @@
+/*
+ *  (c) Copyright 2015 Hewlett Packard Enterprise Development LP
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License. You may obtain
+ *  a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *  License for the specific language governing permissions and limitations
+ *  under the License.
+ */
+
+
+/************************************************************************//**
+ * @ingroup fand
+ *
+ * @file
+ * Source file for fan wear accounting.
+ *
+ * The log is text, one line per update of a FRU's counters:
+ *
+ *     KEY RUN_MSEC SLOW NORMAL MEDIUM FAST MAX STARTS STOPS FAULTS HASH
+ *
+ * with the msec at each speed level in the middle, and the hash of the rest
+ * of the line at the end. Every line has the absolute values, so the last
+ * valid line of a FRU wins, and a line torn by a power loss (only the last
+ * one can be) is skipped. The changed counters are appended every
+ * FAND_WEAR_SYNC_MSEC, or at the next main loop iteration after a start,
+ * stop or fault, and synced to disk. When the log has grown to several
+ * times the number of FRUs, it is compacted: the current counters are
+ * written to a new file, which is synced and then renamed over the log.
+ *
+ * The hardware descriptions don't give a FRU serial number, so the key is
+ * the subsystem name and FRU number, "SUBSYSTEM/fru-N".
+ ***************************************************************************/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "hash.h"
+#include "shash.h"
+#include "util.h"
+#include "openvswitch/vlog.h"
+#include "fanarena.h"
+#include "fanwear.h"
+
+VLOG_DEFINE_THIS_MODULE(fanwear);
+
+/* how often changed counters are appended */
+#define FAND_WEAR_SYNC_MSEC     (5 * 60 * 1000)
+/* compact when the log has this many more lines than twice the FRUs */
+#define FAND_WEAR_COMPACT_SLACK 64
+
+#define FAND_WEAR_N_SPEEDS      (FAND_SPEED_MAX + 1)
+
+struct fand_wear_record {
+    char *key;
+    unsigned long long int run_msec;
+    unsigned long long int speed_msec[FAND_WEAR_N_SPEEDS];
+    unsigned int starts;
+    unsigned int stops;
+    unsigned int faults;
+    bool dirty;                   /* changed since it was last appended */
+};
+
+/* per FRU of a subsystem */
+struct fand_wear_fru {
+    struct fand_wear_record *record;
+    bool running;                 /* a fan of the FRU was turning */
+    bool faulted;                 /* a fan of the FRU was faulted */
+};
+
+struct fand_wear {
+    struct fand_wear_fru *frus;
+    long long int last_msec;      /* of the last update, or -1 */
+    enum fanspeed speed;          /* the speed level since then */
+};
+
+/* every FRU's counters, by key, including FRUs no longer present */
+static struct shash wear_records = SHASH_INITIALIZER(&wear_records);
+
+static char *log_path = NULL;
+static FILE *log_file = NULL;
+static size_t n_log_lines = 0;
+static long long int next_sync_msec = 0;
+static bool sync_pending = false;
+
+static struct fand_wear_record *
+fand_wear_find(const char *key)
+{
+    struct fand_wear_record *record;
+
+    record = shash_find_data(&wear_records, key);
+    if (record == NULL) {
+        record = xzalloc(sizeof(*record));
+        record->key = xstrdup(key);
+        shash_add(&wear_records, key, record);
+    }
+
+    return(record);
+}
+
+static void
+fand_wear_put_record(const struct fand_wear_record *record, struct ds *ds)
+{
+    size_t start = ds->length;
+    int speed;
+
+    ds_put_format(ds, "%s %llu", record->key, record->run_msec);
+    for (speed = 0; speed < FAND_WEAR_N_SPEEDS; speed++) {
+        ds_put_format(ds, " %llu", record->speed_msec[speed]);
+    }
+    ds_put_format(ds, " %u %u %u", record->starts, record->stops,
+                  record->faults);
+    ds_put_format(ds, " %08x\n", (unsigned int)
+                  hash_bytes(ds->string + start, ds->length - start, 0));
+}
+
+/* parse a line of the log into the counters of its FRU. returns false if
+   it isn't a valid line. */
+static bool
+fand_wear_parse_line(char *line)
+{
+    struct fand_wear_record parsed;
+    char key[128];
+    char *hash_start;
+    unsigned int hash;
+    int n;
+
+    line[strcspn(line, "\n")] = '\0';
+    hash_start = strrchr(line, ' ');
+    if (hash_start == NULL || sscanf(hash_start, " %x", &hash) != 1 ||
+            hash != hash_bytes(line, hash_start - line, 0)) {
+        return(false);
+    }
+
+    n = sscanf(line, "%127s %llu %llu %llu %llu %llu %llu %u %u %u", key,
+               &parsed.run_msec, &parsed.speed_msec[0],
+               &parsed.speed_msec[1], &parsed.speed_msec[2],
+               &parsed.speed_msec[3], &parsed.speed_msec[4], &parsed.starts,
+               &parsed.stops, &parsed.faults);
+    if (n != 10) {
+        return(false);
+    }
+
+    struct fand_wear_record *record = fand_wear_find(key);
+
+    parsed.key = record->key;
+    parsed.dirty = false;
+    *record = parsed;
+    return(true);
+}
+
+/* write every FRU's counters to a new log, and put it in place of the old
+   one. returns false, with the old log untouched, on failure. */
+static bool
+fand_wear_compact(void)
+{
+    struct ds ds = DS_EMPTY_INITIALIZER;
+    const struct shash_node *node;
+    char *tmp_path;
+    bool ok = false;
+    int fd;
+
+    SHASH_FOR_EACH(node, &wear_records) {
+        fand_wear_put_record(node->data, &ds);
+    }
+
+    tmp_path = xasprintf("%s.tmp", log_path);
+    fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        VLOG_WARN("unable to create %s (%s)", tmp_path, ovs_strerror(errno));
+        goto out;
+    }
+    if (write(fd, ds_cstr(&ds), ds.length) != (ssize_t)ds.length ||
+            fsync(fd) != 0) {
+        VLOG_WARN("unable to write %s (%s)", tmp_path, ovs_strerror(errno));
+        close(fd);
+        unlink(tmp_path);
+        goto out;
+    }
+    close(fd);
+
+    if (rename(tmp_path, log_path) != 0) {
+        VLOG_WARN("unable to rename %s to %s (%s)", tmp_path, log_path,
+                  ovs_strerror(errno));
+        unlink(tmp_path);
+        goto out;
+    }
+
+    n_log_lines = shash_count(&wear_records);
+    ok = true;
+
+out:
+    free(tmp_path);
+    ds_destroy(&ds);
+    return(ok);
+}
+
+void
+fand_wear_set_log(const char *path)
+{
+    free(log_path);
+    log_path = path ? xstrdup(path) : NULL;
+}
+
+void
+fand_wear_open(void)
+{
+    struct shash_node *node;
+    size_t n_invalid = 0;
+    char line[512];
+    FILE *file;
+
+    if (log_path == NULL || log_file != NULL) {
+        return;
+    }
+
+    /* a standby took its counters over from the log: start from there */
+    n_log_lines = 0;
+    file = fopen(log_path, "r");
+    if (file != NULL) {
+        while (fgets(line, sizeof(line), file) != NULL) {
+            if (fand_wear_parse_line(line)) {
+                n_log_lines++;
+            } else {
+                n_invalid++;
+            }
+        }
+        fclose(file);
+    } else if (errno != ENOENT) {
+        VLOG_WARN("unable to read %s (%s)", log_path, ovs_strerror(errno));
+    }
+    VLOG_INFO("restored the wear counters of %zu fan FRUs from %s",
+              shash_count(&wear_records), log_path);
+
+    SHASH_FOR_EACH(node, &wear_records) {
+        struct fand_wear_record *record = node->data;
+
+        record->dirty = false;
+    }
+
+    /* don't append after a torn line */
+    if (n_invalid > 0) {
+        VLOG_WARN("%s: skipped %zu invalid lines", log_path, n_invalid);
+        fand_wear_compact();
+    }
+
+    log_file = fopen(log_path, "a");
+    if (log_file == NULL) {
+        VLOG_WARN("unable to open %s (%s), fan wear will not be persisted",
+                  log_path, ovs_strerror(errno));
+    }
+}
+
+/* append the counters that changed, and sync them */
+static void
+fand_wear_sync(void)
+{
+    struct ds ds = DS_EMPTY_INITIALIZER;
+    struct shash_node *node;
+    size_t n_lines = 0;
+
+    SHASH_FOR_EACH(node, &wear_records) {
+        struct fand_wear_record *record = node->data;
+
+        if (record->dirty) {
+            fand_wear_put_record(record, &ds);
+            record->dirty = false;
+            n_lines++;
+        }
+    }
+
+    if (n_lines > 0) {
+        if (fputs(ds_cstr(&ds), log_file) == EOF || fflush(log_file) != 0 ||
+                fsync(fileno(log_file)) != 0) {
+            VLOG_WARN("unable to append to %s (%s)", log_path,
+                      ovs_strerror(errno));
+        }
+        n_log_lines += n_lines;
+    }
+    ds_destroy(&ds);
+
+    if (n_log_lines > 2 * shash_count(&wear_records) +
+                      FAND_WEAR_COMPACT_SLACK) {
+        fclose(log_file);
+        fand_wear_compact();
+        log_file = fopen(log_path, "a");
+        if (log_file == NULL) {
+            VLOG_WARN("unable to open %s (%s)", log_path,
+                      ovs_strerror(errno));
+        }
+    }
+}
+
+void
+fand_wear_close(void)
+{
+    if (log_file != NULL) {
+        fand_wear_sync();
+    }
+    if (log_file != NULL) {
+        fclose(log_file);
+        log_file = NULL;
+    }
+}
+
+void
+fand_wear_run(long long int now)
+{
+    if (log_file == NULL ||
+            (now < next_sync_msec && !sync_pending)) {
+        return;
+    }
+
+    next_sync_msec = now + FAND_WEAR_SYNC_MSEC;
+    sync_pending = false;
+    fand_wear_sync();
+}
+
+void
+fand_wear_attach(struct locl_subsystem *subsystem)
+{
+    struct fand_wear *wear;
+    char key[128];
+    size_t fru;
+
+    wear = fand_arena_alloc(subsystem->arena, sizeof(*wear));
+    wear->frus = fand_arena_alloc(subsystem->arena,
+                                  subsystem->n_frus * sizeof(*wear->frus));
+    wear->last_msec = -1;
+
+    for (fru = 0; fru < subsystem->n_frus; fru++) {
+        snprintf(key, sizeof(key), "%s/fru-%d", subsystem->name,
+                 subsystem->frus[fru]->number);
+        wear->frus[fru].record = fand_wear_find(key);
+    }
+
+    subsystem->wear = wear;
+}
+
+void
+fand_wear_update(struct locl_subsystem *subsystem, long long int now)
+{
+    const struct locl_fan_state *state = &subsystem->fan_state;
+    struct fand_wear *wear = subsystem->wear;
+    long long int elapsed;
+    bool first;
+    size_t fru, idx;
+
+    if (wear == NULL) {
+        return;
+    }
+
+    /* the first update only learns the state: a restart isn't a start */
+    first = wear->last_msec < 0;
+    elapsed = first ? 0 : now - wear->last_msec;
+    wear->last_msec = now;
+
+    for (fru = 0; fru < subsystem->n_frus; fru++) {
+        struct fand_wear_fru *wear_fru = &wear->frus[fru];
+        struct fand_wear_record *record = wear_fru->record;
+        bool running = false;
+        bool faulted = false;
+
+        /* pulling a running FRU stops it */
+        if (!subsystem->fru_present[fru]) {
+            if (!first && wear_fru->running) {
+                record->stops++;
+                record->dirty = true;
+                sync_pending = true;
+            }
+            wear_fru->running = wear_fru->faulted = false;
+            continue;
+        }
+
+        for (idx = subsystem->fru_first_fan[fru];
+                idx < subsystem->fru_first_fan[fru + 1]; idx++) {
+            running |= state->rpm[idx] > 0;
+            faulted |= state->status[idx] == FAND_STATUS_FAULT;
+        }
+
+        /* the time since the last poll counts at the state it ran in */
+        if (wear_fru->running && elapsed > 0) {
+            record->run_msec += elapsed;
+            record->speed_msec[wear->speed] += elapsed;
+            record->dirty = true;
+        }
+
+        if (!first && running != wear_fru->running) {
+            if (running) {
+                record->starts++;
+            } else {
+                record->stops++;
+            }
+            record->dirty = true;
+            sync_pending = true;
+        }
+        if (!first && faulted && !wear_fru->faulted) {
+            record->faults++;
+            record->dirty = true;
+            sync_pending = true;
+        }
+
+        wear_fru->running = running;
+        wear_fru->faulted = faulted;
+    }
+
+    wear->speed = subsystem->speed == FAND_SPEED_NONE ? FAND_SPEED_NORMAL
+                                                      : subsystem->speed;
+}
+
+void
+fand_wear_format(const struct locl_subsystem *subsystem, struct ds *ds)
+{
+    const struct fand_wear *wear = subsystem->wear;
+    size_t fru;
+    int speed;
+
+    if (wear == NULL) {
+        return;
+    }
+
+    for (fru = 0; fru < subsystem->n_frus; fru++) {
+        const struct fand_wear_record *record = wear->frus[fru].record;
+
+        ds_put_format(ds, "        FRU %d: %.2f h run (",
+                      subsystem->frus[fru]->number,
+                      record->run_msec / 3600000.0);
+        for (speed = 0; speed < FAND_WEAR_N_SPEEDS; speed++) {
+            ds_put_format(ds, "%s%s %.2f h", speed ? ", " : "",
+                          fan_speed_enum_to_string(speed),
+                          record->speed_msec[speed] / 3600000.0);
+        }
+        ds_put_format(ds, "), %u starts, %u stops, %u faults\n",
+                      record->starts, record->stops, record->faults);
+    }
+}
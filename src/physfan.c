@@ -21,35 +21,55 @@
  * Source file for set set fan speed functions.
  ***************************************************************************/
 
+#include <limits.h>
+#include <string.h>
+
+#include "timeval.h"
+#include "util.h"
 #include "openvswitch/vlog.h"
 #include "config-yaml.h"
 #include "fanspeed.h"
 #include "fandirection.h"
 #include "fand-locl.h"
+#include "fanbus.h"
+#include "fanhwmon.h"
+#include "fanplugin.h"
+#include "fanrecord.h"
+#include "physfan.h"
 #include "eventlog.h"
 
 VLOG_DEFINE_THIS_MODULE(physfan);
 
-/* global yaml config handle */
-extern YamlConfigHandle yaml_handle;
-
-static struct locl_fan *get_local_fan(struct locl_subsystem *subsystem,
-                                      const char *name)
+/* update the cached state of a fan, flagging it for publishing if any of
+   it changed */
+static void
+fand_store_fan_state(struct locl_fan *fan, int rpm, enum fanstatus status,
+                     enum fandirection direction)
 {
-    struct shash_node *node, *next;
-    struct locl_fan *fan = NULL;
-    char fullname[128];
-
-    snprintf(fullname, sizeof(fullname), "%s-%s",
-             subsystem->name, name);
+    struct locl_fan_state *state = &fan->subsystem->fan_state;
+    size_t idx = fan->idx;
 
-    SHASH_FOR_EACH_SAFE(node, next, &subsystem->subsystem_fans) {
-        fan = (struct locl_fan *)node->data;
-        if (strcmp(fan->name, fullname) == 0)
-            break;
+    if (state->rpm[idx] != rpm || state->status[idx] != status ||
+            state->direction[idx] != direction) {
+        state->rpm[idx] = rpm;
+        state->status[idx] = status;
+        state->direction[idx] = direction;
+        state->changed[idx] = fand_now();
+        state->dirty[idx] = true;
     }
+}
+
+void
+fand_fan_set_speed(struct locl_fan *fan, enum fanspeed speed)
+{
+    struct locl_fan_state *state = &fan->subsystem->fan_state;
+    size_t idx = fan->idx;
 
-    return fan;
+    if (state->speed[idx] != speed) {
+        state->speed[idx] = speed;
+        state->changed[idx] = fand_now();
+        state->dirty[idx] = true;
+    }
 }
 
 static int fand_set_led(struct locl_subsystem *subsystem,
@@ -70,32 +90,75 @@ static int fand_set_led(struct locl_subsystem *subsystem,
         ledval = fan_info->fan_led_values.fault;
         break;
     }
-    return i2c_reg_write(yaml_handle, subsystem->name, led, ledval);
+    return fand_reg_write(subsystem->yaml_handle, subsystem->name, led, ledval);
  }
 
+/* the status of a fan FRU is the worst status of its fans */
+static enum fanstatus
+fand_fru_status(const struct locl_subsystem *subsystem, size_t fru_idx)
+{
+    enum fanstatus status = FAND_STATUS_UNINITIALIZED;
+
+    for (size_t idx = subsystem->fru_first_fan[fru_idx];
+            idx < subsystem->fru_first_fan[fru_idx + 1]; idx++) {
+        if (subsystem->fan_state.status[idx] > status) {
+            status = subsystem->fan_state.status[idx];
+        }
+    }
+
+    return status;
+}
+
+static void
+fand_set_subsystem_led(struct locl_subsystem *subsystem,
+                       const YamlFanInfo *fan_info,
+                       enum fanstatus aggr_status)
+{
+    int rc;
+
+    if (fan_info->fan_led) {
+        rc = fand_set_led(subsystem, fan_info,
+                          fan_info->fan_led, aggr_status);
+        if (rc) {
+            VLOG_DBG("Unable to set subsystem %s fan status LED",
+                     subsystem->name);
+        }
+    }
+}
+
 void fand_set_fanleds(struct locl_subsystem *subsystem)
 {
     const YamlFanInfo *fan_info;
     enum fanstatus aggr_status = FAND_STATUS_UNINITIALIZED;
     int rc = 0;
 
-    fan_info = yaml_get_fan_info(yaml_handle, subsystem->name);
+    fan_info = subsystem->fan_info;
     if (fan_info == NULL) {
         VLOG_DBG("subsystem %s has no fan info", subsystem->name);
         return;
     }
 
-    for (size_t idx = 0; idx < fan_info->number_fan_frus; idx++) {
-        enum fanstatus status = FAND_STATUS_UNINITIALIZED;
-        const YamlFanFru *fru = yaml_get_fan_fru(yaml_handle,
-                                                 subsystem->name, idx);
-        for (size_t fan_idx = 0; fru->fans[fan_idx]; fan_idx++) {
-            const YamlFan *fan = fru->fans[fan_idx];
-            struct locl_fan *lfan = get_local_fan(subsystem, fan->name);
-            if (lfan && (lfan->status > status)) {
-                status = lfan->status;
-            }
+    if (FAND_PLUGIN_HAS(subsystem, set_leds)) {
+        for (size_t idx = 0; idx < subsystem->n_frus; idx++) {
+            enum fanstatus status = fand_fru_status(subsystem, idx);
+
+            subsystem->plugin_fru_status[idx] = status;
+            if (status > aggr_status)
+                aggr_status = status;
         }
+        rc = fand_plugin_set_leds(subsystem, aggr_status);
+        if (rc) {
+            VLOG_DBG("Unable to set subsystem %s fan status LEDs",
+                     subsystem->name);
+        }
+        return;
+    }
+
+    for (size_t order = 0; order < subsystem->n_frus; order++) {
+        size_t idx = subsystem->fru_order[order];
+        const YamlFanFru *fru = subsystem->frus[idx];
+        enum fanstatus status = fand_fru_status(subsystem, idx);
+
         if (status > aggr_status)
             aggr_status = status;
 
@@ -109,23 +172,148 @@ void fand_set_fanleds(struct locl_subsystem *subsystem)
         }
     }
 
-    if (fan_info->fan_led) {
-        rc = fand_set_led(subsystem, fan_info,
-                          fan_info->fan_led, aggr_status);
-        if (rc) {
-            VLOG_DBG("Unable to set subsystem %s fan status LED",
-                     subsystem->name);
+    fand_set_subsystem_led(subsystem, fan_info, aggr_status);
+}
+
+uint32_t
+fand_rpm_to_tach(const struct locl_subsystem *subsystem, uint32_t rpm)
+{
+    if (subsystem->multiplier) {
+        return(rpm / subsystem->multiplier);
+    }
+    if (subsystem->numerator && rpm) {
+        return(subsystem->numerator / rpm);
+    }
+
+    /* a stopped fan, or no conversion */
+    return(0);
+}
+
+/* the speed control register value for a speed setting. in target rpm
+   mode, the setting is an rpm, and the register holds the tach reading the
+   controller is to regulate to: the reverse of the rpm calculation. */
+static uint32_t
+fand_speed_control_value(const struct locl_subsystem *subsystem,
+                         uint32_t hw_speed_val)
+{
+    if (!subsystem->rpm_control) {
+        return(hw_speed_val);
+    }
+
+    /* a stopped fan, or no conversion: the largest count is the slowest */
+    if (!subsystem->multiplier &&
+            (!subsystem->numerator || !hw_speed_val)) {
+        return(UINT32_MAX);
+    }
+    return(fand_rpm_to_tach(subsystem, hw_speed_val));
+}
+
+static void
+fand_write_speed_control(struct locl_subsystem *subsystem,
+                         const i2c_bit_op *op, uint32_t hw_speed_val)
+{
+    fand_reg_write(subsystem->yaml_handle, subsystem->name, op,
+                   fand_speed_control_value(subsystem, hw_speed_val));
+}
+
+/* put the controller in or out of target rpm mode, through the bits of
+   fan_rpm_mode, when the mode changed */
+static void
+fand_write_rpm_mode(struct locl_subsystem *subsystem)
+{
+    uint32_t value;
+
+    if (subsystem->rpm_mode.device == NULL ||
+            subsystem->rpm_mode_on == subsystem->rpm_control) {
+        return;
+    }
+
+    value = subsystem->rpm_mode_value;
+    if (!subsystem->rpm_control) {
+        value = ~value & subsystem->rpm_mode.bit_mask;
+    }
+    if (fand_reg_write(subsystem->yaml_handle, subsystem->name,
+                       &subsystem->rpm_mode, value) == 0) {
+        subsystem->rpm_mode_on = subsystem->rpm_control;
+    }
+}
+
+/* in target rpm mode an hwmon driver regulates to fanN_target instead */
+static void
+fand_hwmon_set_speed(struct locl_subsystem *subsystem, uint32_t hw_speed_val)
+{
+    if (subsystem->rpm_control) {
+        fand_hwmon_set_target(subsystem->hwmon, hw_speed_val);
+    } else {
+        fand_hwmon_set_pwm(subsystem->hwmon, hw_speed_val);
+    }
+}
+
+/* write the speed control(s) that belong to a single fan FRU */
+static void
+fand_write_fru_fanspeed(struct locl_subsystem *subsystem,
+                        const YamlFanInfo *fan_info,
+                        const YamlFanFru *fru,
+                        uint32_t hw_speed_val)
+{
+    if (fan_info->fan_speed_control_type == PER_FRU) {
+        if (fru->fan_speed_control == NULL) {
+          VLOG_DBG("fan fru %d has no fan speed control", fru->number);
+          return;
         }
+        fand_write_speed_control(subsystem, fru->fan_speed_control,
+                                 hw_speed_val);
+    } else if (fan_info->fan_speed_control_type == PER_FAN) {
+       for (size_t fan_idx = 0; fru->fans[fan_idx]; fan_idx++) {
+            const YamlFan *fan = fru->fans[fan_idx];
+            if (fan->fan_speed_control == NULL) {
+                VLOG_DBG("fan %s has no fan speed control", fan->name);
+                continue;
+            }
+            fand_write_speed_control(subsystem, fan->fan_speed_control,
+                                     hw_speed_val);
+       }
     }
 }
 
-void
-fand_set_fanspeed(struct locl_subsystem *subsystem)
+/* the speed setting of a level: a duty value from the hardware
+   description, or in target rpm mode, the configured rpm */
+static uint32_t
+fand_speed_hw_value(const struct locl_subsystem *subsystem,
+                    enum fanspeed speed)
+{
+    const YamlFanInfo *fan_info = subsystem->fan_info;
+
+    if (subsystem->rpm_control) {
+        return(subsystem->rpm_targets[speed == FAND_SPEED_NONE ?
+                                      FAND_SPEED_NORMAL : speed]);
+    }
+
+    switch (speed) {
+        case FAND_SPEED_SLOW:
+            return fan_info->fan_speed_settings.slow;
+        case FAND_SPEED_MEDIUM:
+            return fan_info->fan_speed_settings.medium;
+        case FAND_SPEED_FAST:
+            return fan_info->fan_speed_settings.fast;
+        case FAND_SPEED_MAX:
+            return fan_info->fan_speed_settings.max;
+        case FAND_SPEED_NORMAL:
+        default:
+            return fan_info->fan_speed_settings.normal;
+    }
+}
+
+enum fanspeed
+fand_subsystem_speed(const struct locl_subsystem *subsystem)
 {
-    unsigned char hw_speed_val;
-    const YamlFanInfo *fan_info = NULL;
     enum fanspeed speed = subsystem->fan_speed_override;
 
+    /* the hardware says it's too hot, whatever the sensors say so far */
+    if (subsystem->thermal_alert) {
+        return FAND_SPEED_MAX;
+    }
+
     /* use override if it exists, unless the sensors think the speed should be
        "max" (potential overtemp situation). */
     if (speed == FAND_SPEED_NONE || subsystem->fan_speed == FAND_SPEED_MAX) {
@@ -136,11 +324,87 @@ fand_set_fanspeed(struct locl_subsystem *subsystem)
         speed = FAND_SPEED_NORMAL;
     }
 
-    /* set the speed value for record-keeping */
+    /* a load jump runs the fans ahead of the sensors (not of an override),
+       but max is for the sensors to ask for */
+    if (subsystem->load.boost > 0 && speed < FAND_SPEED_FAST &&
+            subsystem->fan_speed_override == FAND_SPEED_NONE) {
+        speed += subsystem->load.boost;
+        if (speed > FAND_SPEED_FAST) {
+            speed = FAND_SPEED_FAST;
+        }
+    }
+
+    /* the remaining fans make up for a faulted or missing one */
+    if (subsystem->degraded && subsystem->redundancy_step > 0) {
+        speed += subsystem->redundancy_step;
+        if (speed > FAND_SPEED_MAX) {
+            speed = FAND_SPEED_MAX;
+        }
+    }
+
+    return speed;
+}
+
+bool
+fand_subsystem_degraded(const struct locl_subsystem *subsystem)
+{
+    for (size_t idx = 0; idx < subsystem->n_fans; idx++) {
+        if (subsystem->fan_state.status[idx] == FAND_STATUS_FAULT) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool
+fand_check_redundancy(struct locl_subsystem *subsystem)
+{
+    bool degraded = fand_subsystem_degraded(subsystem);
+
+    if (degraded == subsystem->degraded) {
+        return false;
+    }
+    subsystem->degraded = degraded;
+
+    if (subsystem->redundancy_step == 0) {
+        return false;
+    }
+
+    VLOG_INFO("subsystem %s: %s fan speed after fan %s", subsystem->name,
+              degraded ? "raising" : "restoring",
+              degraded ? "fault" : "recovery");
+    log_event("FAN_REDUNDANCY", EV_KV("subsystem", "%s", subsystem->name),
+        EV_KV("state", "%s", degraded ? "degraded" : "restored"));
+
+    fand_set_fanspeed(subsystem);
+
+    return true;
+}
+
+void
+fand_set_fanspeed(struct locl_subsystem *subsystem)
+{
+    uint32_t hw_speed_val;
+    const char *speedval;
+    const YamlFanInfo *fan_info = NULL;
+    long long int now = fand_now();
+    enum fanspeed speed;
+
+    /* the governor holds off down-steps for a while */
+    speed = fan_governor_level(&subsystem->governor_state,
+                               &subsystem->governor,
+                               fand_subsystem_speed(subsystem), now);
+
+    /* set the speed value for record-keeping, and have the fans publish
+       it right away */
     subsystem->speed = speed;
+    for (size_t idx = 0; idx < subsystem->n_fans; idx++) {
+        fand_fan_set_speed(&subsystem->fans[idx], speed);
+    }
 
     /* get the fan speed control i2c operation */
-    fan_info = yaml_get_fan_info(yaml_handle, subsystem->name);
+    fan_info = subsystem->fan_info;
 
     if (fan_info == NULL) {
         VLOG_DBG("subsystem %s has no fan info", subsystem->name);
@@ -151,51 +415,54 @@ fand_set_fanspeed(struct locl_subsystem *subsystem)
     switch (speed) {
         case FAND_SPEED_NORMAL:
         default:
-            hw_speed_val = fan_info->fan_speed_settings.normal;
-            VLOG_DBG("subsystem %s: setting fan speed control register to NORMAL: 0x%x",
-                subsystem->name,
-                hw_speed_val);
-            log_event("FAN_SPEED", EV_KV("subsystem", "%s", subsystem->name),
-                EV_KV("speedval", "%s", "NORMAL"),
-                EV_KV("value", "0x%x", hw_speed_val));
+            speedval = "NORMAL";
             break;
         case FAND_SPEED_SLOW:
-            hw_speed_val = fan_info->fan_speed_settings.slow;
-            VLOG_DBG("subsystem %s: setting fan speed control register to SLOW: 0x%x",
-                subsystem->name,
-                hw_speed_val);
-            log_event("FAN_SPEED", EV_KV("subsystem", "%s", subsystem->name),
-                EV_KV("speedval", "%s", "SLOW"),
-                EV_KV("value", "0x%x", hw_speed_val));
+            speedval = "SLOW";
             break;
         case FAND_SPEED_MEDIUM:
-            hw_speed_val = fan_info->fan_speed_settings.medium;
-            VLOG_DBG("subsystem %s: setting fan speed control register to MEDIUM: 0x%x",
-                subsystem->name,
-                hw_speed_val);
-            log_event("FAN_SPEED", EV_KV("subsystem", "%s", subsystem->name),
-                EV_KV("speedval", "%s", "MEDIUM"),
-                EV_KV("value", "0x%x", hw_speed_val));
+            speedval = "MEDIUM";
             break;
         case FAND_SPEED_FAST:
-            hw_speed_val = fan_info->fan_speed_settings.fast;
-            VLOG_DBG("subsystem %s: setting fan speed control register to FAST: 0x%x",
-                subsystem->name,
-                hw_speed_val);
-            log_event("FAN_SPEED", EV_KV("subsystem", "%s", subsystem->name),
-                EV_KV("speedval", "%s", "FAST"),
-                EV_KV("value", "0x%x", hw_speed_val));
+            speedval = "FAST";
             break;
         case FAND_SPEED_MAX:
-            hw_speed_val = fan_info->fan_speed_settings.max;
-            VLOG_DBG("subsystem %s: setting fan speed control register to MAX: 0x%x",
-                subsystem->name,
-                hw_speed_val);
-            log_event("FAN_SPEED", EV_KV("subsystem", "%s", subsystem->name),
-                EV_KV("speedval", "%s", "MAX"),
-                EV_KV("value", "0x%x", hw_speed_val));
+            speedval = "MAX";
             break;
     }
+    hw_speed_val = fand_speed_hw_value(subsystem, speed);
+
+    /* only log a new setting: this runs on every reconfigure, and the
+       event log formatting allocates */
+    if ((int)hw_speed_val != subsystem->governor_state.hw_target) {
+        VLOG_DBG("subsystem %s: setting fan speed control register to %s: 0x%x",
+            subsystem->name,
+            speedval,
+            hw_speed_val);
+        log_event("FAN_SPEED", EV_KV("subsystem", "%s", subsystem->name),
+            EV_KV("speedval", "%s", speedval),
+            EV_KV("value", "0x%x", hw_speed_val));
+    }
+
+    /* while slewing, this is an intermediate value */
+    hw_speed_val = fan_governor_hw_value(&subsystem->governor_state,
+                                         &subsystem->governor,
+                                         hw_speed_val, now);
+
+    /* a vendor driver may set all of them with one command */
+    if (FAND_PLUGIN_HAS(subsystem, set_speed)) {
+        fand_plugin_set_speed(subsystem, hw_speed_val);
+        return;
+    }
+
+    /* an hwmon device has a pwm per fan (or one for all) */
+    if (subsystem->hwmon != NULL) {
+        fand_hwmon_set_speed(subsystem, hw_speed_val);
+        return;
+    }
+
+    /* before a tach count is written as a duty cycle, or the reverse */
+    fand_write_rpm_mode(subsystem);
 
     /* Fan speed may have one control per subsystem, per fru, or per fan. */
     if (fan_info->fan_speed_control_type == SINGLE) {
@@ -203,81 +470,149 @@ fand_set_fanspeed(struct locl_subsystem *subsystem)
             VLOG_DBG("subsystem %s has no fan speed control", subsystem->name);
             return;
         }
-        i2c_reg_write(yaml_handle, subsystem->name,
-                      fan_info->fan_speed_control, hw_speed_val);
+        fand_write_speed_control(subsystem, fan_info->fan_speed_control,
+                                 hw_speed_val);
         VLOG_DBG("FAN speed set to %#x", hw_speed_val);
     } else {
-        for (size_t idx = 0; idx < fan_info->number_fan_frus; idx++) {
-            const YamlFanFru *fru = yaml_get_fan_fru(yaml_handle,
-                                                     subsystem->name, idx);
-            if (fan_info->fan_speed_control_type == PER_FRU) {
-                if (fru->fan_speed_control == NULL) {
-                  VLOG_DBG("fan fru %d has no fan speed control", fru->number);
-                  continue;
-                }
-                i2c_reg_write(yaml_handle, subsystem->name,
-                              fru->fan_speed_control, hw_speed_val);
-            } else if (fan_info->fan_speed_control_type == PER_FAN) {
-               for (size_t fan_idx = 0; fru->fans[fan_idx]; fan_idx++) {
-                    const YamlFan *fan = fru->fans[fan_idx];
-                    if (fan->fan_speed_control == NULL) {
-                        VLOG_DBG("fan %s has no fan speed control", fan->name);
-                        continue;
-                    }
-                    i2c_reg_write(yaml_handle, subsystem->name,
-                                  fan->fan_speed_control, hw_speed_val);
-               }
-            } else {
-                VLOG_WARN("subsystem %s: invalid fan speed control type (%d)",
-                          subsystem->name,
-                          fan_info->fan_speed_control_type);
-                return;
-            }
+        if (fan_info->fan_speed_control_type != PER_FRU &&
+                fan_info->fan_speed_control_type != PER_FAN) {
+            VLOG_WARN("subsystem %s: invalid fan speed control type (%d)",
+                      subsystem->name,
+                      fan_info->fan_speed_control_type);
+            return;
+        }
+        for (size_t order = 0; order < subsystem->n_frus; order++) {
+            const YamlFanFru *fru = subsystem->frus[
+                                                subsystem->fru_order[order]];
+            fand_write_fru_fanspeed(subsystem, fan_info, fru, hw_speed_val);
         }
     }
 }
 
+void
+fand_resume_fanspeed(struct locl_subsystem *subsystem, enum fanspeed speed)
+{
+    const YamlFanInfo *fan_info;
+
+    subsystem->speed = speed;
+
+    fan_info = subsystem->fan_info;
+    if (fan_info != NULL) {
+        fan_governor_resume(&subsystem->governor_state, speed,
+                            fand_speed_hw_value(subsystem, speed));
+    }
+}
+
+/* The tach LSB and MSB registers can be fetched with a single two-byte
+   read if they are adjacent registers on the same device. Besides saving a
+   transaction, this keeps the counter from rolling over between the two
+   reads and producing a torn value. */
+static bool
+fand_tach_is_word(const YamlFan *fan)
+{
+    const i2c_bit_op *lsb = fan->fan_speed;
+    const i2c_bit_op *msb = fan->fan_speed_msb;
+
+    if (msb == NULL ||
+            lsb->register_size != 1 || msb->register_size != 1 ||
+            strcmp(lsb->device, msb->device) != 0) {
+        return(false);
+    }
+
+    return(msb->register_address == lsb->register_address + 1 ||
+           lsb->register_address == msb->register_address + 1);
+}
+
 static int
-fand_read_rpm(const char *subsystem_name, const YamlFan *fan)
+fand_read_rpm_word(const struct locl_subsystem *subsystem, const YamlFan *fan,
+                   uint32_t *raw)
+{
+    const i2c_bit_op *lsb = fan->fan_speed;
+    const i2c_bit_op *msb = fan->fan_speed_msb;
+    i2c_bit_op word_op = *lsb;
+    uint32_t word = 0;
+    uint32_t lsb_val;
+    uint32_t msb_val;
+    int rc;
+
+    word_op.register_address = MIN(lsb->register_address,
+                                   msb->register_address);
+    word_op.register_size = 2;
+    word_op.bit_mask = 0xffff;
+
+    rc = fand_reg_read(subsystem->yaml_handle, subsystem->name,
+                       &word_op, &word);
+    if (rc != 0) {
+        return(rc);
+    }
+
+    /* the byte at the lower register address is the low byte of the
+       returned value */
+    if (lsb->register_address < msb->register_address) {
+        lsb_val = word & 0xff;
+        msb_val = (word >> 8) & 0xff;
+    } else {
+        lsb_val = (word >> 8) & 0xff;
+        msb_val = word & 0xff;
+    }
+
+    *raw = (lsb_val & lsb->bit_mask) + ((msb_val & msb->bit_mask) << 8);
+    return(0);
+}
+
+static int
+fand_read_rpm(const struct locl_subsystem *subsystem, const YamlFan *fan,
+              uint32_t *raw)
 {
     uint32_t dword = 0;
-    uint32_t rpm;
     int rc;
 
-    rc = i2c_reg_read(yaml_handle, subsystem_name, fan->fan_speed, &dword);
+    if (subsystem->tach_word_read && fand_tach_is_word(fan)) {
+        rc = fand_read_rpm_word(subsystem, fan, raw);
+        if (rc != 0) {
+            VLOG_WARN("subsystem %s: unable to read fan %s rpm (%d)",
+                      subsystem->name,
+                      fan->name,
+                      rc);
+        }
+        return(rc);
+    }
+
+    rc = fand_reg_read(subsystem->yaml_handle, subsystem->name,
+                       fan->fan_speed, &dword);
 
     if (rc != 0) {
         VLOG_WARN("subsystem %s: unable to read fan %s rpm (%d)",
-            subsystem_name,
+            subsystem->name,
             fan->name,
             rc);
-        return(0);
+        return(rc);
     }
 
     /* Least significant byte */
-    rpm = dword;
+    *raw = dword;
 
     if (fan->fan_speed_msb) {
-        rc = i2c_reg_read(yaml_handle, subsystem_name,
-                          fan->fan_speed_msb, &dword);
+        rc = fand_reg_read(subsystem->yaml_handle, subsystem->name,
+                           fan->fan_speed_msb, &dword);
 
         if (rc != 0) {
             VLOG_WARN("subsystem %s: unable to read fan %s rpm MSB (%d)",
-                      subsystem_name,
+                      subsystem->name,
                       fan->name,
                       rc);
-            return(0);
+            return(rc);
         }
 
         /* Most significant byte */
-        rpm += dword << 8;
+        *raw += dword << 8;
     }
 
-    return (int)rpm;
+    return(0);
 }
 
 static enum fanstatus
-fand_read_status(const char *subsystem_name, const YamlFan *fan)
+fand_read_status(const struct locl_subsystem *subsystem, const YamlFan *fan)
 {
     i2c_bit_op *status_op;
     int rc;
@@ -285,11 +620,12 @@ fand_read_status(const char *subsystem_name, const YamlFan *fan)
 
     status_op = fan->fan_fault;
 
-    rc = i2c_reg_read(yaml_handle, subsystem_name, status_op, &value);
+    rc = fand_reg_read(subsystem->yaml_handle, subsystem->name,
+                       status_op, &value);
 
     if (rc != 0) {
         VLOG_WARN("subsystem %s: unable to read fan %s status (%d)",
-            subsystem_name,
+            subsystem->name,
             fan->name,
             rc);
         return(0);
@@ -303,9 +639,9 @@ fand_read_status(const char *subsystem_name, const YamlFan *fan)
     return FAND_STATUS_OK;
 }
 
-enum fandirection
+static enum fandirection
 fand_read_fan_fru_direction(
-    const char *subsystem_name,
+    const struct locl_subsystem *subsystem,
     const YamlFanFru *fru,
     const YamlFanInfo *info)
 {
@@ -315,11 +651,12 @@ fand_read_fan_fru_direction(
 
     direction_op = fru->fan_direction_detect;
 
-    rc = i2c_reg_read(yaml_handle, subsystem_name, direction_op, &value);
+    rc = fand_reg_read(subsystem->yaml_handle, subsystem->name,
+                       direction_op, &value);
 
     if (rc != 0) {
         VLOG_WARN("subsystem %s: unable to read fan fru %d direction (%d)",
-            subsystem_name,
+            subsystem->name,
             fru->number,
             rc);
         return(FAND_DIRECTION_F2B);
@@ -346,56 +683,34 @@ fand_read_fan_fru_direction(
     }
 }
 
-static const YamlFanFru *
-fan_fru_get(const char *subsystem_name, const YamlFan *fan)
-{
-    int idx;
-    int count;
-
-    count = yaml_get_fan_fru_count(yaml_handle, subsystem_name);
-
-    for (idx = 0; idx < count; idx++) {
-        const YamlFanFru *fru;
-        int fan_idx;
-
-        fru = yaml_get_fan_fru(yaml_handle, subsystem_name, idx);
-
-        for (fan_idx = 0; fru->fans[fan_idx] != NULL; fan_idx++) {
-            if (fan == fru->fans[fan_idx]) {
-                return fru;
-            }
-        }
-    }
-    return(NULL);
-}
-
-static const char *
-fand_read_direction(const char *subsystem_name, const YamlFan *fan)
+static enum fandirection
+fand_read_direction(const struct locl_fan *fan)
 {
+    const struct locl_subsystem *subsystem = fan->subsystem;
     const YamlFanFru *fan_fru;
     const YamlFanInfo *fan_info;
     enum fandirection fan_direction = FAND_DIRECTION_F2B;
 
-    fan_fru = fan_fru_get(subsystem_name, fan);
+    fan_fru = subsystem->frus[fan->fru_idx];
 
     if (fan_fru == NULL) {
-        return(fan_direction_enum_to_string(fan_direction));
+        return(fan_direction);
     }
 
-    fan_info = yaml_get_fan_info(yaml_handle, subsystem_name);
+    fan_info = subsystem->fan_info;
 
     if (fan_fru->fan_direction_detect != NULL) {
         fan_direction = fand_read_fan_fru_direction(
-                subsystem_name,
+                subsystem,
                 fan_fru,
                 fan_info);
     }
 
-    return(fan_direction_enum_to_string(fan_direction));
+    return(fan_direction);
 }
 
 static int
-fand_read_present(const char *subsystem_name, const YamlFanFru *fru)
+fand_read_present(const struct locl_subsystem *subsystem, const YamlFanFru *fru)
 {
     int rc;
     uint32_t present;
@@ -403,11 +718,11 @@ fand_read_present(const char *subsystem_name, const YamlFanFru *fru)
     if (!fru->fan_present)
         present = 1;
     else {
-        rc = i2c_reg_read(yaml_handle, subsystem_name,
-                          fru->fan_present, &present);
+        rc = fand_reg_read(subsystem->yaml_handle, subsystem->name,
+                           fru->fan_present, &present);
         if (rc < 0) {
             VLOG_WARN("subsystem %s: unable to read FRU %d present (%d)",
-                      subsystem_name,
+                      subsystem->name,
                       fru->number,
                       rc);
             present = 0;
@@ -416,33 +731,546 @@ fand_read_present(const char *subsystem_name, const YamlFanFru *fru)
     return (present != 0);
 }
 
+/* turn the result of a tach read into the rpm to report */
+static int
+fand_rpm_from_raw(struct locl_subsystem *subsystem,
+                  struct fan_rpm_filter *filter, int rc, uint32_t raw)
+{
+    int rpm;
+
+    if (rc != 0) {
+        /* a failed read is a glitch like any other: hold the filtered
+           value for a few polls if there is a filter, otherwise report
+           the fan stopped */
+        return(fan_rpm_filter_read_error(filter, &subsystem->rpm_filter));
+    }
+
+    rpm = (int)raw;
+    if (subsystem->hwmon != NULL || FAND_PLUGIN_HAS(subsystem, sample)) {
+        /* hwmon and plugins report rpm already */
+    } else if (subsystem->multiplier)
+        rpm *= subsystem->multiplier;
+    else if (subsystem->numerator) {
+        if (rpm)
+          rpm = subsystem->numerator / rpm;
+        else
+          rpm = 0;
+    }
+    else {
+        VLOG_WARN("subsystem %s: No valid fan speed calculation found.",
+                  subsystem->name);
+    }
+
+    return(fan_rpm_filter_update(filter, &subsystem->rpm_filter, rpm));
+}
+
 void
 fand_read_fan_status(struct locl_fan *fan)
 {
+    struct locl_subsystem *subsystem = fan->subsystem;
+    struct fan_rpm_filter *filter = &subsystem->fan_state.rpm_filter[fan->idx];
     const YamlFanFru *fan_fru;
+    enum fandirection direction;
+    enum fanstatus status;
+    uint32_t raw = 0;
+    int rpm;
+    int rc;
 
-    fan->direction = fand_read_direction(fan->subsystem->name, fan->yaml_fan);
+    direction = fand_read_direction(fan);
 
-    fan_fru = fan_fru_get(fan->subsystem->name, fan->yaml_fan);
-    if (!fand_read_present(fan->subsystem->name, fan_fru)) {
-        fan->status = FAND_STATUS_FAULT;
-        fan->rpm = 0;
+    fan_fru = subsystem->frus[fan->fru_idx];
+    subsystem->samples.present[fan->fru_idx] =
+                                    fand_read_present(subsystem, fan_fru);
+    if (!subsystem->samples.present[fan->fru_idx]) {
+        fan_rpm_filter_reset(filter);
+        fand_store_fan_state(fan, 0, FAND_STATUS_FAULT, direction);
         return;
     }
 
-    fan->rpm = fand_read_rpm(fan->subsystem->name, fan->yaml_fan);
-    if (fan->subsystem->multiplier)
-        fan->rpm *= fan->subsystem->multiplier;
-    else if (fan->subsystem->numerator) {
-        if (fan->rpm)
-          fan->rpm = fan->subsystem->numerator / fan->rpm;
-        else
-          fan->rpm = 0;
+    if (FAND_PLUGIN_HAS(subsystem, sample)) {
+        /* sampled by the caller, all fans at once */
+        rc = subsystem->samples.rpm_rc[fan->idx];
+        raw = subsystem->samples.rpm_raw[fan->idx];
+        status = subsystem->samples.status[fan->idx];
+    } else if (subsystem->hwmon != NULL) {
+        fand_hwmon_read_fan(subsystem->hwmon, fan->idx, &rc, &raw, &status);
+    } else {
+        rc = fand_read_rpm(subsystem, fan->yaml_fan, &raw);
+        status = fand_read_status(subsystem, fan->yaml_fan);
     }
-    else {
-        VLOG_WARN("subsystem %s: No valid fan speed calculation found.",
-                  fan->subsystem->name);
+    rpm = fand_rpm_from_raw(subsystem, filter, rc, raw);
+
+    fand_store_fan_state(fan, rpm, status, direction);
+}
+
+static void
+fand_plan_add(struct locl_subsystem *subsystem, struct fan_sample *sample,
+              enum fan_sample_kind kind, size_t idx, const i2c_bit_op *op)
+{
+    sample->kind = kind;
+    sample->idx = idx;
+    sample->op = op;
+    sample->mux_path = fan_plan_mux_path(subsystem->yaml_handle,
+                                         subsystem->name, op);
+}
+
+/* the register that stands for a FRU when ordering the writes */
+static const i2c_bit_op *
+fand_fru_control_op(const YamlFanFru *fru)
+{
+    if (fru->fan_speed_control != NULL) {
+        return(fru->fan_speed_control);
+    }
+    if (fru->fans[0] != NULL && fru->fans[0]->fan_speed_control != NULL) {
+        return(fru->fans[0]->fan_speed_control);
+    }
+    return(fru->fan_leds);
+}
+
+void
+fand_plan_samples(struct locl_subsystem *subsystem)
+{
+    struct locl_fan_samples *samples = &subsystem->samples;
+    struct fand_arena *arena = subsystem->arena;
+    struct fan_sample *controls;
+    size_t n_controls = 0;
+    size_t n_frus = subsystem->n_frus;
+    size_t n_fans = subsystem->n_fans;
+    size_t n_plan = 0;
+    size_t order = 0;
+    size_t idx;
+
+    /* at most presence and direction per FRU, fault and tach per fan */
+    samples->plan = fand_arena_alloc(arena, (2 * n_frus + 2 * n_fans) *
+                                            sizeof(struct fan_sample));
+    samples->present = fand_arena_alloc(arena, n_frus * sizeof(bool));
+    samples->direction = fand_arena_alloc(arena, n_frus);
+    samples->status = fand_arena_alloc(arena, n_fans);
+    samples->rpm_raw = fand_arena_alloc(arena, n_fans * sizeof(uint32_t));
+    samples->rpm_rc = fand_arena_alloc(arena, n_fans * sizeof(int));
+    samples->fresh = fand_arena_alloc(arena, n_fans);
+    subsystem->fru_order = fand_arena_alloc(arena, n_frus * sizeof(size_t));
+    controls = fand_arena_alloc(arena, n_frus * sizeof(struct fan_sample));
+
+    for (idx = 0; idx < n_frus; idx++) {
+        const YamlFanFru *fru = subsystem->frus[idx];
+        const i2c_bit_op *control = fand_fru_control_op(fru);
+
+        /* until read, a FRU without a presence bit is present */
+        samples->present[idx] = true;
+        samples->direction[idx] = FAND_DIRECTION_F2B;
+
+        if (fru->fan_present != NULL) {
+            fand_plan_add(subsystem, &samples->plan[n_plan++],
+                          FAN_SAMPLE_PRESENT, idx, fru->fan_present);
+        }
+        if (fru->fan_direction_detect != NULL) {
+            fand_plan_add(subsystem, &samples->plan[n_plan++],
+                          FAN_SAMPLE_DIRECTION, idx,
+                          fru->fan_direction_detect);
+        }
+        if (control != NULL) {
+            fand_plan_add(subsystem, &controls[n_controls++],
+                          FAN_SAMPLE_CONTROL, idx, control);
+        }
     }
 
-    fan->status = fand_read_status(fan->subsystem->name, fan->yaml_fan);
+    for (idx = 0; idx < n_fans; idx++) {
+        const YamlFan *fan = subsystem->fans[idx].yaml_fan;
+
+        samples->status[idx] = FAND_STATUS_UNINITIALIZED;
+        /* the fans of an hwmon device or a plugin are read in a pass of
+           their own */
+        if (subsystem->hwmon != NULL || FAND_PLUGIN_HAS(subsystem, sample)) {
+            continue;
+        }
+        if (fan->fan_fault != NULL) {
+            fand_plan_add(subsystem, &samples->plan[n_plan++],
+                          FAN_SAMPLE_FAULT, idx, fan->fan_fault);
+        }
+        fand_plan_add(subsystem, &samples->plan[n_plan++],
+                      FAN_SAMPLE_RPM, idx, fan->fan_speed);
+    }
+
+    samples->n_plan = n_plan;
+    fan_plan_sort(samples->plan, n_plan);
+
+    memset(samples->tier_start, 0, sizeof(samples->tier_start));
+    memset(samples->cursor, 0, sizeof(samples->cursor));
+    for (idx = 0; idx < n_plan; idx++) {
+        samples->tier_start[fan_sample_tier(samples->plan[idx].kind) + 1]++;
+    }
+    for (idx = 0; idx < FAN_SAMPLE_N_TIERS; idx++) {
+        samples->tier_start[idx + 1] += samples->tier_start[idx];
+    }
+
+    samples->n_merged = n_plan;
+    samples->merged = fand_arena_alloc(arena, n_plan *
+                                              sizeof(struct fan_sample));
+    memcpy(samples->merged, samples->plan, n_plan * sizeof(struct fan_sample));
+    fan_plan_sort_by_path(samples->merged, n_plan);
+    samples->resume = false;
+
+    samples->n_mux_paths = 0;
+    for (idx = 0; idx < n_plan; idx++) {
+        const char *path = samples->plan[idx].mux_path;
+        size_t prev;
+
+        for (prev = 0; prev < idx; prev++) {
+            if (!strcmp(samples->plan[prev].mux_path, path)) {
+                break;
+            }
+        }
+        if (prev == idx && path[0] != '\0') {
+            samples->n_mux_paths++;
+        }
+    }
+
+    /* FRUs without any control are written last, but there's nothing to
+       write to them anyway */
+    fan_plan_sort(controls, n_controls);
+    for (idx = 0; idx < n_controls; idx++) {
+        subsystem->fru_order[order++] = controls[idx].idx;
+    }
+    for (idx = 0; idx < n_frus; idx++) {
+        const YamlFanFru *fru = subsystem->frus[idx];
+        if (fand_fru_control_op(fru) == NULL) {
+            subsystem->fru_order[order++] = idx;
+        }
+    }
+}
+
+static void
+fand_take_sample(struct locl_subsystem *subsystem,
+                 const struct fan_sample *sample)
+{
+    struct locl_fan_samples *samples = &subsystem->samples;
+    const YamlFanFru *fru;
+    const struct locl_fan *fan;
+    size_t idx = sample->idx;
+
+    switch (sample->kind) {
+    case FAN_SAMPLE_PRESENT:
+        fru = subsystem->frus[idx];
+        samples->present[idx] = fand_read_present(subsystem, fru);
+        break;
+    case FAN_SAMPLE_DIRECTION:
+        fru = subsystem->frus[idx];
+        samples->direction[idx] = fand_read_fan_fru_direction(
+                subsystem, fru, subsystem->fan_info);
+        break;
+    case FAN_SAMPLE_FAULT:
+        fan = &subsystem->fans[idx];
+        /* read by tier, the presence is known by now, and the fans of an
+           absent FRU aren't read. in a single pass, they are read, and
+           dropped when the samples are stored. */
+        if (!samples->tiered || samples->present[fan->fru_idx]) {
+            samples->status[idx] = fand_read_status(subsystem, fan->yaml_fan);
+            samples->fresh[idx] |= 1 << FAN_SAMPLE_FAULT;
+        }
+        break;
+    case FAN_SAMPLE_RPM:
+        fan = &subsystem->fans[idx];
+        if (!samples->tiered || samples->present[fan->fru_idx]) {
+            samples->rpm_rc[idx] = fand_read_rpm(subsystem, fan->yaml_fan,
+                                                 &samples->rpm_raw[idx]);
+            samples->fresh[idx] |= 1 << FAN_SAMPLE_RPM;
+        }
+        break;
+    case FAN_SAMPLE_CONTROL:
+        break;
+    }
+}
+
+/* update a fan's state from its samples. what wasn't read in this poll
+   keeps its value. */
+static void
+fand_store_fan_samples(struct locl_fan *fan)
+{
+    struct locl_subsystem *subsystem = fan->subsystem;
+    struct locl_fan_samples *samples = &subsystem->samples;
+    struct fan_rpm_filter *filter = &subsystem->fan_state.rpm_filter[fan->idx];
+    enum fandirection direction = samples->direction[fan->fru_idx];
+    enum fanstatus status = subsystem->fan_state.status[fan->idx];
+    int rpm = subsystem->fan_state.rpm[fan->idx];
+    size_t idx = fan->idx;
+
+    if (!samples->present[fan->fru_idx]) {
+        fan_rpm_filter_reset(filter);
+        fand_store_fan_state(fan, 0, FAND_STATUS_FAULT, direction);
+        return;
+    }
+
+    if (samples->fresh[idx] & (1 << FAN_SAMPLE_RPM)) {
+        rpm = fand_rpm_from_raw(subsystem, filter, samples->rpm_rc[idx],
+                                samples->rpm_raw[idx]);
+    }
+    if (samples->fresh[idx] & (1 << FAN_SAMPLE_FAULT)) {
+        status = samples->status[idx];
+    }
+
+    fand_store_fan_state(fan, rpm, status, direction);
+}
+
+/* read the tach and fault of every fan from its hwmon attributes */
+static void
+fand_sample_hwmon(struct locl_subsystem *subsystem)
+{
+    struct locl_fan_samples *samples = &subsystem->samples;
+    enum fanstatus status;
+    size_t idx;
+
+    for (idx = 0; idx < subsystem->n_fans; idx++) {
+        fand_hwmon_read_fan(subsystem->hwmon, idx, &samples->rpm_rc[idx],
+                            &samples->rpm_raw[idx], &status);
+        samples->status[idx] = status;
+        samples->fresh[idx] |= 1 << FAN_SAMPLE_RPM | 1 << FAN_SAMPLE_FAULT;
+    }
+}
+
+/* check whether a poll is out of time, after 'taken' samples. the
+   decision is recorded, so that a replay cuts the poll short at the same
+   sample. */
+static bool
+fand_poll_overrun(const struct locl_subsystem *subsystem,
+                  long long int deadline, size_t taken)
+{
+    bool overrun;
+    char *key;
+
+    if (deadline == LLONG_MAX) {
+        return(false);
+    }
+
+    if (fand_replaying()) {
+        key = xasprintf("%s/deadline/%zu", subsystem->name, taken);
+        overrun = fand_replay_event(key);
+        free(key);
+        return(overrun);
+    }
+
+    if (time_usec() < deadline) {
+        return(false);
+    }
+
+    if (fand_recording()) {
+        key = xasprintf("%s/deadline/%zu", subsystem->name, taken);
+        fand_record_event(key);
+        free(key);
+    }
+    return(true);
+}
+
+/* check whether another daemon holds the bus of a sample, in which case
+   the poll is put off. the decision is recorded, like the deadline. */
+static bool
+fand_poll_busy(const struct locl_subsystem *subsystem,
+               const struct fan_sample *sample, size_t taken)
+{
+    char *key;
+    bool busy;
+
+    if (sample->kind == FAN_SAMPLE_CONTROL || sample->op == NULL) {
+        return(false);
+    }
+
+    if (fand_replaying()) {
+        key = xasprintf("%s/busy/%zu", subsystem->name, taken);
+        busy = fand_replay_event(key);
+        free(key);
+        return(busy);
+    }
+
+    if (fand_bus_acquire(subsystem->yaml_handle, subsystem->name,
+                         sample->op)) {
+        return(false);
+    }
+
+    if (fand_recording()) {
+        key = xasprintf("%s/busy/%zu", subsystem->name, taken);
+        fand_record_event(key);
+        free(key);
+    }
+    return(true);
+}
+
+/* take '*left' of the 'n' samples of 'plan' from '*cursor' on, round
+   robin, until the poll runs out of time or into a busy bus. the cursor is
+   left at the sample to take next: the one on the busy bus, or the first
+   one the next poll is to take. */
+static enum fand_poll_result
+fand_take_samples(struct locl_subsystem *subsystem,
+                  const struct fan_sample *plan, size_t n, size_t *cursor,
+                  size_t *left, long long int deadline, size_t *taken)
+{
+    while (*left > 0) {
+        const struct fan_sample *sample = &plan[*cursor];
+
+        /* there is always progress, however late the poll started */
+        if (*taken > 0 && fand_poll_overrun(subsystem, deadline, *taken)) {
+            return(FAND_POLL_OVERRUN);
+        }
+        if (fand_poll_busy(subsystem, sample, *taken)) {
+            return(FAND_POLL_BUSY);
+        }
+        fand_take_sample(subsystem, sample);
+        (*taken)++;
+        *cursor = (*cursor + 1) % n;
+        (*left)--;
+    }
+
+    return(FAND_POLL_DONE);
+}
+
+/* the number of samples in a tier of the plan */
+static size_t
+fand_tier_size(const struct locl_fan_samples *samples, int tier)
+{
+    return(samples->tier_start[tier + 1] - samples->tier_start[tier]);
+}
+
+enum fand_poll_result
+fand_sample_fans(struct locl_subsystem *subsystem, long long int deadline)
+{
+    struct locl_fan_samples *samples = &subsystem->samples;
+    enum fand_poll_result result = FAND_POLL_DONE;
+    size_t first;
+    size_t idx;
+
+    if (!samples->resume) {
+        fand_bus_poll_begin();
+        memset(samples->fresh, 0, subsystem->n_fans);
+
+        /* plugins and hwmon attributes are off the bus: all of the fans
+           are read, every poll */
+        if (FAND_PLUGIN_HAS(subsystem, sample)) {
+            fand_plugin_sample(subsystem);
+        } else if (subsystem->hwmon != NULL) {
+            fand_sample_hwmon(subsystem);
+        }
+
+        /* without a budget, all of it is read in one pass by mux path, so
+           that a channel is selected once per poll */
+        samples->tiered = deadline != LLONG_MAX;
+        samples->tier = 0;
+        samples->left = samples->tiered ? fand_tier_size(samples, 0)
+                                        : samples->n_merged;
+        samples->merged_cursor = 0;
+        samples->taken = 0;
+    }
+    samples->resume = false;
+
+    if (!samples->tiered) {
+        result = fand_take_samples(subsystem, samples->merged,
+                                   samples->n_merged,
+                                   &samples->merged_cursor, &samples->left,
+                                   deadline, &samples->taken);
+    } else {
+        while (samples->tier < FAN_SAMPLE_N_TIERS) {
+            first = samples->tier_start[samples->tier];
+
+            /* the next poll of this tier starts with what was left out */
+            result = fand_take_samples(subsystem, &samples->plan[first],
+                                       fand_tier_size(samples, samples->tier),
+                                       &samples->cursor[samples->tier],
+                                       &samples->left, deadline,
+                                       &samples->taken);
+            if (result != FAND_POLL_DONE) {
+                break;
+            }
+            if (++samples->tier < FAN_SAMPLE_N_TIERS) {
+                samples->left = fand_tier_size(samples, samples->tier);
+            }
+        }
+    }
+
+    if (result == FAND_POLL_BUSY) {
+        /* the samples taken so far are kept */
+        samples->resume = true;
+        return(result);
+    }
+
+    for (idx = 0; idx < subsystem->n_fans; idx++) {
+        fand_store_fan_samples(&subsystem->fans[idx]);
+    }
+
+    return(result);
+}
+
+bool
+fand_read_fan_fru_present(struct locl_subsystem *subsystem, size_t fru_idx)
+{
+    const YamlFanFru *fru = subsystem->frus[fru_idx];
+
+    return(fru != NULL && fand_read_present(subsystem, fru));
+}
+
+void
+fand_refresh_fan_fru(struct locl_subsystem *subsystem, size_t fru_idx)
+{
+    const YamlFanInfo *fan_info;
+    const YamlFanFru *fru;
+    enum fanstatus aggr_status = FAND_STATUS_UNINITIALIZED;
+    uint32_t hw_speed_val;
+    int rc;
+
+    fan_info = subsystem->fan_info;
+    fru = subsystem->frus[fru_idx];
+    if (fan_info == NULL || fru == NULL) {
+        return;
+    }
+
+    /* the plugin only knows how to read them all: once for the FRU */
+    if (FAND_PLUGIN_HAS(subsystem, sample)) {
+        fand_plugin_sample(subsystem);
+    }
+    for (size_t idx = subsystem->fru_first_fan[fru_idx];
+            idx < subsystem->fru_first_fan[fru_idx + 1]; idx++) {
+        fand_fan_set_speed(&subsystem->fans[idx], subsystem->speed);
+        fand_read_fan_status(&subsystem->fans[idx]);
+    }
+
+    /* a newly inserted FRU runs at its default duty until told otherwise */
+    if (subsystem->governor_state.hw_value >= 0) {
+        hw_speed_val = subsystem->governor_state.hw_value;
+    } else {
+        hw_speed_val = fand_speed_hw_value(subsystem, subsystem->speed);
+    }
+    if (FAND_PLUGIN_HAS(subsystem, set_speed)) {
+        fand_plugin_set_speed(subsystem, hw_speed_val);
+    } else if (subsystem->hwmon != NULL) {
+        fand_hwmon_set_speed(subsystem, hw_speed_val);
+    } else if (fan_info->fan_speed_control_type == SINGLE) {
+        fand_write_rpm_mode(subsystem);
+        if (fan_info->fan_speed_control != NULL) {
+            fand_write_speed_control(subsystem, fan_info->fan_speed_control,
+                                     hw_speed_val);
+        }
+    } else {
+        fand_write_rpm_mode(subsystem);
+        fand_write_fru_fanspeed(subsystem, fan_info, fru, hw_speed_val);
+    }
+
+    /* the plugin's LED hook takes all of them */
+    if (FAND_PLUGIN_HAS(subsystem, set_leds)) {
+        fand_set_fanleds(subsystem);
+        return;
+    }
+
+    if (fru->fan_leds) {
+        rc = fand_set_led(subsystem, fan_info, fru->fan_leds,
+                          fand_fru_status(subsystem, fru_idx));
+        if (rc) {
+            VLOG_DBG("Unable to set subsystem %s fan fru %d status LED",
+                     subsystem->name, fru->number);
+        }
+    }
+
+    for (size_t idx = 0; idx < subsystem->n_frus; idx++) {
+        enum fanstatus status = fand_fru_status(subsystem, idx);
+
+        if (status > aggr_status)
+            aggr_status = status;
+    }
+    fand_set_subsystem_led(subsystem, fan_info, aggr_status);
 }